@@ -2,16 +2,28 @@ LOCAL_PATH:= $(call my-dir)
 
 
 ALL_SOURCES := \
+	../../../src/rws_bucket.c \
 	../../../src/rws_common.c \
+	../../../src/rws_endpoints.c \
 	../../../src/rws_error.c \
+	../../../src/rws_executor.c \
 	../../../src/rws_frame.c \
 	../../../src/librws.c \
+	../../../src/rws_http.c \
 	../../../src/rws_list.c \
 	../../../src/rws_memory.c \
+	../../../src/rws_pool.c \
+	../../../src/rws_proto.c \
+	../../../src/rws_requests.c \
+	../../../src/rws_ring.c \
+	../../../src/rws_sha1.c \
 	../../../src/rws_socketpriv.c \
 	../../../src/rws_socketpub.c \
+	../../../src/rws_spill.c \
 	../../../src/rws_string.c \
-	../../../src/rws_thread.c
+	../../../src/rws_thread.c \
+	../../../src/rws_transport.c \
+	../../../src/rws_utf8.c
 
 
 ALL_INCLUDES := $(LOCAL_PATH)/../../../
@@ -101,6 +101,27 @@ typedef unsigned char rws_bool;
 typedef void* rws_handle;
 
 
+/**
+ @brief System socket descriptor type.
+ */
+#if defined(RWS_OS_WINDOWS)
+typedef size_t rws_fd;
+#else
+typedef int rws_fd;
+#endif
+#define RWS_INVALID_FD ((rws_fd)-1)
+
+
+/**
+ @brief Socket events wanted by the socket in external loop mode.
+ */
+typedef enum _rws_socket_event {
+	rws_socket_event_none = 0,
+	rws_socket_event_read = 1 << 0,
+	rws_socket_event_write = 1 << 1
+} rws_socket_event;
+
+
 /**
  @brief Socket handle.
  */
@@ -125,6 +146,52 @@ typedef rws_handle rws_mutex;
 typedef struct rws_thread_struct * rws_thread;
 
 
+/**
+ @brief Executor object handle, pool of threads for the received messages callbacks.
+ */
+typedef struct rws_executor_struct * rws_executor;
+
+
+/**
+ @brief Pool object handle, connected sockets to one endpoint ready for use.
+ */
+typedef struct rws_pool_struct * rws_pool;
+
+
+/**
+ @brief Endpoints object handle, equivalent URLs of one service with latency statistics.
+ */
+typedef struct rws_endpoints_struct * rws_endpoints;
+
+
+/**
+ @brief Rate limit object handle, traffic limit shared by sockets, e.g. by all sockets of one loop.
+ */
+typedef struct rws_rate_limit_struct * rws_rate_limit;
+
+
+/**
+ @brief Attributes of the threads created by library.
+ */
+typedef struct _rws_thread_attr {
+	/**
+	 @brief Stack size in bytes, 0 - system default.
+	 */
+	size_t stack_size;
+
+	/**
+	 @brief Mask of allowed CPUs, bit N is CPU N, 0 - any CPU. Ignored on Apple platforms.
+	 */
+	unsigned long long affinity_mask;
+
+	/**
+	 @brief Real time SCHED_FIFO priority, 0 - default scheduling. On Windows any positive value means
+	 time critical priority. If system denies priority thread is created with default scheduling.
+	 */
+	int priority;
+} rws_thread_attr;
+
+
 /**
  @brief Callback type of thread function.
  @param user_object User object provided during thread creation.
@@ -143,7 +210,7 @@ typedef void (*rws_on_socket)(rws_socket socket);
  @brief Callback type on socket receive text frame.
  @param socket Socket object.
  @param text Pointer to reseived text.
- @param length Received text lenght without null terminated char.
+ @param length Received text length, text is not null terminated.
  */
 typedef void (*rws_on_socket_recvd_text)(rws_socket socket, const char * text, const unsigned int length);
 
@@ -157,6 +224,125 @@ typedef void (*rws_on_socket_recvd_text)(rws_socket socket, const char * text, c
 typedef void (*rws_on_socket_recvd_bin)(rws_socket socket, const void * data, const unsigned int length);
 
 
+/**
+ @brief Received message.
+ @detailed Polled messages are owned by the caller and should be released with 'rws_message_free'.
+ */
+typedef struct rws_message_struct {
+	/**
+	 @brief Message data, text is not null terminated.
+	 */
+	const void * data;
+
+	/**
+	 @brief Message data length.
+	 */
+	size_t data_size;
+
+	/**
+	 @brief rws_true - text message, otherwice binary message.
+	 */
+	rws_bool is_text;
+
+	/**
+	 @brief Private, owner of the message data.
+	 */
+	void * priv;
+} rws_message;
+
+
+/**
+ @brief Callback type on socket receive batch of messages.
+ @detailed Invoked once with all messages completed in the current I/O cycle.
+ Messages and their data are valid only during the callback.
+ @param socket Socket object.
+ @param messages Received messages.
+ @param count Number of received messages.
+ */
+typedef void (*rws_on_socket_recvd_batch)(rws_socket socket, const rws_message * messages, const unsigned int count);
+
+
+/**
+ @brief Callback type on socket receive message with ownership.
+ @detailed Message data is not copied, application owns the message and should release it
+ with 'rws_message_free', also later from any thread. Structure is valid only during the callback,
+ copy it to keep the message.
+ @param socket Socket object.
+ @param message Received message.
+ */
+typedef void (*rws_on_socket_recvd_message)(rws_socket socket, rws_message * message);
+
+
+/**
+ @brief Type of the application callback.
+ */
+typedef enum _rws_callback_type {
+	rws_callback_type_connected = 0,
+	rws_callback_type_disconnected,
+	rws_callback_type_recvd_text,
+	rws_callback_type_recvd_bin,
+	rws_callback_type_recvd_batch,
+	rws_callback_type_reply,
+	rws_callback_type_recvd_message
+} rws_callback_type;
+
+
+/**
+ @brief Diagnostic callback type on application callback exceeded time threshold.
+ @detailed Invoked from the thread that called slow callback, right after it returned.
+ @param socket Socket object.
+ @param type Type of the slow callback.
+ @param duration_us Time spent in the callback in microseconds.
+ */
+typedef void (*rws_on_socket_slow_callback)(rws_socket socket, const rws_callback_type type, const unsigned int duration_us);
+
+
+/**
+ @brief Number of buckets in the loop iteration durations histogram.
+ */
+#define RWS_LOOP_HISTOGRAM_SIZE 24
+
+
+/**
+ @brief Maximum number of URLs in the endpoints object.
+ */
+#define RWS_ENDPOINTS_MAX 32
+
+
+/**
+ @brief Result of the request.
+ */
+typedef enum _rws_reply_status {
+	rws_reply_status_ok = 0,
+	rws_reply_status_timeout,
+	rws_reply_status_disconnected
+} rws_reply_status;
+
+
+/**
+ @brief Callback type to get request id of the sent or received message.
+ @detailed Invoked for each request before sending and for each received message from the thread
+ that sends request or from the socket thread.
+ @param socket Socket object.
+ @param message Message, data is valid only during the callback.
+ @param id Request id to set.
+ @return rws_true - message has id, otherwise rws_false.
+ */
+typedef rws_bool (*rws_on_socket_request_id)(rws_socket socket, const rws_message * message, unsigned long long * id);
+
+
+/**
+ @brief Callback type on request completion.
+ @detailed Invoked once for each request from the socket thread, or from the thread releasing
+ socket with 'rws_reply_status_disconnected'.
+ @param socket Socket object.
+ @param user_data Pointer passed to 'rws_socket_request'.
+ @param status Result of the request.
+ @param reply Reply message with 'rws_reply_status_ok', otherwise NULL. Data is valid only during the callback.
+ */
+typedef void (*rws_on_socket_reply)(rws_socket socket, void * user_data, const rws_reply_status status, const rws_message * reply);
+
+
 // socket
 
 /**
@@ -168,6 +354,8 @@ RWS_API(rws_socket) rws_socket_create(void);
 
 /**
  @brief Set socket connect URL.
+ @detailed With "ws+unix" scheme host is path of the unix domain socket file and port is ignored,
+ connection skips resolving and tcp, not supported on Windows.
  @param socket Socket object.
  @param scheme Connect URL scheme, "http" or "ws"
  @param scheme Connect URL host, "echo.websocket.org"
@@ -176,6 +364,7 @@ RWS_API(rws_socket) rws_socket_create(void);
  @code
  rws_socket_set_url(socket, "http", "echo.websocket.org", 80, "/");
  rws_socket_set_url(socket, "ws", "echo.websocket.org", 80, "/");
+ rws_socket_set_url(socket, "ws+unix", "/var/run/sidecar.sock", 0, "/");
  @endcode
  */
 RWS_API(void) rws_socket_set_url(rws_socket socket,
@@ -281,7 +470,7 @@ RWS_API(rws_bool) rws_socket_connect(rws_socket socket);
 
 /**
  @brief Disconnect socket.
- @detailed Cleanup prev. send messages and start disconnection sequence.
+ @detailed Start closing handshake with normal closure code 1000.
  SHOULD forget about this socket handle and don't use it anymore.
  @warning Don't use this socket object handler after this command.
  @param socket Socket object.
@@ -289,6 +478,150 @@ RWS_API(rws_bool) rws_socket_connect(rws_socket socket);
 RWS_API(void) rws_socket_disconnect_and_release(rws_socket socket);
 
 
+/**
+ @brief Disconnect socket with close status code and reason.
+ @detailed Pending messages are sent, then close frame is sent and socket waits close frame
+ from the endpoint, but not longer than 1 second. In external loop mode pending messages are
+ dropped and close frame is sent in place.
+ 'rws_socket_disconnect_and_release' uses normal closure code 1000.
+ @warning Don't use this socket object handler after this command.
+ @param socket Socket object.
+ @param code Close status code, e.g. 1000 - normal closure, 1001 - going away.
+ @param reason Optional close reason, truncated to 123 bytes.
+ */
+RWS_API(void) rws_socket_disconnect_with_code_and_release(rws_socket socket,
+														  const unsigned short code,
+														  const char * reason);
+
+
+/**
+ @brief Add header to the handshake request.
+ @detailed Should be called before connect, header is sent with every connection of this socket.
+ @param socket Socket object.
+ @param name Header name without ':', spaces and line breaks.
+ @param value Header value without line breaks.
+ @return rws_true - header added, rws_false - invalid name or value.
+ @code
+ rws_socket_add_header(socket, "Authorization", "Bearer token");
+ @endcode
+ */
+RWS_API(rws_bool) rws_socket_add_header(rws_socket socket, const char * name, const char * value);
+
+
+/**
+ @brief Add subprotocol to the "Sec-WebSocket-Protocol" header of the handshake request.
+ @detailed Should be called before connect, subprotocols are sent in the order of adding.
+ Connection fails if endpoint selects subprotocol which was not requested.
+ @param socket Socket object.
+ @param protocol Subprotocol name without ',', spaces and line breaks.
+ @return rws_true - subprotocol added, rws_false - invalid name.
+ */
+RWS_API(rws_bool) rws_socket_add_protocol(rws_socket socket, const char * protocol);
+
+
+/**
+ @brief Get subprotocol selected by endpoint.
+ @detailed Can be used in callbacks after connect.
+ @param socket Socket object.
+ @return Subprotocol name or NULL if endpoint not selected subprotocol.
+ */
+RWS_API(const char *) rws_socket_get_protocol(rws_socket socket);
+
+
+/**
+ @brief Receive big binary messages to memory mapped temporary file instead of heap.
+ @detailed Binary message bigger than threshold is written to the file while it arrives, even in the middle
+ of the frame, so kernel can page it out under memory pressure. Data of 'on_recvd_bin' or message points
+ to the mapping, it is unmapped after callback or 'rws_message_free'. If file can't be created message
+ stays in heap, not supported on Windows. Should be called before connect.
+ @param socket Socket object.
+ @param threshold Size of the message in bytes, 0 - disabled(default).
+ @param directory Directory of the temporary file or null - anonymous memory file if supported(Linux),
+ otherwise TMPDIR or "/tmp".
+ */
+RWS_API(void) rws_socket_set_recv_spill(rws_socket socket, const size_t threshold, const char * directory);
+
+
+/**
+ @brief Queue messages to send in temporary file when too many bytes are queued in memory.
+ @detailed While the endpoint is unreachable or slow, messages over the threshold are appended to
+ the memory mapped file and sent in order after messages in memory, also after reconnect of the same socket.
+ File is deleted when all messages are sent. If file can't be created or grown, message is queued in
+ memory if file is empty, otherwise sending fails. Not supported on Windows. Thread safe.
+ @param socket Socket object.
+ @param threshold Size of the queued frames in memory in bytes, 0 - disabled(default).
+ @param directory Directory of the temporary file or null - TMPDIR or "/tmp".
+ */
+RWS_API(void) rws_socket_set_send_spill(rws_socket socket, const size_t threshold, const char * directory);
+
+
+/**
+ @brief Get size of the queued data in the send spill file.
+ @detailed Thread safe getter, frames already loaded to memory for sending are not counted.
+ @param socket Socket object.
+ @return Size in bytes or 0 if nothing is spilled.
+ */
+RWS_API(size_t) rws_socket_get_send_spilled(rws_socket socket);
+
+
+/**
+ @brief Set request id callback and enable requests.
+ @detailed Received message with id of the request in flight is delivered to the request callback
+ instead of the receive callbacks, also in poll, batch and executor modes. Should be called before connect.
+ @param socket Socket object.
+ @param callback Request id callback.
+ */
+RWS_API(void) rws_socket_set_on_request_id(rws_socket socket, rws_on_socket_request_id callback);
+
+
+/**
+ @brief Send request and wait reply with the same id.
+ @detailed Thread safe method. Id of the request is taken from the data by request id callback.
+ Requests are kept in the socket table, thousands of requests can be in flight. Requests not replied
+ until timeout are completed with 'rws_reply_status_timeout', pending requests are completed with
+ 'rws_reply_status_disconnected' on disconnect or release.
+ @param socket Socket object.
+ @param data Request data.
+ @param data_size Request data size.
+ @param is_text rws_true - text message, otherwise binary message.
+ @param timeout_ms Timeout in milliseconds, 0 - no timeout.
+ @param on_reply Completion callback.
+ @param user_data Pointer for the completion callback.
+ @return rws_true - request is placed to send queue, otherwise rws_false, e.g. no id or id is in flight.
+ */
+RWS_API(rws_bool) rws_socket_request(rws_socket socket, const void * data, const size_t data_size, const rws_bool is_text,
+									 const unsigned int timeout_ms, rws_on_socket_reply on_reply, void * user_data);
+
+
+/**
+ @brief Get number of requests waiting for reply.
+ @detailed Thread safe getter.
+ @param socket Socket object.
+ @return Number of requests in flight.
+ */
+RWS_API(unsigned int) rws_socket_get_requests_count(rws_socket socket);
+
+
+/**
+ @brief Get close status code received from the endpoint.
+ @detailed Thread safe getter, can be used in disconnect callback.
+ @param socket Socket object.
+ @return Close status code or 0 if endpoint not sent close frame or close frame without code.
+ */
+RWS_API(unsigned short) rws_socket_get_close_code(rws_socket socket);
+
+
+/**
+ @brief Enable or disable UTF-8 validation of the received text messages.
+ @detailed Enabled by default. Text message with invalid UTF-8 fails the connection with close code 1007
+ and 'rws_error_code_invalid_utf8' error, message is not delivered. Fragments are validated as they arrive.
+ Should be called before connect.
+ @param socket Socket object.
+ @param is_enabled rws_true - validate text messages, rws_false - deliver text messages as is.
+ */
+RWS_API(void) rws_socket_set_utf8_validation(rws_socket socket, const rws_bool is_enabled);
+
+
 /**
  @brief Check is socket has connection to host and handshake(sucessfully done).
  @detailed Thread safe getter.
@@ -300,7 +633,7 @@ RWS_API(rws_bool) rws_socket_is_connected(rws_socket socket);
 
 /**
  @brief Send text to connect socket.
- @detailed Thread safe method.
+ @detailed Thread safe method. Empty text is sent as empty message.
  @param socket Socket object.
  @param text Text string for sending.
  @return rws_true - socket and text exists and placed to send queue, otherwice rws_false.
@@ -309,14 +642,29 @@ RWS_API(rws_bool) rws_socket_send_text(rws_socket socket, const char * text);
 
 /**
  @brief Send binary data to connect socket.
- @detailed Thread safe method.
+ @detailed Thread safe method. Zero size is sent as empty message.
  @param socket Socket object.
- @param dataPtr data buffer pointer for sending.
+ @param dataPtr data buffer pointer for sending, can be null if size is 0.
  @param dataSize data buffer size.
  @return rws_true - socket and text exists and placed to send queue, otherwice rws_false.
  */
 RWS_API(rws_bool) rws_socket_send_binary(rws_socket socket, void* dataPtr, size_t dataSize);
 
+/**
+ @brief Queue part of the regular file as binary message read by frames while sending.
+ @detailed Thread safe method. This is not zero-copy: client frames must be masked, so the loop thread
+ reads frames of 64KB with pread and masks them in memory when the socket is ready to send. The file is
+ read without the send lock, threads sending other messages are not blocked by file I/O. Descriptor is
+ duplicated, caller can close it after call. If file can't be read while sending, connection is closed
+ with code 1011. Not supported on Windows.
+ @param socket Socket object.
+ @param fd Descriptor of the regular file.
+ @param offset Offset of the first byte in file.
+ @param size Number of bytes to send, should be inside the file.
+ @return rws_true - message placed to send queue, otherwice rws_false.
+ */
+RWS_API(rws_bool) rws_socket_send_file(rws_socket socket, int fd, unsigned long long offset, unsigned long long size);
+
 
 /**
  @brief Set socket user defined object pointer for identificating socket object.
@@ -346,6 +694,424 @@ RWS_API(void) rws_socket_set_on_received_text(rws_socket socket, rws_on_socket_r
 RWS_API(void) rws_socket_set_on_received_bin(rws_socket socket, rws_on_socket_recvd_bin callback);
 
 
+/**
+ @brief Set callback for the received messages batch.
+ @detailed If set, replaces 'on_recvd_text' and 'on_recvd_bin' callbacks. Ignored in poll mode.
+ @param socket Socket object.
+ @param callback Batch callback or null.
+ */
+RWS_API(void) rws_socket_set_on_received_batch(rws_socket socket, rws_on_socket_recvd_batch callback);
+
+
+/**
+ @brief Set callback for the received message with ownership.
+ @detailed If set, replaces 'on_recvd_text' and 'on_recvd_bin' callbacks, batch callback has priority.
+ Message is moved to application without copy. Ignored in poll mode.
+ @param socket Socket object.
+ @param callback Message callback or null.
+ */
+RWS_API(void) rws_socket_set_on_received_message(rws_socket socket, rws_on_socket_recvd_message callback);
+
+
+/**
+ @brief Set callback invoked right before socket object is freed.
+ @detailed Invoked once from the thread deleting socket: work thread after disconnect or thread
+ releasing socket. No callbacks are invoked after it, user object can be freed here.
+ @param socket Socket object.
+ @param callback Callback or null.
+ */
+RWS_API(void) rws_socket_set_on_deleted(rws_socket socket, rws_on_socket callback);
+
+
+/**
+ @brief Drive socket by application event loop instead of the own work thread.
+ @detailed In external loop mode librws creates no threads. After 'rws_socket_connect' and after each
+ 'rws_socket_on_readable', 'rws_socket_on_writable' or 'rws_socket_on_timer' call, application should
+ query socket descriptor, wanted events and timeout again. These methods don't wait: unsent bytes stay
+ queued until writable and connect retries are scheduled by timeout. Host name resolution is still blocking.
+ All callbacks are invoked from these methods. Socket is never deleted automatically,
+ call 'rws_socket_disconnect_and_release' when done, but not from the socket callbacks.
+ Should be called before connect.
+ @param socket Socket object.
+ @param is_external rws_true - external loop mode, rws_false - work thread mode(default).
+ */
+RWS_API(void) rws_socket_set_external_loop(rws_socket socket, const rws_bool is_external);
+
+
+/**
+ @brief Get system socket descriptor for the external loop.
+ @param socket Socket object.
+ @return Socket descriptor or RWS_INVALID_FD if socket is not opened.
+ */
+RWS_API(rws_fd) rws_socket_get_fd(rws_socket socket);
+
+
+/**
+ @brief Get events socket waiting for in external loop mode.
+ @param socket Socket object.
+ @return Combination of 'rws_socket_event' flags.
+ */
+RWS_API(unsigned int) rws_socket_get_wanted_events(rws_socket socket);
+
+
+/**
+ @brief Get time in milliseconds after which 'rws_socket_on_timer' should be called in external loop mode.
+ @param socket Socket object.
+ @return Timeout in milliseconds, 0 - call as soon as possible.
+ */
+RWS_API(unsigned int) rws_socket_get_timeout(rws_socket socket);
+
+
+/**
+ @brief Notify socket that descriptor is readable in external loop mode.
+ @param socket Socket object.
+ @return rws_true - socket is active, rws_false - socket is disconnected and can be released.
+ */
+RWS_API(rws_bool) rws_socket_on_readable(rws_socket socket);
+
+
+/**
+ @brief Notify socket that descriptor is writable in external loop mode.
+ @param socket Socket object.
+ @return rws_true - socket is active, rws_false - socket is disconnected and can be released.
+ */
+RWS_API(rws_bool) rws_socket_on_writable(rws_socket socket);
+
+
+/**
+ @brief Notify socket that timeout is expired in external loop mode.
+ @param socket Socket object.
+ @return rws_true - socket is active, rws_false - socket is disconnected and can be released.
+ */
+RWS_API(rws_bool) rws_socket_on_timer(rws_socket socket);
+
+
+/**
+ @brief Switch socket to poll mode.
+ @detailed In poll mode received messages are not delivered to 'on_recvd_text' and 'on_recvd_bin' callbacks,
+ they are placed to the bounded queue and should be taken with 'rws_socket_poll_messages'.
+ While queue is full socket stops reading. Should be called before connect.
+ @param socket Socket object.
+ @param capacity Maximum number of queued messages, rounded up to power of 2. 0 - callback mode.
+ */
+RWS_API(void) rws_socket_set_poll_mode(rws_socket socket, const unsigned int capacity);
+
+
+/**
+ @brief Take received messages in poll mode.
+ @detailed Lock free, can be called from one consumer thread while socket is connected.
+ @param socket Socket object.
+ @param messages Array for the received messages.
+ @param max_count Size of the messages array.
+ @return Number of messages placed to the array. Each message should be released with 'rws_message_free'.
+ */
+RWS_API(unsigned int) rws_socket_poll_messages(rws_socket socket, rws_message * messages, const unsigned int max_count);
+
+
+/**
+ @brief Release data of the polled message.
+ @param message Message object.
+ */
+RWS_API(void) rws_message_free(rws_message * message);
+
+
+/**
+ @brief Allocate message to fill and send without copy.
+ @detailed Memory before data is reserved for the frame header, so 'rws_socket_send_message' masks
+ data in place. Data can be written through the cast of 'data' pointer until message is sent.
+ Release with 'rws_message_free' if not sent.
+ @param message Message object to initialize.
+ @param data_size Size of the data, more than 0.
+ @param is_text rws_true - text message, otherwise binary message.
+ @return rws_true - message allocated, otherwise rws_false.
+ */
+RWS_API(rws_bool) rws_message_alloc(rws_message * message, const size_t data_size, const rws_bool is_text);
+
+
+/**
+ @brief Send message allocated with 'rws_message_alloc' without copy.
+ @detailed Thread safe method. Message is moved to send queue and cleared, also on failure.
+ @param socket Socket object.
+ @param message Message allocated with 'rws_message_alloc'.
+ @return rws_true - message placed to send queue, otherwise rws_false.
+ */
+RWS_API(rws_bool) rws_socket_send_message(rws_socket socket, rws_message * message);
+
+
+/**
+ @brief Limit outgoing traffic of the socket.
+ @detailed Limits are applied while draining send queue, messages above the limit are delayed, not dropped.
+ Control frames (ping, pong, close) are not limited. Thread safe method.
+ @param socket Socket object.
+ @param messages_per_sec Maximum number of sent messages per second, 0 - unlimited.
+ @param bytes_per_sec Maximum number of sent bytes per second including frame headers, 0 - unlimited.
+ */
+RWS_API(void) rws_socket_set_send_rate_limit(rws_socket socket,
+											 const unsigned int messages_per_sec,
+											 const unsigned int bytes_per_sec);
+
+
+/**
+ @brief Limit incoming traffic of the socket.
+ @detailed While limit is exceeded socket stops reading and data stays in the system buffer. Thread safe method.
+ @param socket Socket object.
+ @param bytes_per_sec Maximum number of read bytes per second, 0 - unlimited.
+ */
+RWS_API(void) rws_socket_set_recv_rate_limit(rws_socket socket, const unsigned int bytes_per_sec);
+
+
+/**
+ @brief Get total time in milliseconds the send queue was delayed by the send rate limit.
+ @param socket Socket object.
+ @return Throttled time in milliseconds or 0.
+ */
+RWS_API(unsigned int) rws_socket_get_send_throttled_time(rws_socket socket);
+
+
+/**
+ @brief Get total time in milliseconds the reading was paused by the receive rate limit.
+ @param socket Socket object.
+ @return Throttled time in milliseconds or 0.
+ */
+RWS_API(unsigned int) rws_socket_get_recv_throttled_time(rws_socket socket);
+
+
+/**
+ @brief Create rate limit object, can be shared by many sockets.
+ @detailed Limits are applied to the total traffic of all attached sockets, together with limits
+ of each socket. Limits are not changed after creation.
+ @param messages_per_sec Maximum number of sent messages per second, 0 - unlimited.
+ @param send_bytes_per_sec Maximum number of sent bytes per second including frame headers, 0 - unlimited.
+ @param recv_bytes_per_sec Maximum number of read bytes per second, 0 - unlimited.
+ @return Rate limit object or NULL on allocation failure.
+ */
+RWS_API(rws_rate_limit) rws_rate_limit_create(const unsigned int messages_per_sec,
+											  const unsigned int send_bytes_per_sec,
+											  const unsigned int recv_bytes_per_sec);
+
+
+/**
+ @brief Delete rate limit object.
+ @detailed Sockets using rate limit keep it till they are deleted, so it can be deleted any time after
+ 'rws_socket_set_shared_rate_limit'.
+ @param limit Rate limit object.
+ */
+RWS_API(void) rws_rate_limit_delete(rws_rate_limit limit);
+
+
+/**
+ @brief Attach socket to the rate limit shared with other sockets.
+ @detailed Should be called before connect.
+ @param socket Socket object.
+ @param limit Rate limit object or null - only socket limits(default).
+ */
+RWS_API(void) rws_socket_set_shared_rate_limit(rws_socket socket, rws_rate_limit limit);
+
+
+/**
+ @brief Deliver received messages from the executor threads instead of the socket work thread.
+ @detailed Messages of one socket are delivered in order by one executor thread at a time, messages of
+ different sockets are delivered in parallel. Slow callbacks no longer delay reading, sending and pings.
+ Reading is paused while socket has too many not delivered messages. 'on_disconnected' is called after
+ all received messages are delivered. Ignored in poll mode. Should be called before connect.
+ @param socket Socket object.
+ @param executor Executor object or null - callbacks from the socket thread(default).
+ */
+RWS_API(void) rws_socket_set_executor(rws_socket socket, rws_executor executor);
+
+
+// executor
+
+/**
+ @brief Create executor with own threads, can be shared by many sockets.
+ @detailed Executor is created if at least one thread is started.
+ @param threads_count Number of threads, 0 - one thread.
+ @return Executor object or null if no thread can be started.
+ */
+RWS_API(rws_executor) rws_executor_create(const unsigned int threads_count);
+
+
+/**
+ @brief Stop threads and delete executor.
+ @detailed Sockets using executor should be disconnected and released before.
+ @param executor Executor object.
+ */
+RWS_API(void) rws_executor_delete(rws_executor executor);
+
+
+// pool
+
+/**
+ @brief Create pool of sockets connected to one endpoint.
+ @detailed Sockets are connected and handshaken in their work threads right away and kept alive by pings.
+ Acquired socket and socket lost connection are replaced in background, socket failed to connect is
+ replaced on next acquire.
+ @param scheme Connect URL scheme, "ws".
+ @param host Connect URL host.
+ @param port Connect URL port.
+ @param path Connect URL path started with '/' character.
+ @param size Number of sockets to keep, 0 - one socket.
+ @param on_socket Called for each new socket before connect, e.g. to set callbacks, headers and user object.
+ Socket callbacks are called for pooled sockets too. Can be null.
+ @return Pool object.
+ @code
+ rws_pool pool = rws_pool_create("ws", "echo.websocket.org", 80, "/", 4, &setup_socket);
+ @endcode
+ */
+RWS_API(rws_pool) rws_pool_create(const char * scheme,
+								  const char * host,
+								  const int port,
+								  const char * path,
+								  const unsigned int size,
+								  rws_on_socket on_socket);
+
+
+/**
+ @brief Take connected socket from the pool.
+ @detailed Acquired socket is owned by application and should be released with
+ 'rws_socket_disconnect_and_release'. Thread safe method.
+ @param pool Pool object.
+ @return Connected socket or null if no socket is connected yet.
+ */
+RWS_API(rws_socket) rws_pool_acquire(rws_pool pool);
+
+
+/**
+ @brief Get number of connected sockets in the pool.
+ @param pool Pool object.
+ @return Number of sockets which can be acquired.
+ */
+RWS_API(unsigned int) rws_pool_get_ready_count(rws_pool pool);
+
+
+/**
+ @brief Disconnect and release not acquired sockets and delete pool.
+ @detailed Acquired sockets are not affected.
+ @param pool Pool object.
+ */
+RWS_API(void) rws_pool_delete(rws_pool pool);
+
+
+// endpoints
+
+/**
+ @brief Create empty endpoints object, can be shared by many sockets.
+ @return Endpoints object.
+ */
+RWS_API(rws_endpoints) rws_endpoints_create(void);
+
+
+/**
+ @brief Add URL of the service.
+ @param endpoints Endpoints object.
+ @param scheme Connect URL scheme, "ws" or "ws+unix".
+ @param host Connect URL host, or path of the unix domain socket file.
+ @param port Connect URL port, can be 0 with "ws+unix" scheme.
+ @param path Connect URL path started with '/' character.
+ @return rws_true - added, rws_false - invalid URL or RWS_ENDPOINTS_MAX endpoints already added.
+ */
+RWS_API(rws_bool) rws_endpoints_add(rws_endpoints endpoints,
+									const char * scheme,
+									const char * host,
+									const int port,
+									const char * path);
+
+
+/**
+ @brief Get smoothed connect and handshake time of the endpoint.
+ @param endpoints Endpoints object.
+ @param index Endpoint index in the order of adding.
+ @return Time in microseconds or 0 if not measured.
+ */
+RWS_API(unsigned int) rws_endpoints_get_handshake_time(rws_endpoints endpoints, const unsigned int index);
+
+
+/**
+ @brief Get smoothed ping round trip time of the endpoint.
+ @param endpoints Endpoints object.
+ @param index Endpoint index in the order of adding.
+ @return Time in microseconds or 0 if not measured.
+ */
+RWS_API(unsigned int) rws_endpoints_get_rtt(rws_endpoints endpoints, const unsigned int index);
+
+
+/**
+ @brief Delete endpoints object.
+ @detailed Sockets using endpoints keep it till they are deleted, so it can be deleted any time after
+ 'rws_socket_set_endpoints', also while released sockets finish the closing handshake.
+ @param endpoints Endpoints object.
+ */
+RWS_API(void) rws_endpoints_delete(rws_endpoints endpoints);
+
+
+/**
+ @brief Connect to the fastest healthy endpoint instead of the socket URL.
+ @detailed Endpoint with the lowest ping round trip time, or handshake time if not pinged yet, is selected,
+ not measured endpoints are tried first. If connect or handshake fails, next endpoint is tried without
+ informing disconnect, failed endpoint is not selected for a while. 'on_disconnected' is called after all
+ endpoints failed. Socket URL is not replaced by the endpoint URL, use 'rws_socket_get_endpoint' to get
+ the current endpoint. Should be called before connect.
+ @param socket Socket object.
+ @param endpoints Endpoints object or null - connect to the socket URL(default).
+ */
+RWS_API(void) rws_socket_set_endpoints(rws_socket socket, rws_endpoints endpoints);
+
+
+/**
+ @brief Get endpoint of the socket connection.
+ @detailed Can be used in callbacks.
+ @param socket Socket object.
+ @return Endpoint index in the order of adding or -1 if endpoints are not used.
+ */
+RWS_API(int) rws_socket_get_endpoint(rws_socket socket);
+
+
+/**
+ @brief Set attributes of the socket work thread.
+ @detailed Work thread is named "rws-<host>". Should be called before connect.
+ @param socket Socket object.
+ @param attr Thread attributes or null - use default attributes set with 'rws_thread_set_default_attr'.
+ */
+RWS_API(void) rws_socket_set_thread_attr(rws_socket socket, const rws_thread_attr * attr);
+
+
+/**
+ @brief Disconnect and release all sockets.
+ @detailed Work thread sockets are closed by their threads in parallel. External loop sockets are only asked
+ to close: their loops finish the closing handshake, then owners release them when loop methods return rws_false,
+ so this should not be called from the only thread driving external loops. Released socket handles
+ should not be used after this call.
+ @param timeout_ms Maximum time in milliseconds to wait until all work threads finished.
+ @return rws_true - all sockets are released, rws_false - timeout expired.
+ */
+RWS_API(rws_bool) rws_shutdown_all(const unsigned int timeout_ms);
+
+
+/**
+ @brief Set diagnostic hook for slow application callbacks.
+ @detailed While callback runs socket is not reading, sending and pinging(except executor callbacks).
+ Should be called before connect.
+ @param socket Socket object.
+ @param hook Diagnostic callback or null - no measuring(default).
+ @param threshold_us Callbacks running this number of microseconds or longer are reported.
+ */
+RWS_API(void) rws_socket_set_on_slow_callback(rws_socket socket,
+											  rws_on_socket_slow_callback hook,
+											  const unsigned int threshold_us);
+
+
+/**
+ @brief Get histogram of the socket loop iteration durations including callbacks.
+ @detailed Bucket 0 counts iterations shorter than 1 microsecond, bucket N counts iterations from 2^(N-1)
+ till 2^N microseconds, last bucket counts all longer iterations. Thread safe method.
+ @param socket Socket object.
+ @param counts Array for the iteration counters.
+ @param size Size of the counts array, up to RWS_LOOP_HISTOGRAM_SIZE is used.
+ @return Number of buckets placed to the counts array.
+ */
+RWS_API(unsigned int) rws_socket_get_loop_histogram(rws_socket socket, unsigned int * counts, const unsigned int size);
+
+
 // error
 
 typedef enum _rws_error_code {
@@ -365,6 +1131,10 @@ typedef enum _rws_error_code {
 	 */
 	rws_error_code_connection_closed,
 	
+	/**
+	 @brief Received text message is not valid UTF-8, connection closed with code 1007.
+	 */
+	rws_error_code_invalid_utf8
 	
 } rws_error_code;
 
@@ -418,10 +1188,36 @@ RWS_API(void) rws_mutex_delete(rws_mutex mutex);
 
 /**
  @brief Create thread object that start immidiatelly.
+ @detailed Thread is detached and releases its object when thread function returns, so the handle only
+ reports the result: one shared handle that is never freed is returned for all threads.
+ @return Not null handle - thread started, null - thread not started.
  */
 RWS_API(rws_thread) rws_thread_create(rws_thread_funct thread_function, void * user_object);
 
 
+/**
+ @brief Create detached thread that start immidiatelly, with attributes and name.
+ @param thread_function Thread function.
+ @param user_object User object provided to the thread function.
+ @param attr Thread attributes or null - use default attributes set with 'rws_thread_set_default_attr'.
+ @param name Thread name or null, truncated to 15 characters.
+ @return rws_true - thread started, otherwise rws_false.
+ */
+RWS_API(rws_bool) rws_thread_create_with_attr(rws_thread_funct thread_function,
+											  void * user_object,
+											  const rws_thread_attr * attr,
+											  const char * name);
+
+
+/**
+ @brief Set attributes of the threads created after this call: socket work threads, executor threads
+ and threads created with 'rws_thread_create' or 'rws_thread_create_with_attr' without attributes.
+ Socket attributes set with 'rws_socket_set_thread_attr' have priority. Should be called before creating threads.
+ @param attr Thread attributes or null - system defaults.
+ */
+RWS_API(void) rws_thread_set_default_attr(const rws_thread_attr * attr);
+
+
 /**
  @brief Pause current thread for a number of milliseconds.
  */
@@ -0,0 +1,401 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#ifndef __LIBRWS_HPP__
+#define __LIBRWS_HPP__ 1
+
+#if !defined(__cplusplus) || (__cplusplus < 202002L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 202002L))
+#error "librws.hpp requires C++20"
+#endif
+
+#include "librws.h"
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace rws {
+
+	/**
+	 @brief Owned message, move-only.
+	 @detailed Adopts librws buffer of the received message or buffer allocated for sending,
+	 data is never copied. Released with 'rws_message_free' on destruction.
+	 */
+	class message final {
+	public:
+		message() noexcept : _message() { }
+
+		/**
+		 @brief Take ownership of the C message, source is cleared.
+		 */
+		explicit message(rws_message & adopted) noexcept : _message(adopted) {
+			adopted = rws_message();
+		}
+
+		message(message && other) noexcept : _message(other.release()) { }
+
+		message & operator=(message && other) noexcept {
+			if (this != &other) {
+				rws_message_free(&_message);
+				_message = other.release();
+			}
+			return *this;
+		}
+
+		message(const message &) = delete;
+		message & operator=(const message &) = delete;
+
+		~message() {
+			rws_message_free(&_message);
+		}
+
+		/**
+		 @brief Allocate message to fill with 'buffer' and send without copy.
+		 @return Empty message if size is 0.
+		 */
+		static message allocate(const std::size_t size, const bool is_text = false) {
+			rws_message m = rws_message();
+			rws_message_alloc(&m, size, is_text ? rws_true : rws_false);
+			return message(m);
+		}
+
+		/**
+		 @brief Writable data of the owned message.
+		 */
+		std::span<std::byte> buffer() noexcept {
+			return std::span<std::byte>(static_cast<std::byte *>(const_cast<void *>(_message.data)), _message.data_size);
+		}
+
+		std::span<const std::byte> data() const noexcept {
+			return std::span<const std::byte>(static_cast<const std::byte *>(_message.data), _message.data_size);
+		}
+
+		/**
+		 @brief Data as text, not null terminated.
+		 */
+		std::string_view text() const noexcept {
+			return std::string_view(static_cast<const char *>(_message.data), _message.data_size);
+		}
+
+		std::size_t size() const noexcept {
+			return _message.data_size;
+		}
+
+		bool is_text() const noexcept {
+			return _message.is_text ? true : false;
+		}
+
+		bool empty() const noexcept {
+			return _message.priv == nullptr;
+		}
+
+		explicit operator bool() const noexcept {
+			return !empty();
+		}
+
+		/**
+		 @brief Give ownership back to C API, message is cleared.
+		 */
+		rws_message release() noexcept {
+			rws_message m = _message;
+			_message = rws_message();
+			return m;
+		}
+
+	private:
+		rws_message _message;
+	};
+
+	/**
+	 @brief Socket handle, move-only, disconnects and releases socket on destruction.
+	 @detailed Handlers are invoked from the socket thread, or from external loop methods, as C callbacks.
+	 After destructor returns no handler is running or invoked. In work thread mode socket is deleted after
+	 disconnect, like with C API, then methods return false. User object, callbacks and external loop mode
+	 of the C socket are managed by wrapper.
+	 */
+	class socket final {
+	public:
+		using connected_handler = std::function<void()>;
+		using disconnected_handler = std::function<void(rws_error error)>;
+		using text_handler = std::function<void(std::string_view text)>;
+		using binary_handler = std::function<void(std::span<const std::byte> data)>;
+		using message_handler = std::function<void(message && received)>;
+
+		socket() : _state(std::make_shared<state>()) {
+			_state->socket = rws_socket_create();
+			rws_socket_set_user_object(_state->socket, new std::shared_ptr<state>(_state)); // released on delete
+			rws_socket_set_on_deleted(_state->socket, &socket::on_deleted);
+			rws_socket_set_on_connected(_state->socket, &socket::on_connected);
+			rws_socket_set_on_disconnected(_state->socket, &socket::on_disconnected);
+			rws_socket_set_on_received_text(_state->socket, &socket::on_text);
+			rws_socket_set_on_received_bin(_state->socket, &socket::on_binary);
+		}
+
+		socket(socket && other) noexcept = default;
+
+		socket & operator=(socket && other) noexcept {
+			if (this != &other) {
+				close();
+				_state = std::move(other._state);
+			}
+			return *this;
+		}
+
+		socket(const socket &) = delete;
+		socket & operator=(const socket &) = delete;
+
+		~socket() {
+			close();
+		}
+
+		/**
+		 @brief C socket for the rest of the API, null after delete or move. Don't change user object and callbacks.
+		 */
+		rws_socket get() const {
+			if (!_state) {
+				return nullptr;
+			}
+			std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+			return _state->socket;
+		}
+
+		void set_url(const std::string & scheme, const std::string & host, const int port, const std::string & path) {
+			if (!_state) {
+				return;
+			}
+			std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+			rws_socket_set_url(_state->socket, scheme.c_str(), host.c_str(), port, path.c_str());
+		}
+
+		/**
+		 @brief No work thread, see 'rws_socket_set_external_loop'. Set before connect.
+		 */
+		void set_external_loop(const bool is_external) {
+			if (!_state) {
+				return;
+			}
+			std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+			_state->is_external_loop = is_external;
+			rws_socket_set_external_loop(_state->socket, is_external ? rws_true : rws_false);
+		}
+
+		// handlers should be set before connect, ignored by moved from socket
+
+		void on_connected(connected_handler handler) {
+			if (_state) {
+				_state->on_connected = std::move(handler);
+			}
+		}
+
+		void on_disconnected(disconnected_handler handler) {
+			if (_state) {
+				_state->on_disconnected = std::move(handler);
+			}
+		}
+
+		void on_text(text_handler handler) {
+			if (_state) {
+				_state->on_text = std::move(handler);
+			}
+		}
+
+		void on_binary(binary_handler handler) {
+			if (_state) {
+				_state->on_binary = std::move(handler);
+			}
+		}
+
+		/**
+		 @brief Receive owned messages without copy, replaces text and binary handlers.
+		 */
+		void on_message(message_handler handler) {
+			if (!_state) {
+				return;
+			}
+			std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+			_state->on_message = std::move(handler);
+			rws_socket_set_on_received_message(_state->socket, _state->on_message ? &socket::on_received_message : nullptr);
+		}
+
+		bool connect() {
+			if (!_state) {
+				return false;
+			}
+			std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+			return _state->socket && rws_socket_connect(_state->socket);
+		}
+
+		bool is_connected() const {
+			if (!_state) {
+				return false;
+			}
+			std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+			return _state->socket && rws_socket_is_connected(_state->socket);
+		}
+
+		/**
+		 @brief Send message allocated with 'message::allocate' without copy. Message is released, also on failure.
+		 */
+		bool send(message && m) {
+			rws_message c = m.release();
+			if (!_state) {
+				rws_message_free(&c);
+				return false;
+			}
+			std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+			if (!_state->socket) {
+				rws_message_free(&c);
+				return false;
+			}
+			return rws_socket_send_message(_state->socket, &c) ? true : false;
+		}
+
+		/**
+		 @brief Send text, copied once to the frame. Empty text is sent as empty message.
+		 */
+		bool send(std::string_view text) {
+			if (!_state) {
+				return false;
+			}
+			if (text.empty()) {
+				std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+				return _state->socket && rws_socket_send_text(_state->socket, "");
+			}
+			message m = message::allocate(text.size(), true);
+			if (m) {
+				std::memcpy(m.buffer().data(), text.data(), text.size());
+			}
+			return m && send(std::move(m));
+		}
+
+		/**
+		 @brief Send binary data, copied once to the frame. Empty data is sent as empty message.
+		 */
+		bool send(std::span<const std::byte> data) {
+			if (!_state) {
+				return false;
+			}
+			if (data.empty()) {
+				std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+				return _state->socket && rws_socket_send_binary(_state->socket, nullptr, 0);
+			}
+			message m = message::allocate(data.size(), false);
+			if (m) {
+				std::memcpy(m.buffer().data(), data.data(), data.size());
+			}
+			return m && send(std::move(m));
+		}
+
+	private:
+		// shared by wrapper and C socket, lives until both are gone
+		struct state {
+			std::recursive_mutex handlers_mutex; // handler is running, wrapper waits it on close
+			std::recursive_mutex socket_mutex; // 'socket' is not deleted while used
+			rws_socket socket = nullptr;
+			bool is_closed = false; // wrapper closed, no more handlers
+			bool is_external_loop = false; // otherwise socket is deleted by work thread after disconnect
+
+			connected_handler on_connected;
+			disconnected_handler on_disconnected;
+			text_handler on_text;
+			binary_handler on_binary;
+			message_handler on_message;
+		};
+
+		void close() {
+			if (!_state) {
+				return;
+			}
+			{
+				std::lock_guard<std::recursive_mutex> lock(_state->handlers_mutex);
+				_state->is_closed = true;
+			}
+			std::lock_guard<std::recursive_mutex> lock(_state->socket_mutex);
+			if (_state->socket) {
+				rws_socket s = _state->socket;
+				_state->socket = nullptr;
+				rws_socket_disconnect_and_release(s); // external loop mode deletes socket here
+			}
+		}
+
+		static state * state_of(rws_socket s) {
+			return static_cast<std::shared_ptr<state> *>(rws_socket_get_user_object(s))->get();
+		}
+
+		template <typename H, typename ... A>
+		static void invoke(rws_socket s, H state::*handler, A && ... args) {
+			state * st = state_of(s);
+			std::lock_guard<std::recursive_mutex> lock(st->handlers_mutex);
+			if (!st->is_closed && st->*handler) {
+				(st->*handler)(std::forward<A>(args)...);
+			}
+		}
+
+		static void on_deleted(rws_socket s) {
+			std::shared_ptr<state> * holder = static_cast<std::shared_ptr<state> *>(rws_socket_get_user_object(s));
+			{
+				std::lock_guard<std::recursive_mutex> lock((*holder)->socket_mutex);
+				(*holder)->socket = nullptr;
+			}
+			delete holder;
+		}
+
+		static void on_connected(rws_socket s) {
+			invoke(s, &state::on_connected);
+		}
+
+		static void on_disconnected(rws_socket s) {
+			state * st = state_of(s);
+			if (!st->is_external_loop) {
+				std::lock_guard<std::recursive_mutex> lock(st->socket_mutex);
+				st->socket = nullptr; // work thread deletes socket next
+			}
+			invoke(s, &state::on_disconnected, rws_socket_get_error(s));
+		}
+
+		static void on_text(rws_socket s, const char * text, const unsigned int length) {
+			invoke(s, &state::on_text, std::string_view(text, length));
+		}
+
+		static void on_binary(rws_socket s, const void * data, const unsigned int length) {
+			invoke(s, &state::on_binary, std::span<const std::byte>(static_cast<const std::byte *>(data), length));
+		}
+
+		static void on_received_message(rws_socket s, rws_message * received) {
+			message m(*received); // released here if wrapper is closed
+			invoke(s, &state::on_message, std::move(m));
+		}
+
+		std::shared_ptr<state> _state;
+	};
+
+} // namespace rws
+
+#endif
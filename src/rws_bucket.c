@@ -0,0 +1,146 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#include "rws_bucket.h"
+#include "rws_memory.h"
+
+void rws_bucket_set_rate(_rws_bucket * b, const unsigned int rate) {
+	b->rate = rate;
+	b->tokens = rate;
+	b->last_ms = 0;
+}
+
+rws_bool rws_bucket_is_limited(const _rws_bucket * b) {
+	return (b->rate > 0) ? rws_true : rws_false;
+}
+
+size_t rws_bucket_available(_rws_bucket * b, const unsigned long long now_ms) {
+	if (b->rate <= 0) {
+		return (size_t)-1;
+	}
+	if (b->last_ms && now_ms > b->last_ms) {
+		b->tokens += (b->rate * (now_ms - b->last_ms)) / 1000.0;
+		if (b->tokens > b->rate) {
+			b->tokens = b->rate;
+		}
+	}
+	b->last_ms = now_ms;
+	return (b->tokens >= 1) ? (size_t)b->tokens : 0;
+}
+
+void rws_bucket_consume(_rws_bucket * b, const size_t count) {
+	if (b->rate > 0) {
+		b->tokens -= count;
+	}
+}
+
+void rws_throttle_update(_rws_throttle * t, const rws_bool is_throttled, const unsigned long long now_ms) {
+	if (is_throttled) {
+		if (!t->since_ms) {
+			t->since_ms = now_ms;
+		}
+	} else if (t->since_ms) {
+		t->total_ms += now_ms - t->since_ms;
+		t->since_ms = 0;
+	}
+}
+
+unsigned long long rws_throttle_get_total(const _rws_throttle * t, const unsigned long long now_ms) {
+	unsigned long long total = t->total_ms;
+	if (t->since_ms && now_ms > t->since_ms) {
+		total += now_ms - t->since_ms;
+	}
+	return total;
+}
+
+rws_bool rws_rate_limit_is_send_limited(rws_rate_limit limit) {
+	return (rws_bucket_is_limited(&limit->send_msgs_bucket) || rws_bucket_is_limited(&limit->send_bytes_bucket)) ? rws_true : rws_false;
+}
+
+rws_bool rws_rate_limit_is_recv_limited(rws_rate_limit limit) {
+	return rws_bucket_is_limited(&limit->recv_bytes_bucket);
+}
+
+rws_bool rws_rate_limit_take_send(rws_rate_limit limit, const size_t size, const unsigned long long now_ms) {
+	rws_bool r = rws_false;
+	rws_mutex_lock(limit->mutex);
+	if (rws_bucket_available(&limit->send_msgs_bucket, now_ms) && rws_bucket_available(&limit->send_bytes_bucket, now_ms)) {
+		rws_bucket_consume(&limit->send_msgs_bucket, 1);
+		rws_bucket_consume(&limit->send_bytes_bucket, size);
+		r = rws_true;
+	}
+	rws_mutex_unlock(limit->mutex);
+	return r;
+}
+
+size_t rws_rate_limit_recv_available(rws_rate_limit limit, const unsigned long long now_ms) {
+	size_t r = 0;
+	rws_mutex_lock(limit->mutex);
+	r = rws_bucket_available(&limit->recv_bytes_bucket, now_ms);
+	rws_mutex_unlock(limit->mutex);
+	return r;
+}
+
+void rws_rate_limit_consume_recv(rws_rate_limit limit, const size_t count) {
+	rws_mutex_lock(limit->mutex);
+	rws_bucket_consume(&limit->recv_bytes_bucket, count);
+	rws_mutex_unlock(limit->mutex);
+}
+
+void rws_rate_limit_retain(rws_rate_limit limit) {
+	rws_mutex_lock(limit->mutex);
+	limit->refs++;
+	rws_mutex_unlock(limit->mutex);
+}
+
+void rws_rate_limit_release(rws_rate_limit limit) {
+	rws_bool is_free = rws_false;
+	rws_mutex_lock(limit->mutex);
+	is_free = (--limit->refs == 0) ? rws_true : rws_false;
+	rws_mutex_unlock(limit->mutex);
+	if (is_free) {
+		rws_mutex_delete(limit->mutex);
+		rws_free(limit);
+	}
+}
+
+rws_rate_limit rws_rate_limit_create(const unsigned int messages_per_sec,
+									 const unsigned int send_bytes_per_sec,
+									 const unsigned int recv_bytes_per_sec) {
+	rws_rate_limit limit = (rws_rate_limit)rws_malloc_zero(sizeof(struct rws_rate_limit_struct));
+	if (limit) {
+		limit->mutex = rws_mutex_create_recursive();
+		limit->refs = 1;
+		rws_bucket_set_rate(&limit->send_msgs_bucket, messages_per_sec);
+		rws_bucket_set_rate(&limit->send_bytes_bucket, send_bytes_per_sec);
+		rws_bucket_set_rate(&limit->recv_bytes_bucket, recv_bytes_per_sec);
+	}
+	return limit;
+}
+
+void rws_rate_limit_delete(rws_rate_limit limit) {
+	if (limit) {
+		rws_rate_limit_release(limit);
+	}
+}
@@ -0,0 +1,86 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#ifndef __RWS_BUCKET_H__
+#define __RWS_BUCKET_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+#include "rws_thread.h"
+
+// token bucket, 'rate' tokens per second with one second burst
+typedef struct _rws_bucket_struct {
+	double rate; // 0 - unlimited
+	double tokens;
+	unsigned long long last_ms;
+} _rws_bucket;
+
+// accumulates time spent in throttled state
+typedef struct _rws_throttle_struct {
+	unsigned long long since_ms; // 0 - not throttled now
+	unsigned long long total_ms;
+} _rws_throttle;
+
+void rws_bucket_set_rate(_rws_bucket * b, const unsigned int rate);
+
+rws_bool rws_bucket_is_limited(const _rws_bucket * b);
+
+// refill bucket and return number of available tokens, 0 if bucket is empty or in debt
+size_t rws_bucket_available(_rws_bucket * b, const unsigned long long now_ms);
+
+// bucket can go into debt, so frames larger than the burst are still sent
+void rws_bucket_consume(_rws_bucket * b, const size_t count);
+
+void rws_throttle_update(_rws_throttle * t, const rws_bool is_throttled, const unsigned long long now_ms);
+
+unsigned long long rws_throttle_get_total(const _rws_throttle * t, const unsigned long long now_ms);
+
+// buckets shared by sockets, rates are not changed after creation
+struct rws_rate_limit_struct {
+	rws_mutex mutex;
+	_rws_bucket send_msgs_bucket;
+	_rws_bucket send_bytes_bucket;
+	_rws_bucket recv_bytes_bucket;
+	size_t refs; // rate limit handle and not deleted sockets using it
+};
+
+rws_bool rws_rate_limit_is_send_limited(rws_rate_limit limit);
+
+rws_bool rws_rate_limit_is_recv_limited(rws_rate_limit limit);
+
+// consume one message of 'size' bytes if both send buckets are not empty, rws_false - limit exceeded
+rws_bool rws_rate_limit_take_send(rws_rate_limit limit, const size_t size, const unsigned long long now_ms);
+
+// 'rws_bucket_available' of the shared receive bucket
+size_t rws_rate_limit_recv_available(rws_rate_limit limit, const unsigned long long now_ms);
+
+void rws_rate_limit_consume_recv(rws_rate_limit limit, const size_t count);
+
+// socket starts using rate limit
+void rws_rate_limit_retain(rws_rate_limit limit);
+
+// socket stops using rate limit, freed with last reference
+void rws_rate_limit_release(rws_rate_limit limit);
+
+#endif
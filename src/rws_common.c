@@ -21,6 +21,75 @@
  */
 
 
+#if defined(_WIN32) && !defined(_CRT_RAND_S)
+#define _CRT_RAND_S 1 // 'rand_s', before stdlib.h
+#endif
+
 #include "rws_common.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#if !defined(RWS_OS_WINDOWS) && !defined(RWS_OS_APPLE)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// 1 - filled from the system source, 0 - source is not available
+static int rws_random_system_bytes(unsigned char * bytes, const size_t size) {
+#if defined(RWS_OS_WINDOWS)
+	unsigned int value = 0;
+	size_t i = 0;
+	for (i = 0; i < size; i++) {
+		if (rand_s(&value) != 0) {
+			return 0;
+		}
+		bytes[i] = (unsigned char)value;
+	}
+	return 1;
+#elif defined(RWS_OS_APPLE)
+	arc4random_buf(bytes, size);
+	return 1;
+#else
+	size_t done = 0;
+	ssize_t len = 0;
+	const int fd = open("/dev/urandom", O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+	while (done < size) {
+		len = read(fd, bytes + done, size - done);
+		if (len > 0) {
+			done += (size_t)len;
+		} else if (len < 0 && errno == EINTR) {
+			continue;
+		} else {
+			break;
+		}
+	}
+	close(fd);
+	return (done == size) ? 1 : 0;
+#endif
+}
+
+void rws_random_bytes(void * buff, const size_t size) {
+	unsigned char * bytes = (unsigned char *)buff;
+	unsigned long long x = 0;
+	size_t i = 0;
+	if (rws_random_system_bytes(bytes, size)) {
+		return;
+	}
+	// xorshift seeded by time, clock and stack address, differs between processes and calls
+	x = ((unsigned long long)time(NULL) << 20) ^ (unsigned long long)clock() ^ (unsigned long long)(size_t)&x;
+	x ^= 0x9E3779B97F4A7C15ULL;
+	for (i = 0; i < size; i++) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		bytes[i] = (unsigned char)(x >> 32);
+	}
+}
+
 
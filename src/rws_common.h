@@ -65,5 +65,24 @@
 #endif
 #endif
 
+/* separation of the data written by different threads */
+#if !defined(RWS_CACHE_LINE_SIZE)
+#if defined(RWS_OS_APPLE) && defined(__aarch64__)
+#define RWS_CACHE_LINE_SIZE 128
+#else
+#define RWS_CACHE_LINE_SIZE 64
+#endif
+#endif
+
+/* field starts new cache line, struct with it should be allocated with 'rws_malloc_zero_aligned' */
+#if defined(_MSC_VER)
+#define RWS_CACHE_ALIGNED __declspec(align(RWS_CACHE_LINE_SIZE))
+#else
+#define RWS_CACHE_ALIGNED __attribute__((aligned(RWS_CACHE_LINE_SIZE)))
+#endif
+
+/* random bytes from the system source, seeded generator if the source is not available */
+void rws_random_bytes(void * buff, const size_t size);
+
 #endif
 
@@ -0,0 +1,188 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#include "rws_endpoints.h"
+#include "rws_socket.h"
+#include "rws_memory.h"
+#include "rws_string.h"
+
+// exponentially weighted average with 1/8 weight of the new sample, first sample as is
+static unsigned int rws_endpoints_smooth(const unsigned int average, const unsigned int sample) {
+	const unsigned int value = sample ? sample : 1; // 0 - not measured
+	if (!average) {
+		return value;
+	}
+	return (unsigned int)(((unsigned long long)average * 7 + value) / 8);
+}
+
+int rws_endpoints_select(rws_endpoints endpoints, const unsigned int tried) {
+	const unsigned long long now = rws_time_ms();
+	const _rws_endpoint * item = NULL;
+	unsigned int score = 0, best_score = 0;
+	unsigned long long best_retry = 0;
+	int best = -1, retry = -1;
+	size_t i = 0;
+
+	rws_mutex_lock(endpoints->mutex);
+	for (i = 0; i < endpoints->count; i++) {
+		if (tried & (1u << i)) {
+			continue;
+		}
+		item = &endpoints->items[i];
+		if (item->retry_ms > now) { // not healthy, only if all are not healthy
+			if (retry < 0 || item->retry_ms < best_retry) {
+				retry = (int)i;
+				best_retry = item->retry_ms;
+			}
+			continue;
+		}
+		score = item->rtt_us ? item->rtt_us : item->handshake_us;
+		if (best < 0 || score < best_score) {
+			best = (int)i;
+			best_score = score;
+		}
+	}
+	rws_mutex_unlock(endpoints->mutex);
+	return (best >= 0) ? best : retry;
+}
+
+const _rws_endpoint * rws_endpoints_get(rws_endpoints endpoints, const int index) {
+	const _rws_endpoint * item = NULL;
+	rws_mutex_lock(endpoints->mutex);
+	if (index >= 0 && (size_t)index < endpoints->count) {
+		item = &endpoints->items[index];
+	}
+	rws_mutex_unlock(endpoints->mutex);
+	return item;
+}
+
+void rws_endpoints_report_connected(rws_endpoints endpoints, const int index, const unsigned int handshake_us) {
+	_rws_endpoint * item = &endpoints->items[index];
+	rws_mutex_lock(endpoints->mutex);
+	item->handshake_us = rws_endpoints_smooth(item->handshake_us, handshake_us);
+	item->failures = 0;
+	item->retry_ms = 0;
+	rws_mutex_unlock(endpoints->mutex);
+}
+
+void rws_endpoints_report_rtt(rws_endpoints endpoints, const int index, const unsigned int rtt_us) {
+	_rws_endpoint * item = &endpoints->items[index];
+	rws_mutex_lock(endpoints->mutex);
+	item->rtt_us = rws_endpoints_smooth(item->rtt_us, rtt_us);
+	rws_mutex_unlock(endpoints->mutex);
+}
+
+void rws_endpoints_report_failed(rws_endpoints endpoints, const int index) {
+	_rws_endpoint * item = &endpoints->items[index];
+	unsigned int shift = 0;
+	rws_mutex_lock(endpoints->mutex);
+	shift = (item->failures < RWS_ENDPOINT_MAX_RETRY_SHIFT) ? item->failures : RWS_ENDPOINT_MAX_RETRY_SHIFT;
+	item->failures++;
+	item->retry_ms = rws_time_ms() + ((unsigned long long)RWS_ENDPOINT_RETRY_DELAY << shift);
+	rws_mutex_unlock(endpoints->mutex);
+}
+
+static void rws_endpoints_free(rws_endpoints endpoints) {
+	size_t i = 0;
+	for (i = 0; i < endpoints->count; i++) {
+		rws_string_delete(endpoints->items[i].scheme);
+		rws_string_delete(endpoints->items[i].host);
+		rws_string_delete(endpoints->items[i].path);
+	}
+	rws_mutex_delete(endpoints->mutex);
+	rws_free(endpoints);
+}
+
+void rws_endpoints_retain(rws_endpoints endpoints) {
+	rws_mutex_lock(endpoints->mutex);
+	endpoints->refs++;
+	rws_mutex_unlock(endpoints->mutex);
+}
+
+void rws_endpoints_release(rws_endpoints endpoints) {
+	rws_bool is_free = rws_false;
+	rws_mutex_lock(endpoints->mutex);
+	is_free = (--endpoints->refs == 0) ? rws_true : rws_false;
+	rws_mutex_unlock(endpoints->mutex);
+	if (is_free) {
+		rws_endpoints_free(endpoints);
+	}
+}
+
+rws_endpoints rws_endpoints_create(void) {
+	rws_endpoints endpoints = (rws_endpoints)rws_malloc_zero(sizeof(struct rws_endpoints_struct));
+	if (endpoints) {
+		endpoints->mutex = rws_mutex_create_recursive();
+		endpoints->refs = 1;
+	}
+	return endpoints;
+}
+
+rws_bool rws_endpoints_add(rws_endpoints endpoints,
+						   const char * scheme,
+						   const char * host,
+						   const int port,
+						   const char * path) {
+	_rws_endpoint * item = NULL;
+	// unix domain socket has no port
+	if (!endpoints || !scheme || !host || !path || port < 0 || (!port && strcmp(scheme, RWS_UNIX_SCHEME) != 0)) {
+		return rws_false;
+	}
+	rws_mutex_lock(endpoints->mutex);
+	if (endpoints->count < RWS_ENDPOINTS_MAX) {
+		item = &endpoints->items[endpoints->count];
+		item->scheme = rws_string_copy(scheme);
+		item->host = rws_string_copy(host);
+		item->path = rws_string_copy(path);
+		item->port = port;
+		endpoints->count++;
+	}
+	rws_mutex_unlock(endpoints->mutex);
+	return item ? rws_true : rws_false;
+}
+
+unsigned int rws_endpoints_get_handshake_time(rws_endpoints endpoints, const unsigned int index) {
+	unsigned int r = 0;
+	if (endpoints) {
+		rws_mutex_lock(endpoints->mutex);
+		r = (index < endpoints->count) ? endpoints->items[index].handshake_us : 0;
+		rws_mutex_unlock(endpoints->mutex);
+	}
+	return r;
+}
+
+unsigned int rws_endpoints_get_rtt(rws_endpoints endpoints, const unsigned int index) {
+	unsigned int r = 0;
+	if (endpoints) {
+		rws_mutex_lock(endpoints->mutex);
+		r = (index < endpoints->count) ? endpoints->items[index].rtt_us : 0;
+		rws_mutex_unlock(endpoints->mutex);
+	}
+	return r;
+}
+
+void rws_endpoints_delete(rws_endpoints endpoints) {
+	if (endpoints) {
+		rws_endpoints_release(endpoints);
+	}
+}
@@ -0,0 +1,73 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#ifndef __RWS_ENDPOINTS_H__
+#define __RWS_ENDPOINTS_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+#include "rws_thread.h"
+
+// failed endpoint is not selected for this time, doubled by each next failure
+#define RWS_ENDPOINT_RETRY_DELAY 1000
+#define RWS_ENDPOINT_MAX_RETRY_SHIFT 6
+
+typedef struct _rws_endpoint_struct {
+	char * scheme;
+	char * host;
+	char * path;
+	int port;
+
+	unsigned int handshake_us; // smoothed connect and handshake time, 0 - not measured
+	unsigned int rtt_us; // smoothed ping round trip time, 0 - not measured
+	unsigned int failures; // failed connects in a row
+	unsigned long long retry_ms; // not healthy till this time
+} _rws_endpoint;
+
+// equivalent URLs of one service with statistics, shared by sockets
+struct rws_endpoints_struct {
+	rws_mutex mutex;
+	_rws_endpoint items[RWS_ENDPOINTS_MAX]; // URL is not changed after adding
+	size_t count;
+	size_t refs; // endpoints handle and not deleted sockets using endpoints
+};
+
+// fastest healthy endpoint not in the 'tried' bit mask, not measured endpoints first, -1 - all tried
+int rws_endpoints_select(rws_endpoints endpoints, const unsigned int tried);
+
+// URL of the endpoint, strings live while endpoints object
+const _rws_endpoint * rws_endpoints_get(rws_endpoints endpoints, const int index);
+
+void rws_endpoints_report_connected(rws_endpoints endpoints, const int index, const unsigned int handshake_us);
+
+void rws_endpoints_report_rtt(rws_endpoints endpoints, const int index, const unsigned int rtt_us);
+
+void rws_endpoints_report_failed(rws_endpoints endpoints, const int index);
+
+// socket starts using endpoints
+void rws_endpoints_retain(rws_endpoints endpoints);
+
+// socket stops using endpoints, freed with last reference
+void rws_endpoints_release(rws_endpoints endpoints);
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#include "rws_executor.h"
+#include "rws_socket.h"
+#include "rws_memory.h"
+
+static _rws_serial_queue * rws_executor_take_ready(rws_executor e) {
+	_rws_serial_queue * queue = e->ready_first;
+	if (queue) {
+		e->ready_first = queue->next;
+		if (!e->ready_first) {
+			e->ready_last = NULL;
+		}
+		queue->next = NULL;
+	}
+	return queue;
+}
+
+static void rws_executor_add_ready(rws_executor e, _rws_serial_queue * queue) {
+	queue->next = NULL;
+	if (e->ready_last) {
+		e->ready_last->next = queue;
+	} else {
+		e->ready_first = queue;
+	}
+	e->ready_last = queue;
+	rws_cond_signal(e->work_cond);
+}
+
+static void rws_executor_th_func(void * user_object) {
+	rws_executor e = (rws_executor)user_object;
+	_rws_serial_queue * queue = NULL;
+	rws_message * messages = NULL;
+	size_t count = 0, size = 0;
+
+	rws_mutex_lock(e->mutex);
+	while (!e->is_stopping || e->ready_first) {
+		queue = rws_executor_take_ready(e);
+		if (!queue) {
+			rws_cond_wait(e->work_cond, e->mutex);
+			continue;
+		}
+
+		// swap buffers, socket continues to append while messages are dispatched
+		messages = queue->messages;
+		count = queue->count;
+		size = queue->size;
+		queue->messages = queue->dispatching;
+		queue->size = queue->dispatching_size;
+		queue->count = 0;
+		queue->dispatching = messages;
+		queue->dispatching_size = size;
+		rws_mutex_unlock(e->mutex);
+
+		rws_socket_dispatch_messages(queue->socket, messages, count);
+
+		rws_mutex_lock(e->mutex);
+		if (queue->count) {
+			rws_executor_add_ready(e, queue); // to the end, other sockets are not starved
+		} else {
+			queue->is_scheduled = rws_false;
+			rws_cond_broadcast(e->done_cond);
+		}
+	}
+	e->threads_count--;
+	rws_cond_broadcast(e->done_cond);
+	rws_mutex_unlock(e->mutex);
+}
+
+// public
+
+rws_executor rws_executor_create(const unsigned int threads_count) {
+	unsigned int i = 0;
+	rws_executor e = (rws_executor)rws_malloc_zero(sizeof(struct rws_executor_struct));
+	if (!e) {
+		return NULL;
+	}
+	e->mutex = rws_mutex_create_recursive();
+	e->work_cond = rws_cond_create();
+	e->done_cond = rws_cond_create();
+
+	rws_mutex_lock(e->mutex);
+	for (i = 0; i < (threads_count ? threads_count : 1); i++) {
+		if (rws_thread_create_with_attr(&rws_executor_th_func, e, NULL, "rws-executor")) {
+			e->threads_count++;
+		}
+	}
+	rws_mutex_unlock(e->mutex);
+
+	if (!e->threads_count) { // pushed messages would never be dispatched
+		rws_cond_delete(e->work_cond);
+		rws_cond_delete(e->done_cond);
+		rws_mutex_delete(e->mutex);
+		rws_free(e);
+		return NULL;
+	}
+	return e;
+}
+
+void rws_executor_delete(rws_executor executor) {
+	if (!executor) {
+		return;
+	}
+	rws_mutex_lock(executor->mutex);
+	executor->is_stopping = rws_true;
+	rws_cond_broadcast(executor->work_cond);
+	while (executor->threads_count) {
+		rws_cond_wait(executor->done_cond, executor->mutex);
+	}
+	rws_mutex_unlock(executor->mutex);
+
+	rws_cond_delete(executor->work_cond);
+	rws_cond_delete(executor->done_cond);
+	rws_mutex_delete(executor->mutex);
+	rws_free(executor);
+}
+
+// private
+
+void rws_executor_push(rws_executor executor, _rws_serial_queue * queue, const rws_message * message) {
+	rws_message * messages = NULL;
+	rws_mutex_lock(executor->mutex);
+	if (queue->count == queue->size) {
+		queue->size = queue->size ? queue->size * 2 : 16;
+		messages = (rws_message *)rws_malloc(queue->size * sizeof(rws_message));
+		if (queue->count) {
+			memcpy(messages, queue->messages, queue->count * sizeof(rws_message));
+		}
+		rws_free(queue->messages);
+		queue->messages = messages;
+	}
+	queue->messages[queue->count++] = *message;
+	if (!queue->is_scheduled) {
+		queue->is_scheduled = rws_true;
+		rws_executor_add_ready(executor, queue);
+	}
+	rws_mutex_unlock(executor->mutex);
+}
+
+size_t rws_executor_get_pending(rws_executor executor, _rws_serial_queue * queue) {
+	size_t count = 0;
+	rws_mutex_lock(executor->mutex);
+	count = queue->count;
+	rws_mutex_unlock(executor->mutex);
+	return count;
+}
+
+void rws_executor_drain(rws_executor executor, _rws_serial_queue * queue) {
+	rws_mutex_lock(executor->mutex);
+	while (queue->is_scheduled) {
+		rws_cond_wait(executor->done_cond, executor->mutex);
+	}
+	rws_mutex_unlock(executor->mutex);
+}
+
+void rws_executor_clean_queue(rws_executor executor, _rws_serial_queue * queue) {
+	if (executor) {
+		rws_executor_drain(executor, queue);
+	}
+	rws_free(queue->messages);
+	rws_free(queue->dispatching);
+	memset(queue, 0, sizeof(_rws_serial_queue));
+}
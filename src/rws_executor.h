@@ -0,0 +1,78 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#ifndef __RWS_EXECUTOR_H__
+#define __RWS_EXECUTOR_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+#include "rws_thread.h"
+
+// maximum number of not dispatched messages of the socket, socket stops reading above it
+#define RWS_EXECUTOR_MAX_PENDING 1024
+
+// messages of one socket, dispatched by one executor thread at a time to keep the order
+typedef struct _rws_serial_queue_struct {
+	rws_socket socket;
+
+	rws_message * messages; // pending
+	size_t count;
+	size_t size;
+
+	rws_message * dispatching; // taken by executor thread
+	size_t dispatching_size;
+
+	rws_bool is_scheduled; // in ready list or dispatching
+	struct _rws_serial_queue_struct * next; // ready list
+} _rws_serial_queue;
+
+struct rws_executor_struct {
+	rws_mutex mutex;
+	rws_cond work_cond; // ready queue or stop
+	rws_cond done_cond; // queue dispatched or thread finished
+
+	_rws_serial_queue * ready_first;
+	_rws_serial_queue * ready_last;
+
+	unsigned int threads_count; // running threads
+	rws_bool is_stopping;
+};
+
+// executor thread side, informs application and frees messages
+void rws_socket_dispatch_messages(rws_socket s, rws_message * messages, const size_t count);
+
+// queue new message of the socket
+void rws_executor_push(rws_executor executor, _rws_serial_queue * queue, const rws_message * message);
+
+// number of not dispatched messages
+size_t rws_executor_get_pending(rws_executor executor, _rws_serial_queue * queue);
+
+// wait all messages of the queue are dispatched, should not be called from executor thread
+void rws_executor_drain(rws_executor executor, _rws_serial_queue * queue);
+
+// drain and free queue memory
+void rws_executor_clean_queue(rws_executor executor, _rws_serial_queue * queue);
+
+#endif
+
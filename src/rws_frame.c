@@ -25,99 +25,121 @@
 #include "rws_memory.h"
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <errno.h>
+
+#if !defined(RWS_OS_WINDOWS)
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+static void rws_frame_free_data(_rws_frame * f) {
+	if (f->spill) {
+		rws_spill_delete(f->spill);
+		f->spill = NULL;
+	} else if (f->buffer) {
+		rws_free(f->buffer);
+		f->buffer = NULL;
+	} else if (f->data != f->inline_data) {
+		rws_free(f->data);
+	}
+	f->data = NULL;
+}
+
+// inline storage for small data, replaces previous data
+static void * rws_frame_alloc_data(_rws_frame * f, const size_t size) {
+	rws_frame_free_data(f);
+	f->data = (size <= RWS_FRAME_INLINE_SIZE) ? f->inline_data : rws_malloc(size);
+	return f->data;
+}
+
+// header size and full 64 bit payload length, 0 - header is not complete
+static size_t rws_frame_parse_recv_header(const void * data, const size_t data_size, unsigned long long * payload_size) {
+	const unsigned char * udata = (const unsigned char *)data;
+	size_t header_size = 2, length_size = 0, i = 0;
+	unsigned long long size = 0;
+
+	if (!data || data_size < 2) {
+		return 0;
+	}
+	switch (udata[1] & 0x7f) {
+		case 126: length_size = 2; break;
+		case 127: length_size = 8; break;
+		default: size = udata[1] & 0x7f; break;
+	}
+	header_size += length_size + (((udata[1] >> 7) & 0x01) ? 4 : 0);
+	if (data_size < header_size) {
+		return 0;
+	}
+	for (i = 0; i < length_size; i++) {
+		size = (size << 8) | udata[2 + i];
+	}
+	*payload_size = size;
+	return header_size;
+}
+
+rws_bool rws_frame_get_recv_payload_size(const void * data, const size_t data_size, unsigned long long * payload_size) {
+	return rws_frame_parse_recv_header(data, data_size, payload_size) ? rws_true : rws_false;
+}
+
+_rws_frame * rws_frame_create_with_recv_header(const void * data, const size_t data_size, size_t * payload_size) {
+	const unsigned char * udata = (const unsigned char *)data;
+	unsigned long long expected_size = 0;
+	const size_t header_size = rws_frame_parse_recv_header(data, data_size, &expected_size);
+	_rws_frame * frame = NULL;
+
+	if (!header_size || expected_size > RWS_FRAME_MAX_RECV_PAYLOAD_SIZE) {
+		return NULL;
+	}
+
+	frame = rws_frame_create();
+
+	frame->opcode = (rws_opcode)(udata[0] & 0x0f);
+	if ((udata[0] >> 7) & 0x01) frame->is_finished = rws_true;
+	frame->header_size = (unsigned char)header_size;
+
+	if ((udata[1] >> 7) & 0x01) {
+		frame->is_masked = rws_true;
+		memcpy(frame->mask, &udata[header_size - 4], 4);
+	}
+
+	*payload_size = (size_t)expected_size;
+	return frame;
+}
 
 _rws_frame * rws_frame_create_with_recv_data(const void * data, const size_t data_size) {
-	if (data && data_size >= 2) {
-		const unsigned char * udata = (const unsigned char *)data;
-		
-		const rws_opcode opcode = (rws_opcode)(udata[0] & 0x0f);
-		const unsigned int is_finshd = (udata[0] >> 7) & 0x01;
-		const unsigned int is_masked = (udata[1] >> 7) & 0x01;
-		const unsigned int payload = udata[1] & 0x7f;
-		unsigned int header_size = is_masked ? 6 : 2;
-		
-		unsigned int expected_size = 0, mask_pos = 0;
-		size_t index = 0;
-		_rws_frame * frame = NULL;
-		const unsigned char * actual_udata = NULL;
-		unsigned char * unmasked = NULL;
-		
-		switch (payload) {
-			case 126: header_size += 2; break;
-			case 127: header_size += 8; break;
-			default: break;
-		}
-		
-		if (data_size < header_size) {
-			return NULL;
-		}
-		
-		switch (payload) {
-			case 126:
-				expected_size |= ((unsigned int)udata[2]) << 8;
-				expected_size |= (unsigned int)udata[3];
-				mask_pos = 4;
-				break;
-				
-			case 127:
-				expected_size |= ((unsigned int)udata[6]) << 24;
-				expected_size |= ((unsigned int)udata[7]) << 16;
-				expected_size |= ((unsigned int)udata[8]) << 8;
-				expected_size |= (unsigned int)udata[9];
-				mask_pos = 10;
-				break;
-				
-			default:
-				if (payload <= 125) {
-					mask_pos = 2;
-					expected_size = payload;
-				}
-				break;
-		}
-		
-		frame = rws_frame_create();
-		
-		frame->opcode = opcode;
-		if (is_finshd) frame->is_finished = rws_true;
-		frame->header_size = (unsigned char)header_size;
-		
-		if (is_masked) {
-			frame->is_masked = rws_true;
-			memcpy(frame->mask, &udata[mask_pos], 4);
-		}
-		
-		if (opcode == rws_opcode_connection_close || opcode == rws_opcode_pong) {
-			return frame;
-		}
-		
-		if (!is_finshd) {
-			frame->is_finished = rws_false;
-		}
-		
-		if (expected_size > 0) {
-			frame->data = rws_malloc(expected_size);
-			frame->data_size = expected_size;
-			actual_udata = udata + header_size;
-			if (is_masked) {
-				unmasked = (unsigned char *)frame->data;
-				for (index = 0; index < expected_size; index++) {
-					*unmasked = *actual_udata ^ frame->mask[index & 0x3];
-					unmasked++; actual_udata++;
-				}
-			} else {
-				memcpy(frame->data, actual_udata, expected_size);
+	size_t expected_size = 0, index = 0;
+	_rws_frame * frame = rws_frame_create_with_recv_header(data, data_size, &expected_size);
+	const unsigned char * actual_udata = NULL;
+	unsigned char * unmasked = NULL;
+
+	if (!frame || frame->opcode == rws_opcode_pong) {
+		return frame;
+	}
+
+	if (expected_size > 0) {
+		rws_frame_alloc_data(frame, expected_size);
+		frame->data_size = expected_size;
+		actual_udata = (const unsigned char *)data + frame->header_size;
+		if (frame->is_masked) {
+			unmasked = (unsigned char *)frame->data;
+			for (index = 0; index < expected_size; index++) {
+				*unmasked = *actual_udata ^ frame->mask[index & 0x3];
+				unmasked++; actual_udata++;
 			}
+		} else {
+			memcpy(frame->data, actual_udata, expected_size);
 		}
-		return frame;
 	}
-	return NULL;
+	return frame;
 }
 
 void rws_frame_create_header(_rws_frame * f, unsigned char * header, const size_t data_size) {
-	const unsigned int size = (unsigned int)data_size;
+	const unsigned long long size = data_size;
+	int shift = 0;
 	
 	*header++ = 0x80 | f->opcode;
 	if (size < 126) {
@@ -130,14 +152,9 @@ void rws_frame_create_header(_rws_frame * f, unsigned char * header, const size_
 		f->header_size = 4;
 	} else {
 		*header++ = 127 | (f->is_masked ? 0x80 : 0);
-		
-		*(unsigned int *)header = 0;
-		header += 4;
-		
-		*header++ = (size >> 24) & 0xff;
-		*header++ = (size >> 16) & 0xff;
-		*header++ = (size >> 8) & 0xff;
-		*header++ = size & 0xff;
+		for (shift = 56; shift >= 0; shift -= 8) { // full 64 bit length, header is not aligned
+			*header++ = (unsigned char)((size >> shift) & 0xff);
+		}
 		f->header_size = 10;
 	}
 	
@@ -155,8 +172,7 @@ void rws_frame_fill_with_send_data(_rws_frame * f, const void * data, const size
 	
 	rws_frame_create_header(f, header, data_size);
 	f->data_size = data_size + f->header_size;
-	f->data = rws_malloc(f->data_size);
-	frame = (unsigned char *)f->data;
+	frame = (unsigned char *)rws_frame_alloc_data(f, f->data_size);
 	memcpy(frame, header, f->header_size);
 	
 	if (data) { // have data to send
@@ -174,29 +190,163 @@ void rws_frame_fill_with_send_data(_rws_frame * f, const void * data, const size
 	f->is_finished = rws_true;
 }
 
+_rws_frame * rws_frame_create_with_encoded_data(const void * data, const size_t data_size) {
+	const unsigned char * udata = (const unsigned char *)data;
+	_rws_frame * f = rws_frame_create();
+	f->opcode = (rws_opcode)(udata[0] & 0x0f);
+	f->is_finished = (udata[0] & 0x80) ? rws_true : rws_false;
+	f->is_masked = (udata[1] & 0x80) ? rws_true : rws_false;
+	f->data_size = data_size;
+	memcpy(rws_frame_alloc_data(f, data_size), data, data_size);
+	return f;
+}
+
+_rws_frame * rws_frame_create_for_send(const rws_opcode opcode, const size_t data_size) {
+	_rws_frame * f = rws_frame_create();
+	f->buffer = rws_malloc(RWS_FRAME_MAX_HEADER_SIZE + data_size);
+	f->data = (unsigned char *)f->buffer + RWS_FRAME_MAX_HEADER_SIZE;
+	f->data_size = data_size;
+	f->opcode = opcode;
+	f->is_masked = rws_true;
+	return f;
+}
+
+void rws_frame_encode_in_place(_rws_frame * f) {
+	unsigned char header[16];
+	unsigned char * data = (unsigned char *)f->data;
+	size_t index = 0;
+	rws_frame_create_header(f, header, f->data_size);
+	for (index = 0; index < f->data_size; index++) {
+		data[index] ^= f->mask[index & 0x3];
+	}
+	f->data = data - f->header_size;
+	memcpy(f->data, header, f->header_size);
+	f->data_size += f->header_size;
+	f->is_finished = rws_true;
+}
+
+_rws_frame * rws_frame_create_with_file(const int fd, const unsigned long long offset, const unsigned long long size) {
+	_rws_frame * f = rws_frame_create();
+	f->file = (_rws_send_file *)rws_malloc_zero(sizeof(_rws_send_file));
+	f->file->fd = fd;
+	f->file->offset = offset;
+	f->file->left = size;
+	f->opcode = rws_opcode_binary_frame;
+	f->is_masked = rws_true;
+	return f;
+}
+
+_rws_frame * rws_frame_create_file_part(_rws_frame * f) {
+#if defined(RWS_OS_WINDOWS)
+	(void)f;
+	return NULL;
+#else
+	_rws_send_file * file = f->file;
+	const size_t size = (file->left < RWS_FRAME_FILE_PART_SIZE) ? (size_t)file->left : RWS_FRAME_FILE_PART_SIZE;
+	unsigned char header[16];
+	unsigned char * data = NULL;
+	size_t readed = 0, index = 0;
+	ssize_t len = 0;
+	_rws_frame * part = rws_frame_create();
+
+	part->is_masked = rws_true;
+	part->opcode = file->is_started ? rws_opcode_continuation : rws_opcode_binary_frame;
+	part->is_finished = (size == file->left) ? rws_true : rws_false;
+	rws_frame_create_header(part, header, size);
+	if (!part->is_finished) {
+		header[0] &= 0x7f;
+	}
+	part->data_size = part->header_size + size;
+	data = (unsigned char *)rws_frame_alloc_data(part, part->data_size);
+	memcpy(data, header, part->header_size);
+	data += part->header_size;
+
+	while (readed < size) { // payload is read directly to the frame and masked in place
+		len = pread(file->fd, data + readed, size - readed, (off_t)(file->offset + readed));
+		if (len <= 0) {
+			if (len < 0 && errno == EINTR) {
+				continue;
+			}
+			rws_frame_delete(part);
+			return NULL;
+		}
+		readed += (size_t)len;
+	}
+	for (index = 0; index < size; index++) {
+		data[index] ^= part->mask[index & 0x3];
+	}
+	file->offset += size;
+	file->left -= size;
+	file->is_started = rws_true;
+	return part;
+#endif
+}
+
 void rws_frame_combine_datas(_rws_frame * to, _rws_frame * from) {
-	unsigned char * comb_data = (unsigned char *)rws_malloc(to->data_size + from->data_size);
+	const size_t size = to->data_size + from->data_size;
+	unsigned char * comb_data = NULL;
+	if (size <= RWS_FRAME_INLINE_SIZE) { // smaller 'to' data is already inline
+		if (from->data && from->data_size) {
+			memcpy(to->inline_data + to->data_size, from->data, from->data_size);
+		}
+		to->data = to->inline_data;
+		to->data_size = size;
+		return;
+	}
+	comb_data = (unsigned char *)rws_malloc(size);
 	if (comb_data) {
 		if (to->data && to->data_size) {
 			memcpy(comb_data, to->data, to->data_size);
 		}
-		comb_data += to->data_size;
 		if (from->data && from->data_size) {
-			memcpy(comb_data, from->data, from->data_size);
+			memcpy(comb_data + to->data_size, from->data, from->data_size);
 		}
 	}
-	rws_free(to->data);
+	rws_frame_free_data(to);
 	to->data = comb_data;
-	to->data_size += from->data_size;
+	to->data_size = size;
+}
+
+rws_bool rws_frame_spill(_rws_frame * f, const char * directory, const size_t size) {
+	_rws_spill * spill = rws_spill_create(directory, (f->data_size > size) ? f->data_size : size);
+	if (!spill) {
+		return rws_false;
+	}
+	if (f->data && f->data_size) {
+		memcpy(spill->map, f->data, f->data_size);
+	}
+	spill->len = f->data_size;
+	rws_frame_free_data(f);
+	f->spill = spill;
+	f->data = spill->map;
+	return rws_true;
+}
+
+void * rws_frame_spill_reserve(_rws_frame * f, const size_t size) {
+	return rws_spill_reserve(f->spill, size);
+}
+
+void rws_frame_spill_commit(_rws_frame * f, const size_t size) {
+	f->spill->len += size;
+	f->data = f->spill->map; // can be moved by reserve
+	f->data_size = f->spill->len;
+}
+
+void rws_frame_to_message(_rws_frame * f, rws_message * message) {
+	message->data = f->data;
+	message->data_size = f->data_size;
+	message->is_text = (f->opcode == rws_opcode_text_frame) ? rws_true : rws_false;
+	message->priv = f;
 }
 
 _rws_frame * rws_frame_create(void) {
-	_rws_frame * f = (_rws_frame *)rws_malloc_zero(sizeof(_rws_frame));
+	_rws_frame * f = (_rws_frame *)rws_malloc(sizeof(_rws_frame));
 	union {
 		unsigned int ui;
 		unsigned char b[4];
 	} mask_union;
 	assert(sizeof(unsigned int) == 4);
+	memset(f, 0, offsetof(_rws_frame, inline_data)); // inline data is written before use
 	//	mask_union.ui = 2018915346;
 	mask_union.ui = (rand() / (RAND_MAX / 2) + 1) * rand();
 	memcpy(f->mask, mask_union.b, 4);
@@ -205,7 +355,13 @@ _rws_frame * rws_frame_create(void) {
 
 void rws_frame_delete(_rws_frame * f) {
 	if (f) {
-		rws_free(f->data);
+		if (f->file) {
+#if !defined(RWS_OS_WINDOWS)
+			close(f->file->fd);
+#endif
+			rws_free(f->file);
+		}
+		rws_frame_free_data(f);
 		rws_free(f);
 	}
 }
@@ -217,50 +373,21 @@ void rws_frame_delete_clean(_rws_frame ** f) {
 	}
 }
 
+// public
+void rws_message_free(rws_message * message) {
+	if (message) {
+		rws_frame_delete((_rws_frame *)message->priv);
+		memset(message, 0, sizeof(rws_message));
+	}
+}
+
 size_t rws_check_recv_frame_size(const void * data, const size_t data_size) {
-	if (data && data_size >= 2) {
-		const unsigned char * udata = (const unsigned char *)data;
-		//        const unsigned int is_finshd = (udata[0] >> 7) & 0x01;
-		const unsigned int is_masked = (udata[1] >> 7) & 0x01;
-		const unsigned int payload = udata[1] & 0x7f;
-		unsigned int header_size = is_masked ? 6 : 2;
-		
-		unsigned int expected_size = 0;
-		
-		switch (payload) {
-			case 126: header_size += 2; break;
-			case 127: header_size += 8; break;
-			default: break;
-		}
-		
-		if (data_size < header_size) {
-			return 0;
-		}
-		
-		switch (payload) {
-			case 126:
-				expected_size |= ((unsigned int)udata[2]) << 8;
-				expected_size |= (unsigned int)udata[3];
-				break;
-				
-			case 127:
-				expected_size |= ((unsigned int)udata[6]) << 24;
-				expected_size |= ((unsigned int)udata[7]) << 16;
-				expected_size |= ((unsigned int)udata[8]) << 8;
-				expected_size |= (unsigned int)udata[9];
-				break;
-				
-			default:
-				if (payload <= 125) {
-					expected_size = payload;
-				}
-				break;
-		}
-		
-		const unsigned int nPackSize = expected_size + header_size;
-		return (nPackSize <= data_size) ? nPackSize : 0;
+	unsigned long long payload_size = 0;
+	const size_t header_size = rws_frame_parse_recv_header(data, data_size, &payload_size);
+	if (!header_size || payload_size > data_size - header_size) {
+		return 0;
 	}
-	return 0;
+	return header_size + (size_t)payload_size;
 }
 
 
@@ -26,6 +26,7 @@
 
 #include "../librws.h"
 #include "rws_common.h"
+#include "rws_spill.h"
 
 typedef enum _rws_opcode {
 	rws_opcode_continuation = 0x0, // %x0 denotes a continuation frame
@@ -36,26 +37,87 @@ typedef enum _rws_opcode {
 	rws_opcode_pong = 0xA // %xA denotes a pong
 } rws_opcode;
 
+// frames up to this size, including header, are stored inside the frame without second allocation
+#define RWS_FRAME_INLINE_SIZE 128
+
+// biggest header of the masked frame, reserved before data of the message allocated for sending
+#define RWS_FRAME_MAX_HEADER_SIZE 14
+
+// biggest received frame or message, lengths are passed to callbacks as unsigned int
+#define RWS_FRAME_MAX_RECV_PAYLOAD_SIZE 0xFFFFFFFFULL
+
+// payload bytes of one frame of the message sent from file
+#define RWS_FRAME_FILE_PART_SIZE 65536
+
+// binary message sent from file, frames are read by parts when sending
+typedef struct _rws_send_file_struct {
+	int fd; // owned, closed with frame
+	unsigned long long offset; // next byte to send
+	unsigned long long left; // bytes to send
+	rws_bool is_started; // first frame created, next are continuation
+} _rws_send_file;
+
 typedef struct _rws_frame_struct {
-	void * data;
+	void * data; // 'inline_data', allocated memory or 'spill' mapping
 	size_t data_size;
+	_rws_spill * spill; // data is in the mapped file, null - in memory
+	_rws_send_file * file; // not a frame but message to send from file, without data
+	void * buffer; // allocated memory when 'data' points inside it, see 'rws_frame_create_for_send'
 	rws_opcode opcode;
 	unsigned char mask[4];
 	rws_bool is_masked;
 	rws_bool is_finished;
 	unsigned char header_size;
+	unsigned char inline_data[RWS_FRAME_INLINE_SIZE];
 } _rws_frame;
 
+// size of the complete frame at the start of data, 0 - frame is not received yet
 size_t rws_check_recv_frame_size(const void * data, const size_t data_size);
 
+// payload length from the received header, rws_false - header is not complete
+rws_bool rws_frame_get_recv_payload_size(const void * data, const size_t data_size, unsigned long long * payload_size);
+
 _rws_frame * rws_frame_create_with_recv_data(const void * data, const size_t data_size);
 
+// frame without data from the received header, null - header is not complete
+_rws_frame * rws_frame_create_with_recv_header(const void * data, const size_t data_size, size_t * payload_size);
+
+// header of the frame with 'data_size' payload bytes, 'header' has place for 14 bytes
+void rws_frame_create_header(_rws_frame * f, unsigned char * header, const size_t data_size);
+
 // data - should be null, and setted by newly created. 'data' & 'data_size' can be null
 void rws_frame_fill_with_send_data(_rws_frame * f, const void * data, const size_t data_size);
 
+// frame to send with data already encoded by 'rws_frame_fill_with_send_data', data is copied
+_rws_frame * rws_frame_create_with_encoded_data(const void * data, const size_t data_size);
+
+// frame with place for 'data_size' bytes after reserved header, data is filled by application
+_rws_frame * rws_frame_create_for_send(const rws_opcode opcode, const size_t data_size);
+
+// write header before data of the frame from 'rws_frame_create_for_send' and mask data in place
+void rws_frame_encode_in_place(_rws_frame * f);
+
+// message to send from file, takes ownership of the file descriptor
+_rws_frame * rws_frame_create_with_file(const int fd, const unsigned long long offset, const unsigned long long size);
+
+// read and mask next frame of the file message, null - read error
+_rws_frame * rws_frame_create_file_part(_rws_frame * f);
+
 // combine datas of 2 frames. combined is 'to'
 void rws_frame_combine_datas(_rws_frame * to, _rws_frame * from);
 
+// move data to the mapped file with place for 'size' bytes, rws_false - data stays in memory
+rws_bool rws_frame_spill(_rws_frame * f, const char * directory, const size_t size);
+
+// place for received bytes at the end of the spilled data, null - file can't grow
+void * rws_frame_spill_reserve(_rws_frame * f, const size_t size);
+
+// reserved bytes are written
+void rws_frame_spill_commit(_rws_frame * f, const size_t size);
+
+// message takes ownership of the frame, released with 'rws_message_free'
+void rws_frame_to_message(_rws_frame * f, rws_message * message);
+
 _rws_frame * rws_frame_create(void);
 
 void rws_frame_delete(_rws_frame * f);
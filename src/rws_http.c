@@ -0,0 +1,149 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#include "rws_http.h"
+
+#include <string.h>
+
+static int rws_http_tolower(const int c) {
+	return (c >= 'A' && c <= 'Z') ? (c + ('a' - 'A')) : c;
+}
+
+// end of the header block or 0, starts from the already scanned bytes
+static size_t rws_http_find_block_end(_rws_http_response * r, const char * data, const size_t data_size) {
+	size_t i = r->scanned;
+	for (; i < data_size; i++) {
+		if (data[i] != '\n') {
+			continue;
+		}
+		if (i + 1 < data_size && data[i + 1] == '\n') { // tolerate bare LF
+			return i + 2;
+		}
+		if (i + 2 < data_size && data[i + 1] == '\r' && data[i + 2] == '\n') {
+			return i + 3;
+		}
+		if (i + 2 >= data_size) {
+			break; // empty line can be incomplete, check this '\n' again
+		}
+	}
+	r->scanned = i;
+	return 0;
+}
+
+static const char * rws_http_trim_begin(const char * str, const char * end) {
+	while (str < end && (*str == ' ' || *str == '\t')) {
+		str++;
+	}
+	return str;
+}
+
+static const char * rws_http_trim_end(const char * str, const char * begin) {
+	while (str > begin && (str[-1] == ' ' || str[-1] == '\t' || str[-1] == '\r')) {
+		str--;
+	}
+	return str;
+}
+
+static rws_bool rws_http_parse_status_line(_rws_http_response * r, const char * line, const char * end) {
+	int code = 0, digits = 0;
+	if (end - line < 12 || memcmp(line, "HTTP/1.", 7) != 0 || line[8] != ' ') {
+		return rws_false;
+	}
+	for (line += 9; line < end && digits < 3; line++, digits++) {
+		if (*line < '0' || *line > '9') {
+			return rws_false;
+		}
+		code = code * 10 + (*line - '0');
+	}
+	r->code = code;
+	return (digits == 3) ? rws_true : rws_false;
+}
+
+static rws_bool rws_http_parse_header_line(_rws_http_response * r, const char * line, const char * end) {
+	const char * colon = (const char *)memchr(line, ':', end - line);
+	const char * name_end = NULL;
+	_rws_http_header * header = NULL;
+
+	if (!colon || colon == line || *line == ' ' || *line == '\t') {
+		return rws_false;
+	}
+	if (r->headers_count >= RWS_HTTP_MAX_HEADERS) {
+		return rws_true; // keep first headers, websocket ones are few
+	}
+	name_end = rws_http_trim_end(colon, line);
+	header = &r->headers[r->headers_count++];
+	header->name = line;
+	header->name_len = name_end - line;
+	header->value = rws_http_trim_begin(colon + 1, end);
+	header->value_len = rws_http_trim_end(end, header->value) - header->value;
+	return rws_true;
+}
+
+void rws_http_response_reset(_rws_http_response * r) {
+	memset(r, 0, sizeof(_rws_http_response));
+}
+
+int rws_http_response_parse(_rws_http_response * r, const char * data, const size_t data_size) {
+	const size_t block_size = rws_http_find_block_end(r, data, data_size);
+	const char * line = data;
+	const char * block_end = data + block_size;
+	const char * end = NULL;
+
+	if (!block_size) {
+		return (data_size > RWS_HTTP_MAX_HEADER_BLOCK) ? -1 : 0;
+	}
+
+	r->headers_count = 0;
+	r->header_block_size = block_size;
+	end = (const char *)memchr(line, '\n', block_end - line);
+	if (!rws_http_parse_status_line(r, line, rws_http_trim_end(end, line))) {
+		return -1;
+	}
+	for (line = end + 1; line < block_end; line = end + 1) {
+		end = (const char *)memchr(line, '\n', block_end - line);
+		if (rws_http_trim_end(end, line) == line) {
+			break; // empty line
+		}
+		if (!rws_http_parse_header_line(r, line, end)) {
+			return -1;
+		}
+	}
+	return 1;
+}
+
+const _rws_http_header * rws_http_response_find(const _rws_http_response * r, const char * name) {
+	const size_t len = strlen(name);
+	unsigned int i = 0;
+	size_t j = 0;
+	for (i = 0; i < r->headers_count; i++) {
+		const _rws_http_header * header = &r->headers[i];
+		if (header->name_len != len) {
+			continue;
+		}
+		for (j = 0; j < len && rws_http_tolower(header->name[j]) == rws_http_tolower(name[j]); j++) { }
+		if (j == len) {
+			return header;
+		}
+	}
+	return NULL;
+}
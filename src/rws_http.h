@@ -0,0 +1,58 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#ifndef __RWS_HTTP_H__
+#define __RWS_HTTP_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+
+#define RWS_HTTP_MAX_HEADERS 32
+#define RWS_HTTP_MAX_HEADER_BLOCK 16384
+
+typedef struct _rws_http_header_struct {
+	const char * name;
+	size_t name_len;
+	const char * value; // without surrounding spaces
+	size_t value_len;
+} _rws_http_header;
+
+// HTTP/1.1 response header block parser, data can arrive by parts.
+// Headers point to the parsed data and valid until the data is changed.
+typedef struct _rws_http_response_struct {
+	int code;
+	_rws_http_header headers[RWS_HTTP_MAX_HEADERS];
+	unsigned int headers_count;
+	size_t header_block_size; // status line, headers and empty line, following bytes are not HTTP
+	size_t scanned; // bytes searched for the end of header block
+} _rws_http_response;
+
+void rws_http_response_reset(_rws_http_response * r);
+
+// 1 - header block parsed, 0 - need more data, -1 - malformed or too large
+int rws_http_response_parse(_rws_http_response * r, const char * data, const size_t data_size);
+
+// case insensitive search, NULL - not found
+const _rws_http_header * rws_http_response_find(const _rws_http_response * r, const char * name);
+
+#endif
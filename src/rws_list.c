@@ -55,3 +55,11 @@ void rws_list_append(_rws_list * list, _rws_node_value value) {
 	}
 }
 
+void rws_list_remove_first(_rws_list ** list) {
+	if (list && *list) {
+		_rws_list * first = *list;
+		*list = first->next;
+		rws_free(first);
+	}
+}
+
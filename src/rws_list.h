@@ -47,5 +47,8 @@ void rws_list_delete_clean(_rws_list ** list);
 
 void rws_list_append(_rws_list * list, _rws_node_value value);
 
+// remove first node, list pointer moves to the next node
+void rws_list_remove_first(_rws_list ** list);
+
 #endif
 
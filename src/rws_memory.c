@@ -49,6 +49,25 @@ void rws_free(void * mem) {
 	}
 }
 
+void * rws_malloc_zero_aligned(const size_t size, const size_t alignment) {
+	// original pointer is stored before the aligned memory
+	char * mem = (char *)rws_malloc(size + alignment + sizeof(void *));
+	char * aligned = NULL;
+	if (!mem) {
+		return NULL;
+	}
+	aligned = (char *)(((size_t)(mem + sizeof(void *)) + alignment - 1) & ~(alignment - 1));
+	((void **)aligned)[-1] = mem;
+	memset(aligned, 0, size);
+	return aligned;
+}
+
+void rws_free_aligned(void * mem) {
+	if (mem) {
+		free(((void **)mem)[-1]);
+	}
+}
+
 void rws_free_clean(void ** mem) {
 	if (mem) {
 		rws_free(*mem);
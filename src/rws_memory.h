@@ -36,6 +36,11 @@ void * rws_malloc_zero(const size_t size);
 
 void rws_free(void * mem);
 
+// size > 0 => zeroed memory aligned to 'alignment' power of two, freed with 'rws_free_aligned'
+void * rws_malloc_zero_aligned(const size_t size, const size_t alignment);
+
+void rws_free_aligned(void * mem);
+
 void rws_free_clean(void ** mem);
 
 #endif
@@ -0,0 +1,182 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#include "rws_pool.h"
+#include "rws_socket.h"
+#include "rws_memory.h"
+#include "rws_string.h"
+
+static void rws_pool_on_disconnected(rws_socket s) {
+	(void)s; // required by connect, can be replaced by 'on_socket'
+}
+
+static void rws_pool_free(rws_pool pool) {
+	rws_mutex_delete(pool->mutex);
+	rws_string_delete(pool->scheme);
+	rws_string_delete(pool->host);
+	rws_string_delete(pool->path);
+	rws_free(pool->sockets);
+	rws_free(pool);
+}
+
+// create and connect one socket, locked
+static rws_bool rws_pool_add(rws_pool pool) {
+	rws_socket s = rws_socket_create();
+	if (!s) {
+		return rws_false;
+	}
+	rws_socket_set_url(s, pool->scheme, pool->host, pool->port, pool->path);
+	rws_socket_set_on_disconnected(s, &rws_pool_on_disconnected);
+	if (pool->on_socket) {
+		pool->on_socket(s);
+	}
+
+	s->pool = pool;
+	pool->sockets[pool->count++] = s;
+	pool->refs++;
+	if (!rws_socket_connect(s)) {
+		rws_socket_disconnect_and_release(s); // deleted in place and removed from pool
+		return rws_false;
+	}
+	return rws_true;
+}
+
+// locked
+static void rws_pool_fill(rws_pool pool) {
+	while (!pool->is_deleted && pool->count < pool->size) {
+		if (!rws_pool_add(pool)) {
+			break;
+		}
+	}
+}
+
+void rws_pool_socket_deleted(rws_pool pool, rws_socket s) {
+	size_t i = 0;
+	rws_bool is_free = rws_false;
+
+	rws_mutex_lock(pool->mutex);
+	for (i = 0; i < pool->count; i++) {
+		if (pool->sockets[i] == s) {
+			pool->sockets[i] = pool->sockets[--pool->count];
+			// lost connection is replaced at once, failed connect on next acquire
+			if (!rws_atomic_load(&s->is_released) && s->proto.sec_ws_accept) {
+				rws_pool_fill(pool);
+			}
+			break;
+		}
+	}
+	is_free = (--pool->refs == 0) ? rws_true : rws_false;
+	rws_mutex_unlock(pool->mutex);
+
+	if (is_free) {
+		rws_pool_free(pool);
+	}
+}
+
+rws_pool rws_pool_create(const char * scheme,
+						 const char * host,
+						 const int port,
+						 const char * path,
+						 const unsigned int size,
+						 rws_on_socket on_socket) {
+	rws_pool pool = (rws_pool)rws_malloc_zero(sizeof(struct rws_pool_struct));
+	if (!pool) {
+		return NULL;
+	}
+	pool->mutex = rws_mutex_create_recursive();
+	pool->scheme = rws_string_copy(scheme);
+	pool->host = rws_string_copy(host);
+	pool->path = rws_string_copy(path);
+	pool->port = port;
+	pool->on_socket = on_socket;
+	pool->size = size ? size : 1;
+	pool->sockets = (rws_socket *)rws_malloc_zero(pool->size * sizeof(rws_socket));
+	pool->refs = 1;
+
+	rws_mutex_lock(pool->mutex);
+	rws_pool_fill(pool);
+	rws_mutex_unlock(pool->mutex);
+	return pool;
+}
+
+rws_socket rws_pool_acquire(rws_pool pool) {
+	rws_socket s = NULL;
+	size_t i = 0;
+	if (!pool) {
+		return NULL;
+	}
+
+	rws_mutex_lock(pool->mutex);
+	for (i = 0; i < pool->count; i++) {
+		if (rws_socket_is_connected(pool->sockets[i])) {
+			s = pool->sockets[i];
+			pool->sockets[i] = pool->sockets[--pool->count];
+			break;
+		}
+	}
+	rws_pool_fill(pool); // replace acquired and failed sockets
+	rws_mutex_unlock(pool->mutex);
+	return s;
+}
+
+unsigned int rws_pool_get_ready_count(rws_pool pool) {
+	unsigned int count = 0;
+	size_t i = 0;
+	if (pool) {
+		rws_mutex_lock(pool->mutex);
+		for (i = 0; i < pool->count; i++) {
+			if (rws_socket_is_connected(pool->sockets[i])) {
+				count++;
+			}
+		}
+		rws_mutex_unlock(pool->mutex);
+	}
+	return count;
+}
+
+void rws_pool_delete(rws_pool pool) {
+	rws_socket * sockets = NULL;
+	size_t count = 0, i = 0;
+	rws_bool is_free = rws_false;
+	if (!pool) {
+		return;
+	}
+
+	rws_mutex_lock(pool->mutex);
+	pool->is_deleted = rws_true;
+	count = pool->count;
+	pool->count = 0; // released sockets are not searched when deleted
+	sockets = pool->sockets;
+	pool->sockets = NULL;
+	// socket threads wait the lock before deleting, so sockets are valid
+	for (i = 0; i < count; i++) {
+		rws_socket_disconnect_and_release(sockets[i]);
+	}
+	is_free = (--pool->refs == 0) ? rws_true : rws_false;
+	rws_mutex_unlock(pool->mutex);
+
+	rws_free(sockets);
+	if (is_free) {
+		rws_pool_free(pool);
+	}
+}
@@ -0,0 +1,52 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#ifndef __RWS_POOL_H__
+#define __RWS_POOL_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+#include "rws_thread.h"
+
+// connected sockets to one endpoint, waiting for 'rws_pool_acquire'
+struct rws_pool_struct {
+	rws_mutex mutex;
+
+	char * scheme;
+	char * host;
+	char * path;
+	int port;
+	rws_on_socket on_socket; // configures new socket before connect
+
+	rws_socket * sockets; // connecting and connected, not acquired
+	size_t count;
+	size_t size; // wanted number of sockets
+
+	size_t refs; // pool handle and not deleted sockets created by pool
+	rws_bool is_deleted;
+};
+
+// socket created by pool is deleted, replaces socket lost by pool
+void rws_pool_socket_deleted(rws_pool pool, rws_socket s);
+
+#endif
@@ -0,0 +1,901 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#include "rws_proto.h"
+#include "rws_memory.h"
+#include "rws_string.h"
+#include "rws_thread.h"
+#include "rws_sha1.h"
+
+#include <assert.h>
+
+static const char * k_rws_proto_min_http_ver = "1.1";
+static const char * k_rws_proto_sec_websocket_accept = "Sec-WebSocket-Accept";
+static const char * k_rws_proto_sec_websocket_protocol = "Sec-WebSocket-Protocol";
+static const char * k_rws_proto_base64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const char * k_rws_proto_accept_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// length of base64 encoded 16 bytes key
+#define RWS_PROTO_KEY_LEN 24
+
+// length of base64 encoded SHA-1 of the key
+#define RWS_PROTO_ACCEPT_LEN 28
+
+// tests only, fixed key instead of random
+static const char * _rws_proto_test_key = NULL;
+
+// published after frame is queued, so the loop can check output without lock
+static void rws_proto_post_output(_rws_proto * p) {
+	rws_atomic_store(&p->is_output_posted, 1);
+}
+
+static void rws_proto_append_frame(_rws_list ** list, _rws_frame * frame) {
+	_rws_node_value frame_list_var;
+	frame_list_var.object = frame;
+	if (*list) {
+		rws_list_append(*list, frame_list_var);
+	} else {
+		*list = rws_list_create();
+		(*list)->value = frame_list_var;
+	}
+}
+
+// append to the list with known last node without walking it
+static void rws_proto_append_frame_last(_rws_list ** list, _rws_node ** last, _rws_frame * frame) {
+	if (*list && *last) {
+		(*last)->next = (_rws_node *)rws_malloc_zero(sizeof(_rws_node));
+		*last = (*last)->next;
+		(*last)->value.object = frame;
+	} else {
+		rws_proto_append_frame(list, frame);
+		*last = *list;
+		while ((*last)->next) {
+			*last = (*last)->next;
+		}
+	}
+}
+
+static void rws_proto_remove_first(_rws_list ** list, _rws_node ** last) {
+	rws_list_remove_first(list);
+	if (!*list) {
+		*last = NULL;
+	}
+}
+
+static unsigned int rws_proto_get_next_message_id(_rws_proto * p) {
+	const unsigned int mess_id = ++p->next_message_id;
+	if (mess_id > 9999999) {
+		p->next_message_id = 0;
+	}
+	return mess_id;
+}
+
+static void rws_proto_resize_received(_rws_proto * p, const size_t size) {
+	void * res = NULL;
+	size_t min = 0;
+	if (size == p->received_size) {
+		return;
+	}
+
+	res = rws_malloc(size);
+	assert(res && (size > 0));
+
+	min = (p->received_size < size) ? p->received_size : size;
+	if (min > 0 && p->received) {
+		memcpy(res, p->received, min);
+	}
+	rws_free_clean(&p->received);
+	p->received = res;
+	p->received_size = size;
+}
+
+void rws_proto_init(_rws_proto * p) {
+	memset(p, 0, sizeof(_rws_proto));
+	p->is_utf8_validation = rws_true;
+}
+
+void rws_proto_delete_frames(_rws_list ** list) {
+	_rws_node * cur = *list;
+	while (cur) {
+		rws_frame_delete((_rws_frame *)cur->value.object);
+		cur->value.object = NULL;
+		cur = cur->next;
+	}
+	rws_list_delete_clean(list);
+}
+
+void rws_proto_clean(_rws_proto * p) {
+	rws_free_clean(&p->received);
+	p->received_size = 0;
+	p->received_len = 0;
+
+	rws_proto_delete_frames(&p->recvd_frames);
+	p->recvd_last = NULL;
+	rws_proto_delete_send_frames(p);
+	rws_proto_delete_frames(&p->control_frames);
+
+	rws_free_clean((void **)&p->handshake);
+	p->handshake_size = 0;
+	p->handshake_len = 0;
+	rws_string_delete_clean(&p->spill_directory);
+	rws_string_delete_clean(&p->send_spill_directory);
+	rws_string_delete_clean(&p->handshake_headers);
+	rws_string_delete_clean(&p->protocols);
+	rws_string_delete_clean(&p->protocol);
+	rws_string_delete_clean(&p->sec_ws_accept);
+
+	rws_error_delete_clean(&p->error);
+}
+
+void rws_proto_reset(_rws_proto * p) {
+	p->received_len = 0;
+	p->is_pong_received = rws_false;
+	p->is_close_received = rws_false;
+	p->close_code = 0;
+	p->is_close_sent = rws_false;
+	p->fail_code = 0;
+	p->stream_left = 0;
+	rws_utf8_reset(&p->utf8);
+	rws_http_response_reset(&p->http);
+	rws_proto_delete_frames(&p->recvd_frames);
+	p->recvd_last = NULL;
+	rws_proto_delete_frames(&p->control_frames);
+	rws_string_delete_clean(&p->protocol);
+	rws_string_delete_clean(&p->sec_ws_accept);
+	rws_error_delete_clean(&p->error);
+}
+
+// input
+
+void rws_proto_feed(_rws_proto * p, const void * data, const size_t data_size) {
+	if (p->received_size - p->received_len < data_size) {
+		rws_proto_resize_received(p, p->received_len + data_size);
+	}
+	memcpy((char *)p->received + p->received_len, data, data_size);
+	p->received_len += data_size;
+}
+
+// endpoint should select one of the requested subprotocols
+static rws_bool rws_proto_is_protocol_requested(_rws_proto * p, const char * protocol, const size_t len) {
+	const char * cur = p->protocols;
+	while (cur && *cur) {
+		if (strncmp(cur, protocol, len) == 0 && (cur[len] == ',' || cur[len] == 0)) {
+			return rws_true;
+		}
+		cur = strchr(cur, ',');
+		if (cur) {
+			cur += 2; // ", "
+		}
+	}
+	return rws_false;
+}
+
+int rws_proto_process_handshake(_rws_proto * p) {
+	char expected[RWS_PROTO_ACCEPT_LEN + 1];
+	const _rws_http_header * accept = NULL;
+	const _rws_http_header * protocol = NULL;
+	const int parsed = rws_http_response_parse(&p->http, (const char *)p->received, p->received_len);
+
+	if (parsed == 0) {
+		return 0;
+	}
+
+	rws_error_delete_clean(&p->error);
+	if (parsed < 0) {
+		p->error = rws_error_new_code_descr(rws_error_code_parse_handshake, "Malformed handshake responce");
+		return -1;
+	}
+
+	accept = rws_http_response_find(&p->http, k_rws_proto_sec_websocket_accept);
+	if (p->http.code != 101 || !accept || !accept->value_len) {
+		p->error = rws_error_new_code_descr(rws_error_code_parse_handshake,
+											(p->http.code != 101) ? "HTPP code not found or non 101" : "Accept key not found");
+		return -1;
+	}
+	rws_proto_accept_key(p->handshake + p->handshake_key_offset, expected);
+	if (accept->value_len != RWS_PROTO_ACCEPT_LEN || memcmp(accept->value, expected, RWS_PROTO_ACCEPT_LEN) != 0) {
+		p->error = rws_error_new_code_descr(rws_error_code_parse_handshake, "Accept key does not match request key");
+		return -1;
+	}
+	rws_string_delete(p->sec_ws_accept);
+	p->sec_ws_accept = rws_string_copy_len(accept->value, accept->value_len);
+
+	protocol = rws_http_response_find(&p->http, k_rws_proto_sec_websocket_protocol);
+	rws_string_delete_clean(&p->protocol);
+	if (protocol) {
+		if (!rws_proto_is_protocol_requested(p, protocol->value, protocol->value_len)) {
+			p->error = rws_error_new_code_descr(rws_error_code_parse_handshake, "Subprotocol not requested");
+			return -1;
+		}
+		p->protocol = rws_string_copy_len(protocol->value, protocol->value_len);
+	}
+
+	// keep frames sent right after the responce
+	p->received_len -= p->http.header_block_size;
+	if (p->received_len) {
+		memmove(p->received, (const char *)p->received + p->http.header_block_size, p->received_len);
+	}
+	rws_http_response_reset(&p->http);
+	return 1;
+}
+
+//  [FIN=0,opcode !=0 ],[FIN=0,opcode ==0 ],....[FIN=1,opcode ==0 ]
+// only last received frame can be unfinished
+static _rws_frame * rws_proto_last_unfin_recvd_frame(_rws_proto * p) {
+	_rws_frame * frame = p->recvd_last ? (_rws_frame *)p->recvd_last->value.object : NULL;
+	return (frame && !frame->is_finished) ? frame : NULL;
+}
+
+// text message is validated by parts, as fragments arrive
+static rws_bool rws_proto_validate_text(_rws_proto * p, _rws_frame * frame, _rws_frame * last_unfin) {
+	const rws_opcode opcode = last_unfin ? last_unfin->opcode : frame->opcode;
+	if (!p->is_utf8_validation || opcode != rws_opcode_text_frame) {
+		return rws_true;
+	}
+	if (!last_unfin) {
+		rws_utf8_reset(&p->utf8);
+	}
+	if (rws_utf8_validate(&p->utf8, frame->data, frame->data_size) &&
+		(!frame->is_finished || rws_utf8_is_complete(&p->utf8))) {
+		return rws_true;
+	}
+	p->fail_code = 1007; // inconsistent data
+	rws_error_delete_clean(&p->error);
+	p->error = rws_error_new_code_descr(rws_error_code_invalid_utf8, "Invalid UTF-8 in text message");
+	return rws_false;
+}
+
+// received frame or message is too big for callbacks, rws_false - connection fails with 1009
+static rws_bool rws_proto_check_recv_size(_rws_proto * p, const unsigned long long size) {
+	if (size <= RWS_FRAME_MAX_RECV_PAYLOAD_SIZE) {
+		return rws_true;
+	}
+	p->fail_code = 1009; // message too big
+	rws_error_delete_clean(&p->error);
+	p->error = rws_error_new_code_descr(rws_error_code_read_write_socket, "Received message is too big");
+	return rws_false;
+}
+
+// binary message above the threshold is moved to mapped file, rws_false - stays in memory
+static rws_bool rws_proto_spill(_rws_proto * p, _rws_frame * message, const size_t size) {
+	if (message->spill) {
+		return rws_true;
+	}
+	if (!p->spill_threshold || message->opcode != rws_opcode_binary_frame || size <= p->spill_threshold) {
+		return rws_false;
+	}
+	return rws_frame_spill(message, p->spill_directory, size);
+}
+
+// append payload to the spilled message, unmasked with the offset in the frame
+static void rws_proto_spill_append(_rws_proto * p, _rws_frame * message, const void * data, const size_t size,
+								   const unsigned char * mask, const size_t mask_offset) {
+	const unsigned char * src = (const unsigned char *)data;
+	unsigned char * dst = (unsigned char *)rws_frame_spill_reserve(message, size);
+	size_t index = 0;
+	if (!dst) {
+		p->fail_code = 1009; // message too big
+		rws_error_delete_clean(&p->error);
+		p->error = rws_error_new_code_descr(rws_error_code_read_write_socket, "Failed to spill received message");
+		return;
+	}
+	if (mask) {
+		for (index = 0; index < size; index++) {
+			dst[index] = src[index] ^ mask[(mask_offset + index) & 0x3];
+		}
+	} else if (size) {
+		memcpy(dst, src, size);
+	}
+	rws_frame_spill_commit(message, size);
+}
+
+static void rws_proto_process_bin_or_text_frame(_rws_proto * p, _rws_frame * frame) {
+	_rws_frame * last_unfin = rws_proto_last_unfin_recvd_frame(p);
+	if (!rws_proto_validate_text(p, frame, last_unfin) ||
+		(last_unfin && !rws_proto_check_recv_size(p, (unsigned long long)last_unfin->data_size + frame->data_size))) {
+		rws_frame_delete(frame);
+	} else if (last_unfin) {
+		if (rws_proto_spill(p, last_unfin, last_unfin->data_size + frame->data_size)) {
+			rws_proto_spill_append(p, last_unfin, frame->data, frame->data_size, NULL, 0);
+		} else {
+			rws_frame_combine_datas(last_unfin, frame);
+		}
+		last_unfin->is_finished = frame->is_finished;
+		rws_frame_delete(frame);
+	} else if (frame->opcode != rws_opcode_continuation) { // first frame, can be empty
+		if (!frame->data) {
+			frame->data = frame->inline_data; // empty message has not null data
+		}
+		rws_proto_spill(p, frame, frame->data_size);
+		rws_proto_append_frame_last(&p->recvd_frames, &p->recvd_last, frame);
+	} else {
+		rws_frame_delete(frame);
+	}
+}
+
+// Payload of the big binary frame is received directly to the spilled message, without waiting for
+// the whole frame in the received buffer. Returns header size or 0 - frame is received as usual.
+static size_t rws_proto_start_stream(_rws_proto * p, const void * data, const size_t data_size) {
+	_rws_frame * last_unfin = rws_proto_last_unfin_recvd_frame(p);
+	_rws_frame * frame = NULL;
+	size_t payload_size = 0, header_size = 0;
+
+	if (!p->spill_threshold || !(frame = rws_frame_create_with_recv_header(data, data_size, &payload_size))) {
+		return 0;
+	}
+	header_size = frame->header_size;
+	if (!payload_size || (last_unfin ? (frame->opcode != rws_opcode_continuation) : (frame->opcode != rws_opcode_binary_frame))) {
+		rws_frame_delete(frame);
+		return 0;
+	}
+
+	if (!rws_proto_check_recv_size(p, (unsigned long long)(last_unfin ? last_unfin->data_size : 0) + payload_size)) {
+		rws_frame_delete(frame);
+		return 0;
+	}
+
+	p->is_stream_finished = frame->is_finished;
+	p->is_stream_masked = frame->is_masked;
+	memcpy(p->stream_mask, frame->mask, 4);
+	if (last_unfin) {
+		rws_frame_delete(frame);
+		frame = last_unfin;
+	} else {
+		frame->is_finished = rws_false;
+	}
+
+	if (!rws_proto_spill(p, frame, frame->data_size + payload_size)) {
+		if (frame != last_unfin) {
+			rws_frame_delete(frame);
+		}
+		return 0;
+	}
+	if (frame != last_unfin) {
+		rws_proto_append_frame_last(&p->recvd_frames, &p->recvd_last, frame);
+	}
+	p->stream_left = payload_size;
+	p->stream_offset = 0;
+	return header_size;
+}
+
+// returns number of consumed bytes
+static size_t rws_proto_stream(_rws_proto * p, const void * data, const size_t data_size) {
+	_rws_frame * message = rws_proto_last_unfin_recvd_frame(p);
+	const size_t size = (data_size < p->stream_left) ? data_size : p->stream_left;
+	rws_proto_spill_append(p, message, data, size, p->is_stream_masked ? p->stream_mask : NULL, p->stream_offset);
+	p->stream_offset += size;
+	p->stream_left -= size;
+	if (!p->stream_left && p->is_stream_finished) {
+		message->is_finished = rws_true;
+	}
+	return size;
+}
+
+static void rws_proto_process_ping_frame(_rws_proto * p, _rws_frame * frame) {
+	_rws_frame * pong_frame = NULL;
+	if (p->is_close_sent) {
+		rws_frame_delete(frame);
+		return;
+	}
+	pong_frame = rws_frame_create();
+	pong_frame->opcode = rws_opcode_pong;
+	pong_frame->is_masked = rws_true;
+	rws_frame_fill_with_send_data(pong_frame, frame->data, frame->data_size);
+	rws_frame_delete(frame);
+	rws_proto_append_frame(&p->control_frames, pong_frame);
+	rws_proto_post_output(p);
+}
+
+static void rws_proto_process_conn_close_frame(_rws_proto * p, _rws_frame * frame) {
+	const unsigned char * data = (const unsigned char *)frame->data;
+	p->is_close_received = rws_true;
+	p->close_code = (data && frame->data_size >= 2) ? (unsigned short)((data[0] << 8) | data[1]) : 0;
+	rws_error_delete_clean(&p->error);
+	p->error = rws_error_new_code_descr(rws_error_code_connection_closed, "Connection was closed by endpoint");
+	rws_frame_delete(frame);
+}
+
+static void rws_proto_process_received_frame(_rws_proto * p, _rws_frame * frame) {
+	switch (frame->opcode) {
+		case rws_opcode_ping: rws_proto_process_ping_frame(p, frame); break;
+		case rws_opcode_text_frame:
+		case rws_opcode_binary_frame:
+		case rws_opcode_continuation:
+			rws_proto_process_bin_or_text_frame(p, frame);
+			break;
+		case rws_opcode_connection_close: rws_proto_process_conn_close_frame(p, frame); break;
+		case rws_opcode_pong:
+			p->is_pong_received = rws_true;
+			rws_frame_delete(frame);
+			break;
+		default:
+			// unprocessed => delete
+			rws_frame_delete(frame);
+			break;
+	}
+}
+
+void rws_proto_process_frames(_rws_proto * p) {
+	_rws_frame * frame = NULL;
+	const char * received = (const char *)p->received;
+	size_t offset = 0, frame_size = 0;
+	unsigned long long payload_size = 0;
+
+	// process all complete frames, so the whole burst is informed in one cycle
+	while (!p->is_close_received && !p->fail_code) {
+		if (p->stream_left) {
+			offset += rws_proto_stream(p, received + offset, p->received_len - offset);
+			if (p->stream_left) {
+				break;
+			}
+			continue;
+		}
+		frame_size = rws_check_recv_frame_size(received + offset, p->received_len - offset);
+		if (!frame_size) {
+			if (rws_frame_get_recv_payload_size(received + offset, p->received_len - offset, &payload_size) &&
+				!rws_proto_check_recv_size(p, payload_size)) {
+				break;
+			}
+			frame_size = rws_proto_start_stream(p, received + offset, p->received_len - offset);
+			if (!frame_size) {
+				break;
+			}
+			offset += frame_size;
+			continue;
+		}
+		frame = rws_frame_create_with_recv_data(received + offset, frame_size);
+		if (frame) {
+			rws_proto_process_received_frame(p, frame);
+		}
+		offset += frame_size;
+	}
+
+	if (offset == p->received_len) {
+		p->received_len = 0;
+	} else if (offset > 0) {
+		memmove((char *)p->received, received + offset, p->received_len - offset);
+		p->received_len -= offset;
+	}
+}
+
+_rws_frame * rws_proto_peek_message(_rws_proto * p) {
+	_rws_frame * frame = NULL;
+	while (p->recvd_frames) {
+		frame = (_rws_frame *)p->recvd_frames->value.object;
+		if (frame) {
+			return frame->is_finished ? frame : NULL;
+		}
+		rws_proto_remove_first(&p->recvd_frames, &p->recvd_last);
+	}
+	return NULL;
+}
+
+void rws_proto_pop_message(_rws_proto * p) {
+	rws_proto_remove_first(&p->recvd_frames, &p->recvd_last);
+}
+
+// output
+
+// base64 without terminator, returns number of written characters
+static size_t rws_proto_base64(const unsigned char * bytes, const size_t size, char * out) {
+	char * ptr = out;
+	unsigned int triple = 0;
+	size_t i = 0;
+	for (i = 0; i < size; i += 3) {
+		triple = (unsigned int)bytes[i] << 16;
+		if (i + 1 < size) {
+			triple |= (unsigned int)bytes[i + 1] << 8;
+		}
+		if (i + 2 < size) {
+			triple |= bytes[i + 2];
+		}
+		*ptr++ = k_rws_proto_base64[(triple >> 18) & 0x3F];
+		*ptr++ = k_rws_proto_base64[(triple >> 12) & 0x3F];
+		*ptr++ = (i + 1 < size) ? k_rws_proto_base64[(triple >> 6) & 0x3F] : '=';
+		*ptr++ = (i + 2 < size) ? k_rws_proto_base64[triple & 0x3F] : '=';
+	}
+	return (size_t)(ptr - out);
+}
+
+// random 16 bytes, base64 encoded, 24 characters without terminator
+static void rws_proto_write_key(char * key) {
+	unsigned char bytes[16];
+	if (_rws_proto_test_key) {
+		memcpy(key, _rws_proto_test_key, RWS_PROTO_KEY_LEN);
+		return;
+	}
+	rws_random_bytes(bytes, sizeof(bytes));
+	rws_proto_base64(bytes, sizeof(bytes), key);
+}
+
+void rws_proto_set_test_key(const char * key) {
+	_rws_proto_test_key = key;
+}
+
+void rws_proto_accept_key(const char * key, char * accept) {
+	char concat[RWS_PROTO_KEY_LEN + 36];
+	unsigned char digest[RWS_SHA1_SIZE];
+	memcpy(concat, key, RWS_PROTO_KEY_LEN);
+	memcpy(concat + RWS_PROTO_KEY_LEN, k_rws_proto_accept_guid, 36);
+	rws_sha1(concat, sizeof(concat), digest);
+	rws_proto_base64(digest, sizeof(digest), accept);
+	accept[RWS_PROTO_ACCEPT_LEN] = 0;
+}
+
+// header names are tokens, values are single line
+static rws_bool rws_proto_is_header_text(const char * text, const rws_bool is_name) {
+	if (!text) {
+		return rws_false;
+	}
+	while (*text) {
+		if (*text == '\r' || *text == '\n' || (is_name && (*text == ':' || *text == ' ' || *text == ','))) {
+			return rws_false;
+		}
+		text++;
+	}
+	return rws_true;
+}
+
+static char * rws_proto_append_string(char * str, const char * a, const char * b, const char * c, const char * d) {
+	const size_t len = str ? strlen(str) : 0;
+	char * res = (char *)rws_malloc(len + strlen(a) + strlen(b) + strlen(c) + strlen(d) + 1);
+	assert(res);
+	if (len) {
+		memcpy(res, str, len);
+	}
+	rws_sprintf(res + len, strlen(a) + strlen(b) + strlen(c) + strlen(d) + 1, "%s%s%s%s", a, b, c, d);
+	rws_string_delete(str);
+	return res;
+}
+
+rws_bool rws_proto_add_header(_rws_proto * p, const char * name, const char * value) {
+	if (!rws_proto_is_header_text(name, rws_true) || !*name || !rws_proto_is_header_text(value, rws_false)) {
+		return rws_false;
+	}
+	p->handshake_headers = rws_proto_append_string(p->handshake_headers, name, ": ", value, "\r\n");
+	p->handshake_len = 0;
+	return rws_true;
+}
+
+rws_bool rws_proto_add_protocol(_rws_proto * p, const char * protocol) {
+	if (!rws_proto_is_header_text(protocol, rws_true) || !*protocol) {
+		return rws_false;
+	}
+	p->protocols = rws_proto_append_string(p->protocols, p->protocols ? ", " : "", protocol, "", "");
+	p->handshake_len = 0;
+	return rws_true;
+}
+
+void rws_proto_create_handshake(_rws_proto * p, const char * scheme, const char * host, const int port, const char * path) {
+	size_t size = 0, writed = 0;
+	char * ptr = NULL;
+
+	if (p->handshake_len) { // same request, only the key is new
+		rws_proto_write_key(p->handshake + p->handshake_key_offset);
+		return;
+	}
+
+	// fixed text of the request and port digits fit 256 bytes
+	size = 256 + strlen(path) + strlen(host) * 2 + strlen(scheme) + RWS_PROTO_KEY_LEN;
+	size += p->handshake_headers ? strlen(p->handshake_headers) : 0;
+	size += p->protocols ? strlen(p->protocols) : 0;
+	if (p->handshake_size < size) {
+		rws_free_clean((void **)&p->handshake);
+		p->handshake = (char *)rws_malloc(size);
+		assert(p->handshake);
+		p->handshake_size = size;
+	}
+	ptr = p->handshake;
+
+	writed = rws_sprintf(ptr, size, "GET %s HTTP/%s\r\n", path, k_rws_proto_min_http_ver);
+
+	if (port == 80) {
+		writed += rws_sprintf(ptr + writed, size - writed, "Host: %s\r\n", host);
+	} else {
+		writed += rws_sprintf(ptr + writed, size - writed, "Host: %s:%i\r\n", host, port);
+	}
+
+	writed += rws_sprintf(ptr + writed, size - writed,
+						  "Upgrade: websocket\r\n"
+						  "Connection: Upgrade\r\n"
+						  "Origin: %s://%s\r\n"
+						  "Sec-WebSocket-Key: ",
+						  scheme, host);
+
+	p->handshake_key_offset = writed;
+	rws_proto_write_key(ptr + writed);
+	writed += RWS_PROTO_KEY_LEN;
+
+	if (p->protocols) {
+		writed += rws_sprintf(ptr + writed, size - writed, "\r\n%s: %s", k_rws_proto_sec_websocket_protocol, p->protocols);
+	}
+
+	writed += rws_sprintf(ptr + writed, size - writed,
+						  "\r\n"
+						  "Sec-WebSocket-Version: 13\r\n"
+						  "%s"
+						  "\r\n",
+						  p->handshake_headers ? p->handshake_headers : "");
+	assert(writed < size);
+	p->handshake_len = writed;
+}
+
+// size of the spill record with file message instead of frame
+#define RWS_PROTO_SPILL_FILE ((size_t)-1)
+
+// append encoded frame to the send spill, rws_false - file can't be created or grown
+static rws_bool rws_proto_spill_send_frame(_rws_proto * p, _rws_frame * frame) {
+	const size_t size = sizeof(size_t) + (frame->file ? sizeof(_rws_send_file) : frame->data_size);
+	const size_t record = frame->file ? RWS_PROTO_SPILL_FILE : frame->data_size;
+	unsigned char * dst = NULL;
+	if (!p->send_spill) {
+		p->send_spill = rws_spill_create(p->send_spill_directory ? p->send_spill_directory : rws_spill_temp_directory(), size);
+		p->send_spill_offset = 0;
+		if (!p->send_spill) {
+			return rws_false;
+		}
+	}
+	if (p->send_spill->len + size > p->send_spill->map_size && p->send_spill_offset >= p->send_spill->len / 2) {
+		rws_spill_compact(p->send_spill, p->send_spill_offset); // sent half is reused instead of growing
+		p->send_spill_offset = 0;
+	}
+	dst = (unsigned char *)rws_spill_reserve(p->send_spill, size);
+	if (!dst) {
+		return rws_false;
+	}
+	memcpy(dst, &record, sizeof(size_t));
+	if (frame->file) { // descriptor is owned by the record
+		memcpy(dst + sizeof(size_t), frame->file, sizeof(_rws_send_file));
+		rws_free(frame->file);
+		frame->file = NULL;
+	} else {
+		memcpy(dst + sizeof(size_t), frame->data, frame->data_size);
+	}
+	p->send_spill->len += size;
+	return rws_true;
+}
+
+// frame or file message of the spill record
+static _rws_frame * rws_proto_read_spill_record(const unsigned char * src, size_t * record_size) {
+	_rws_send_file file;
+	size_t size = 0;
+	memcpy(&size, src, sizeof(size_t));
+	if (size == RWS_PROTO_SPILL_FILE) {
+		memcpy(&file, src + sizeof(size_t), sizeof(_rws_send_file));
+		*record_size = sizeof(size_t) + sizeof(_rws_send_file);
+		return rws_frame_create_with_file(file.fd, file.offset, file.left);
+	}
+	*record_size = sizeof(size_t) + size;
+	return rws_frame_create_with_encoded_data(src + sizeof(size_t), size);
+}
+
+// delete spill, descriptors of file messages are closed
+static void rws_proto_delete_send_spill(_rws_proto * p) {
+	size_t record_size = 0;
+	if (!p->send_spill) {
+		return;
+	}
+	while (p->send_spill_offset < p->send_spill->len) {
+		rws_frame_delete(rws_proto_read_spill_record((const unsigned char *)p->send_spill->map + p->send_spill_offset, &record_size));
+		p->send_spill_offset += record_size;
+	}
+	rws_spill_delete(p->send_spill);
+	p->send_spill = NULL;
+	p->send_spill_offset = 0;
+}
+
+// move next spilled frame to 'send_frames', file is deleted when all frames are moved
+static void rws_proto_load_spilled_send_frame(_rws_proto * p) {
+	size_t record_size = 0;
+	_rws_frame * frame = rws_proto_read_spill_record((const unsigned char *)p->send_spill->map + p->send_spill_offset, &record_size);
+	p->send_spill_offset += record_size;
+	if (p->send_spill_offset >= p->send_spill->len) {
+		rws_spill_delete(p->send_spill);
+		p->send_spill = NULL;
+		p->send_spill_offset = 0;
+	}
+	p->send_queued += frame->data_size;
+	rws_proto_append_frame_last(&p->send_frames, &p->send_last, frame);
+}
+
+// queue in memory or spill, frame is deleted on failure
+static rws_bool rws_proto_queue_send_frame(_rws_proto * p, _rws_frame * frame) {
+	// after the first spilled frame all frames are spilled, so the order is kept
+	if (p->send_spill || (p->send_spill_threshold && p->send_queued + frame->data_size > p->send_spill_threshold)) {
+		if (rws_proto_spill_send_frame(p, frame)) {
+			rws_frame_delete(frame);
+			rws_proto_post_output(p);
+			return rws_true;
+		}
+		if (p->send_spill) { // can't be queued after spilled frames
+			rws_frame_delete(frame);
+			return rws_false;
+		}
+	}
+	p->send_queued += frame->data_size;
+	rws_proto_append_frame_last(&p->send_frames, &p->send_last, frame);
+	rws_proto_post_output(p);
+	return rws_true;
+}
+
+rws_bool rws_proto_send_message(_rws_proto * p, const rws_opcode opcode, const void * data, const size_t data_size) {
+	_rws_frame * frame = NULL;
+
+	if (!data && data_size) {
+		return rws_false;
+	}
+
+	frame = rws_frame_create(); // empty message is allowed
+	frame->is_masked = rws_true;
+	frame->opcode = opcode;
+	rws_frame_fill_with_send_data(frame, data, data_size);
+	return rws_proto_queue_send_frame(p, frame);
+}
+
+rws_bool rws_proto_send_frame(_rws_proto * p, _rws_frame * frame) {
+	rws_frame_encode_in_place(frame);
+	return rws_proto_queue_send_frame(p, frame);
+}
+
+rws_bool rws_proto_send_file(_rws_proto * p, const int fd, const unsigned long long offset, const unsigned long long size) {
+	if (fd < 0 || !size) {
+		return rws_false;
+	}
+	return rws_proto_queue_send_frame(p, rws_frame_create_with_file(fd, offset, size));
+}
+
+static void rws_proto_send_control(_rws_proto * p, const rws_opcode opcode) {
+	char buff[16];
+	size_t len = 0;
+	_rws_frame * frame = rws_frame_create();
+
+	len = rws_sprintf(buff, 16, "%u", rws_proto_get_next_message_id(p));
+
+	frame->is_masked = rws_true;
+	frame->opcode = opcode;
+	rws_frame_fill_with_send_data(frame, buff, len);
+	rws_proto_append_frame(&p->control_frames, frame);
+	rws_proto_post_output(p);
+}
+
+void rws_proto_send_ping(_rws_proto * p) {
+	if (p->is_close_sent) {
+		return;
+	}
+	rws_proto_send_control(p, rws_opcode_ping);
+}
+
+void rws_proto_send_close(_rws_proto * p, const unsigned short code, const char * reason) {
+	unsigned char buff[125];
+	size_t len = reason ? strlen(reason) : 0;
+	_rws_frame * frame = NULL;
+
+	if (p->is_close_sent) {
+		return;
+	}
+	p->is_close_sent = rws_true;
+	frame = rws_frame_create();
+	if (len > sizeof(buff) - 2) {
+		len = sizeof(buff) - 2;
+	}
+	buff[0] = (unsigned char)(code >> 8);
+	buff[1] = (unsigned char)(code & 0xff);
+	if (len) {
+		memcpy(buff + 2, reason, len);
+	}
+
+	frame->is_masked = rws_true;
+	frame->opcode = rws_opcode_connection_close;
+	rws_frame_fill_with_send_data(frame, buff, len + 2);
+	rws_proto_append_frame(&p->control_frames, frame);
+	rws_proto_post_output(p);
+}
+
+_rws_frame * rws_proto_get_file_message(_rws_proto * p) {
+	_rws_frame * message = NULL;
+	if (p->control_frames) {
+		return NULL;
+	}
+	if (!p->send_frames && p->send_spill) {
+		rws_proto_load_spilled_send_frame(p);
+	}
+	message = p->send_frames ? (_rws_frame *)p->send_frames->value.object : NULL;
+	return (message && message->file) ? message : NULL;
+}
+
+// replace file message at the head of 'send_frames' with its next frame, message stays after it until all is read
+void rws_proto_put_file_part(_rws_proto * p, _rws_frame * part) {
+	_rws_frame * message = (_rws_frame *)p->send_frames->value.object;
+	_rws_node * node = NULL;
+
+	if (!part) { // message is partially sent, connection can't continue
+		rws_proto_remove_first(&p->send_frames, &p->send_last);
+		rws_frame_delete(message);
+		p->fail_code = 1011; // internal error
+		rws_error_delete_clean(&p->error);
+		p->error = rws_error_new_code_descr(rws_error_code_read_write_socket, "Failed to read file to send");
+		return;
+	}
+	p->send_queued += part->data_size;
+	p->send_frames->value.object = part;
+	if (message->file->left) {
+		node = (_rws_node *)rws_malloc_zero(sizeof(_rws_node));
+		node->value.object = message;
+		node->next = p->send_frames->next;
+		p->send_frames->next = node;
+		if (p->send_last == p->send_frames) {
+			p->send_last = node;
+		}
+	} else {
+		rws_frame_delete(message);
+	}
+}
+
+_rws_frame * rws_proto_peek_output(_rws_proto * p) {
+	if (p->control_frames) {
+		return (_rws_frame *)p->control_frames->value.object;
+	}
+	if (!p->send_frames && p->send_spill) {
+		rws_proto_load_spilled_send_frame(p);
+	}
+	if (p->send_frames && ((_rws_frame *)p->send_frames->value.object)->file) {
+		return NULL; // next part is read by 'rws_proto_get_file_message' caller
+	}
+	return p->send_frames ? (_rws_frame *)p->send_frames->value.object : NULL;
+}
+
+void rws_proto_pop_output(_rws_proto * p) {
+	if (p->control_frames) {
+		rws_list_remove_first(&p->control_frames);
+	} else if (p->send_frames) {
+		p->send_queued -= ((_rws_frame *)p->send_frames->value.object)->data_size;
+		rws_proto_remove_first(&p->send_frames, &p->send_last);
+	}
+}
+
+rws_bool rws_proto_has_output(_rws_proto * p) {
+	return (p->control_frames || rws_proto_has_send_frames(p)) ? rws_true : rws_false;
+}
+
+rws_bool rws_proto_is_output_posted(_rws_proto * p) {
+	return rws_atomic_load(&p->is_output_posted) ? rws_true : rws_false;
+}
+
+void rws_proto_update_output_posted(_rws_proto * p) {
+	if (!rws_proto_has_output(p)) {
+		rws_atomic_store(&p->is_output_posted, 0);
+	}
+}
+
+rws_bool rws_proto_has_send_frames(_rws_proto * p) {
+	return (p->send_frames || p->send_spill) ? rws_true : rws_false;
+}
+
+void rws_proto_delete_send_frames(_rws_proto * p) {
+	rws_proto_delete_frames(&p->send_frames);
+	p->send_last = NULL;
+	p->send_queued = 0;
+	rws_proto_delete_send_spill(p);
+}
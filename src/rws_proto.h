@@ -0,0 +1,172 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#ifndef __RWS_PROTO_H__
+#define __RWS_PROTO_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+#include "rws_error.h"
+#include "rws_frame.h"
+#include "rws_list.h"
+#include "rws_utf8.h"
+#include "rws_http.h"
+
+// WebSocket protocol state without any I/O: consumes received bytes, produces frames to send and received messages
+typedef struct _rws_proto_struct {
+	// input and control frames, used by the loop thread
+	void * received;
+	size_t received_size; // size of 'received' memory
+	size_t received_len; // length of actualy readed message
+
+	_rws_list * recvd_frames; // received messages, last one can be unfinished
+	_rws_node * recvd_last; // last node of 'recvd_frames'
+	_rws_list * control_frames; // ping, pong, close frames to send before data frames
+
+	rws_bool is_pong_received; // cleared by reader
+	rws_bool is_close_received;
+	unsigned short close_code; // status code of the received close frame, 0 - no code
+	rws_bool is_close_sent; // close frame queued, no more frames after it
+	unsigned short fail_code; // close code of the detected protocol error, 0 - no error
+
+	rws_bool is_utf8_validation; // validate text messages, on by default
+	_rws_utf8 utf8; // validation state of the current text message
+
+	size_t spill_threshold; // bigger binary messages are received to mapped file, 0 - never
+	char * spill_directory; // null - anonymous memory file
+	size_t stream_left; // payload bytes of the frame received directly to the spilled message
+	size_t stream_offset; // received payload bytes of this frame, for unmasking
+	unsigned char stream_mask[4];
+	rws_bool is_stream_masked;
+	rws_bool is_stream_finished; // frame finishes message
+
+	rws_error error;
+
+	char * handshake; // handshake request, built once and reused by reconnects
+	size_t handshake_size; // size of 'handshake' memory
+	size_t handshake_len; // 0 - request should be built
+	size_t handshake_key_offset; // "Sec-WebSocket-Key" value in 'handshake', new key for each connection
+	char * handshake_headers; // user header lines, "Name: value\r\n"
+	char * protocols; // requested subprotocols, "chat, superchat"
+	char * protocol; // subprotocol selected by endpoint
+	char * sec_ws_accept; // "Sec-WebSocket-Accept" field from handshake
+	_rws_http_response http; // handshake responce parser state
+
+	// output, written by application threads, starts new cache line
+	RWS_CACHE_ALIGNED _rws_list * send_frames; // data frames to send
+	_rws_node * send_last; // last node of 'send_frames'
+	size_t send_queued; // bytes of 'send_frames' in memory
+	size_t send_spill_threshold; // frames over this queued size are appended to 'send_spill', 0 - never
+	char * send_spill_directory; // null - temporary directory
+	_rws_spill * send_spill; // encoded frames after 'send_frames', each after its size_t length, null - empty
+	size_t send_spill_offset; // next frame in 'send_spill'
+	unsigned int next_message_id;
+	volatile size_t is_output_posted; // set when frames are queued, cleared by the loop when all are sent
+} _rws_proto;
+
+void rws_proto_init(_rws_proto * p);
+
+// delete all buffers and frames
+void rws_proto_clean(_rws_proto * p);
+
+// prepare for the new connection
+void rws_proto_reset(_rws_proto * p);
+
+// input
+
+// append received bytes
+void rws_proto_feed(_rws_proto * p, const void * data, const size_t data_size);
+
+// 1 - handshake responce processed, 0 - need more data, -1 - error.
+// Bytes after the responce stay received, they are frames sent with the responce.
+int rws_proto_process_handshake(_rws_proto * p);
+
+// process all complete frames, stops on close frame or protocol error
+void rws_proto_process_frames(_rws_proto * p);
+
+// first finished message or NULL
+_rws_frame * rws_proto_peek_message(_rws_proto * p);
+
+// remove first finished message, frame is not deleted
+void rws_proto_pop_message(_rws_proto * p);
+
+// output
+
+// "Sec-WebSocket-Accept" value for 24 characters of the key, 'accept' has place for 29 characters
+void rws_proto_accept_key(const char * key, char * accept);
+
+// tests only: fixed 24 characters key instead of random, null - random key(default)
+void rws_proto_set_test_key(const char * key);
+
+// build request if needed, otherwise only write new key
+void rws_proto_create_handshake(_rws_proto * p, const char * scheme, const char * host, const int port, const char * path);
+
+// add handshake header line, rws_false - invalid name or value
+rws_bool rws_proto_add_header(_rws_proto * p, const char * name, const char * value);
+
+// add requested subprotocol, rws_false - invalid name
+rws_bool rws_proto_add_protocol(_rws_proto * p, const char * protocol);
+
+rws_bool rws_proto_send_message(_rws_proto * p, const rws_opcode opcode, const void * data, const size_t data_size);
+
+// frame from 'rws_frame_create_for_send' is encoded in place and owned by queue, also on failure
+rws_bool rws_proto_send_frame(_rws_proto * p, _rws_frame * frame);
+
+// binary message from file, descriptor is owned by the queued message
+rws_bool rws_proto_send_file(_rws_proto * p, const int fd, const unsigned long long offset, const unsigned long long size);
+
+void rws_proto_send_ping(_rws_proto * p);
+
+// close frame with status code and optional reason, reason is truncated to 123 bytes
+void rws_proto_send_close(_rws_proto * p, const unsigned short code, const char * reason);
+
+// first frame to send or NULL, control frames first, NULL if next part of the file message should be read
+_rws_frame * rws_proto_peek_output(_rws_proto * p);
+
+// file message waiting for its next part at the head of output or NULL,
+// message is changed only by the loop, so the part is read without 'send_mutex'
+_rws_frame * rws_proto_get_file_message(_rws_proto * p);
+
+// place part of the message from 'rws_proto_get_file_message' before it, NULL part - read failed with 1011
+void rws_proto_put_file_part(_rws_proto * p, _rws_frame * part);
+
+// remove first frame to send, frame is not deleted
+void rws_proto_pop_output(_rws_proto * p);
+
+rws_bool rws_proto_has_output(_rws_proto * p);
+
+// output was queued since it was drained, read by the loop without 'send_mutex'
+rws_bool rws_proto_is_output_posted(_rws_proto * p);
+
+// clear posted output if nothing is queued, called under 'send_mutex'
+void rws_proto_update_output_posted(_rws_proto * p);
+
+// data frames in memory or spilled
+rws_bool rws_proto_has_send_frames(_rws_proto * p);
+
+void rws_proto_delete_send_frames(_rws_proto * p);
+
+void rws_proto_delete_frames(_rws_list ** list);
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#include "rws_requests.h"
+#include "rws_memory.h"
+
+#include <string.h>
+
+// initial number of slots, table grows when half full
+#define RWS_REQUESTS_MIN_SLOTS 64
+
+// mix id bits, sequential ids are spread over the table
+static size_t rws_requests_hash(const unsigned long long id, const size_t mask) {
+	unsigned long long h = id;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (size_t)h & mask;
+}
+
+static void rws_requests_heap_set(_rws_requests * r, const size_t index, const size_t slot) {
+	r->heap[index] = slot;
+	r->slots[slot].heap_index = index;
+}
+
+static rws_bool rws_requests_heap_less(const _rws_requests * r, const size_t a, const size_t b) {
+	return (r->slots[r->heap[a]].deadline_ms < r->slots[r->heap[b]].deadline_ms) ? rws_true : rws_false;
+}
+
+static void rws_requests_heap_swap(_rws_requests * r, const size_t a, const size_t b) {
+	const size_t slot = r->heap[a];
+	rws_requests_heap_set(r, a, r->heap[b]);
+	rws_requests_heap_set(r, b, slot);
+}
+
+static void rws_requests_heap_up(_rws_requests * r, size_t index) {
+	while (index && rws_requests_heap_less(r, index, (index - 1) / 2)) {
+		rws_requests_heap_swap(r, index, (index - 1) / 2);
+		index = (index - 1) / 2;
+	}
+}
+
+static void rws_requests_heap_down(_rws_requests * r, size_t index) {
+	size_t child = 0;
+	while ((child = 2 * index + 1) < r->heap_count) {
+		if (child + 1 < r->heap_count && rws_requests_heap_less(r, child + 1, child)) {
+			child++;
+		}
+		if (!rws_requests_heap_less(r, child, index)) {
+			break;
+		}
+		rws_requests_heap_swap(r, index, child);
+		index = child;
+	}
+}
+
+static void rws_requests_heap_push(_rws_requests * r, const size_t slot) {
+	size_t * heap = NULL;
+	if (r->heap_count == r->heap_size) {
+		r->heap_size = r->heap_size ? r->heap_size * 2 : RWS_REQUESTS_MIN_SLOTS;
+		heap = (size_t *)rws_malloc(r->heap_size * sizeof(size_t));
+		if (r->heap_count) {
+			memcpy(heap, r->heap, r->heap_count * sizeof(size_t));
+		}
+		rws_free(r->heap);
+		r->heap = heap;
+	}
+	rws_requests_heap_set(r, r->heap_count++, slot);
+	rws_requests_heap_up(r, r->heap_count - 1);
+}
+
+static void rws_requests_heap_remove(_rws_requests * r, const size_t index) {
+	const size_t last = r->heap[--r->heap_count];
+	if (index < r->heap_count) {
+		rws_requests_heap_set(r, index, last);
+		rws_requests_heap_up(r, index);
+		rws_requests_heap_down(r, r->slots[last].heap_index);
+	}
+}
+
+static size_t rws_requests_find(const _rws_requests * r, const unsigned long long id) {
+	const size_t mask = r->slots_size - 1;
+	size_t slot = 0;
+	if (!r->slots_size) {
+		return r->slots_size;
+	}
+	for (slot = rws_requests_hash(id, mask); r->slots[slot].is_used; slot = (slot + 1) & mask) {
+		if (r->slots[slot].id == id) {
+			return slot;
+		}
+	}
+	return r->slots_size;
+}
+
+// place request to the first free slot of its probe sequence, heap points to the new slot
+static size_t rws_requests_insert(_rws_requests * r, const _rws_request * request) {
+	const size_t mask = r->slots_size - 1;
+	size_t slot = rws_requests_hash(request->id, mask);
+	while (r->slots[slot].is_used) {
+		slot = (slot + 1) & mask;
+	}
+	r->slots[slot] = *request;
+	if (request->heap_index != RWS_REQUESTS_NO_HEAP) {
+		r->heap[request->heap_index] = slot;
+	}
+	return slot;
+}
+
+static void rws_requests_resize(_rws_requests * r, const size_t size) {
+	_rws_request * slots = r->slots;
+	const size_t slots_size = r->slots_size;
+	size_t slot = 0;
+	r->slots = (_rws_request *)rws_malloc_zero(size * sizeof(_rws_request));
+	r->slots_size = size;
+	for (slot = 0; slot < slots_size; slot++) {
+		if (slots[slot].is_used) {
+			rws_requests_insert(r, &slots[slot]);
+		}
+	}
+	rws_free(slots);
+}
+
+// backward shift deletion, following entries of the probe sequence fill the hole, no tombstones
+static void rws_requests_remove(_rws_requests * r, size_t slot, _rws_request * request) {
+	const size_t mask = r->slots_size - 1;
+	size_t next = slot, home = 0;
+
+	if (r->slots[slot].heap_index != RWS_REQUESTS_NO_HEAP) {
+		rws_requests_heap_remove(r, r->slots[slot].heap_index);
+	}
+	*request = r->slots[slot];
+	request->heap_index = RWS_REQUESTS_NO_HEAP;
+	r->count--;
+
+	for (;;) {
+		next = (next + 1) & mask;
+		if (!r->slots[next].is_used) {
+			break;
+		}
+		home = rws_requests_hash(r->slots[next].id, mask);
+		// entry can move to the hole only if its home is not in (slot, next]
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			r->slots[slot] = r->slots[next];
+			if (r->slots[slot].heap_index != RWS_REQUESTS_NO_HEAP) {
+				r->heap[r->slots[slot].heap_index] = slot;
+			}
+			slot = next;
+		}
+	}
+	r->slots[slot].is_used = rws_false;
+}
+
+void rws_requests_init(_rws_requests * r) {
+	memset(r, 0, sizeof(_rws_requests));
+}
+
+void rws_requests_clean(_rws_requests * r) {
+	rws_free(r->slots);
+	rws_free(r->heap);
+	rws_requests_init(r);
+}
+
+rws_bool rws_requests_add(_rws_requests * r, const unsigned long long id, const unsigned long long deadline_ms,
+						  rws_on_socket_reply on_reply, void * user_data) {
+	_rws_request request;
+	size_t slot = 0;
+	if (rws_requests_find(r, id) != r->slots_size) {
+		return rws_false;
+	}
+	if (2 * (r->count + 1) > r->slots_size) {
+		rws_requests_resize(r, r->slots_size ? r->slots_size * 2 : RWS_REQUESTS_MIN_SLOTS);
+	}
+	request.id = id;
+	request.deadline_ms = deadline_ms;
+	request.on_reply = on_reply;
+	request.user_data = user_data;
+	request.heap_index = RWS_REQUESTS_NO_HEAP;
+	request.is_used = rws_true;
+	slot = rws_requests_insert(r, &request);
+	r->count++;
+	if (deadline_ms) {
+		rws_requests_heap_push(r, slot);
+	}
+	return rws_true;
+}
+
+rws_bool rws_requests_take(_rws_requests * r, const unsigned long long id, _rws_request * request) {
+	const size_t slot = rws_requests_find(r, id);
+	if (slot == r->slots_size) {
+		return rws_false;
+	}
+	rws_requests_remove(r, slot, request);
+	return rws_true;
+}
+
+rws_bool rws_requests_take_expired(_rws_requests * r, const unsigned long long now_ms, _rws_request * request) {
+	if (!r->heap_count || r->slots[r->heap[0]].deadline_ms > now_ms) {
+		return rws_false;
+	}
+	rws_requests_remove(r, r->heap[0], request);
+	return rws_true;
+}
+
+rws_bool rws_requests_take_any(_rws_requests * r, _rws_request * request) {
+	size_t slot = 0;
+	if (!r->count) {
+		return rws_false;
+	}
+	if (r->heap_count) { // earliest first
+		rws_requests_remove(r, r->heap[0], request);
+		return rws_true;
+	}
+	while (!r->slots[slot].is_used) {
+		slot++;
+	}
+	rws_requests_remove(r, slot, request);
+	return rws_true;
+}
+
+unsigned long long rws_requests_next_deadline(const _rws_requests * r) {
+	return r->heap_count ? r->slots[r->heap[0]].deadline_ms : 0;
+}
@@ -0,0 +1,75 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#ifndef __RWS_REQUESTS_H__
+#define __RWS_REQUESTS_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+
+// request waiting for reply, slot of the in-flight table
+typedef struct _rws_request_struct {
+	unsigned long long id;
+	unsigned long long deadline_ms; // 0 - no timeout
+	rws_on_socket_reply on_reply;
+	void * user_data;
+	size_t heap_index; // position in the deadlines heap, 'RWS_REQUESTS_NO_HEAP' - no timeout
+	rws_bool is_used;
+} _rws_request;
+
+#define RWS_REQUESTS_NO_HEAP ((size_t)-1)
+
+// In-flight requests: open addressing table with linear probing keyed by id,
+// and binary min-heap of slot indices ordered by deadline. Not thread safe.
+typedef struct _rws_requests_struct {
+	_rws_request * slots;
+	size_t slots_size; // power of 2, 0 - not allocated
+	size_t count;
+
+	size_t * heap; // slot indices, earliest deadline first
+	size_t heap_size; // allocated
+	size_t heap_count;
+} _rws_requests;
+
+void rws_requests_init(_rws_requests * r);
+
+void rws_requests_clean(_rws_requests * r);
+
+// rws_false - request with this id is in flight
+rws_bool rws_requests_add(_rws_requests * r, const unsigned long long id, const unsigned long long deadline_ms,
+						  rws_on_socket_reply on_reply, void * user_data);
+
+// remove request with id, rws_false - not found
+rws_bool rws_requests_take(_rws_requests * r, const unsigned long long id, _rws_request * request);
+
+// remove request with deadline before or at 'now_ms', rws_false - no expired requests
+rws_bool rws_requests_take_expired(_rws_requests * r, const unsigned long long now_ms, _rws_request * request);
+
+// remove any request, rws_false - table is empty
+rws_bool rws_requests_take_any(_rws_requests * r, _rws_request * request);
+
+// earliest deadline, 0 - no requests with timeout
+unsigned long long rws_requests_next_deadline(const _rws_requests * r);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#include "rws_ring.h"
+#include "rws_memory.h"
+#include "rws_thread.h"
+
+_rws_ring * rws_ring_create(const size_t capacity) {
+	size_t size = 2;
+	_rws_ring * ring = NULL;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	ring = (_rws_ring *)rws_malloc_zero(sizeof(_rws_ring));
+	ring->items = (rws_message *)rws_malloc_zero(size * sizeof(rws_message));
+	ring->mask = size - 1;
+	return ring;
+}
+
+void rws_ring_delete(_rws_ring * ring) {
+	rws_message message;
+	if (ring) {
+		while (rws_ring_pop(ring, &message, 1)) {
+			rws_message_free(&message);
+		}
+		rws_free(ring->items);
+		rws_free(ring);
+	}
+}
+
+void rws_ring_delete_clean(_rws_ring ** ring) {
+	if (ring) {
+		rws_ring_delete(*ring);
+		*ring = NULL;
+	}
+}
+
+rws_bool rws_ring_push(_rws_ring * ring, const rws_message * message) {
+	const size_t tail = ring->tail;
+	if (tail - rws_atomic_load(&ring->head) > ring->mask) {
+		return rws_false;
+	}
+	ring->items[tail & ring->mask] = *message;
+	rws_atomic_store(&ring->tail, tail + 1);
+	return rws_true;
+}
+
+size_t rws_ring_pop(_rws_ring * ring, rws_message * messages, const size_t max_count) {
+	const size_t head = ring->head;
+	size_t count = rws_atomic_load(&ring->tail) - head, index = 0;
+	if (count > max_count) {
+		count = max_count;
+	}
+	for (index = 0; index < count; index++) {
+		messages[index] = ring->items[(head + index) & ring->mask];
+	}
+	if (count) {
+		rws_atomic_store(&ring->head, head + count);
+	}
+	return count;
+}
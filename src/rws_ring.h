@@ -0,0 +1,54 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#ifndef __RWS_RING_H__
+#define __RWS_RING_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+
+// bounded single producer, single consumer queue of received messages
+typedef struct _rws_ring_struct {
+	rws_message * items;
+	size_t mask; // capacity - 1, capacity is power of 2
+	volatile size_t head; // written by consumer
+	char head_padding[64];
+	volatile size_t tail; // written by producer
+	char tail_padding[64];
+} _rws_ring;
+
+_rws_ring * rws_ring_create(const size_t capacity);
+
+// delete ring and all not consumed messages
+void rws_ring_delete(_rws_ring * ring);
+
+void rws_ring_delete_clean(_rws_ring ** ring);
+
+// producer side, rws_false if ring is full
+rws_bool rws_ring_push(_rws_ring * ring, const rws_message * message);
+
+// consumer side, returns number of moved messages
+size_t rws_ring_pop(_rws_ring * ring, rws_message * messages, const size_t max_count);
+
+#endif
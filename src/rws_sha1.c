@@ -0,0 +1,101 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#include "rws_sha1.h"
+
+#include <string.h>
+
+#define RWS_SHA1_ROL(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
+
+static void rws_sha1_block(unsigned int state[5], const unsigned char * block) {
+	unsigned int w[80];
+	unsigned int a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = 0, k = 0, t = 0;
+	int i = 0;
+
+	for (i = 0; i < 16; i++) {
+		w[i] = ((unsigned int)block[i * 4] << 24) | ((unsigned int)block[i * 4 + 1] << 16) |
+			((unsigned int)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+	}
+	for (i = 16; i < 80; i++) {
+		t = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+		w[i] = RWS_SHA1_ROL(t, 1);
+	}
+	for (i = 0; i < 80; i++) {
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+		t = RWS_SHA1_ROL(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = RWS_SHA1_ROL(b, 30);
+		b = a;
+		a = t;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+void rws_sha1(const void * data, const size_t data_size, unsigned char digest[RWS_SHA1_SIZE]) {
+	unsigned int state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+	const unsigned char * bytes = (const unsigned char *)data;
+	const unsigned long long bits = (unsigned long long)data_size * 8;
+	unsigned char block[64];
+	size_t left = data_size, tail = 0;
+	int i = 0;
+
+	for (; left >= 64; left -= 64, bytes += 64) {
+		rws_sha1_block(state, bytes);
+	}
+
+	// padding: 0x80, zeros and 64 bit big endian length of the message in bits
+	memset(block, 0, sizeof(block));
+	memcpy(block, bytes, left);
+	block[left] = 0x80;
+	tail = left + 1;
+	if (tail > 56) {
+		rws_sha1_block(state, block);
+		memset(block, 0, sizeof(block));
+	}
+	for (i = 0; i < 8; i++) {
+		block[63 - i] = (unsigned char)(bits >> (i * 8));
+	}
+	rws_sha1_block(state, block);
+
+	for (i = 0; i < 20; i++) {
+		digest[i] = (unsigned char)(state[i >> 2] >> (24 - (i & 3) * 8));
+	}
+}
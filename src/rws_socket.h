@@ -33,9 +33,11 @@
 #include <netdb.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <netinet/tcp.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
 #endif
 
 #include <assert.h>
@@ -45,6 +47,14 @@
 #include "rws_thread.h"
 #include "rws_frame.h"
 #include "rws_list.h"
+#include "rws_proto.h"
+#include "rws_transport.h"
+#include "rws_bucket.h"
+#include "rws_ring.h"
+#include "rws_executor.h"
+#include "rws_pool.h"
+#include "rws_endpoints.h"
+#include "rws_requests.h"
 
 #if defined(RWS_OS_WINDOWS)
 typedef SOCKET rws_socket_t;
@@ -54,92 +64,183 @@ typedef SOCKET rws_socket_t;
 typedef int rws_socket_t;
 #define RWS_INVALID_SOCKET -1
 #define RWS_SOCK_CLOSE(sock) close(sock)
+#define	WSAEWOULDBLOCK  EAGAIN
+#define	WSAEINPROGRESS     EINPROGRESS
 #endif
 
-static const char * k_rws_socket_min_http_ver = "1.1";
-static const char * k_rws_socket_sec_websocket_accept = "Sec-WebSocket-Accept";
+typedef struct rws_socket_struct _rws_socket;
 
+// Fields are grouped by the thread that writes them, each group starts a new cache line,
+// so application threads sending messages don't invalidate lines used by the loop thread.
+// Socket is allocated aligned to the cache line.
 struct rws_socket_struct {
-	int port;
-	rws_socket_t socket;
-	char * scheme;
-	char * host;
-	char * path;
+	// loop thread, touched on every step
 
-	char * sec_ws_accept; // "Sec-WebSocket-Accept" field from handshake
+	int command; // current state, owned by the loop thread, see 'COMMAND_*'
+	rws_bool is_connected; // sock connected + handshake done, written under 'send_mutex'
+	rws_bool is_recv_paused; // poll ring is full or executor is behind
+	rws_socket_t socket;
+	_rws_transport transport; // tcp by default
 
-	rws_thread work_thread;
+	unsigned long long next_ping_ms;
+	unsigned long long ping_sent_us; // ping waiting for pong, measured with endpoints only
 
-	int command;
+	_rws_frame * send_frame; // frame in sending
+	size_t send_offset; // sent bytes of the 'send_frame'
+	size_t handshake_offset; // sent bytes of the handshake request, 0 - request should be built
 
-	unsigned int next_message_id;
+	_rws_bucket send_msgs_bucket;
+	_rws_bucket send_bytes_bucket;
+	_rws_bucket recv_bytes_bucket;
+	_rws_throttle send_throttle;
+	_rws_throttle recv_throttle;
+	rws_rate_limit shared_limit; // applied together with socket buckets, shared with other sockets
+	volatile size_t recv_throttled_ms; // published 'recv_throttle' total
+	volatile size_t recvd_close_code; // published close code from endpoint
 
-	rws_bool is_connected; // sock connected + handshake done
+	_rws_ring * recvd_ring; // poll mode
+	rws_executor executor;
+	rws_message * recvd_batch;
+	size_t recvd_batch_size; // allocated number of messages
 
 	void * user_object;
 	rws_on_socket on_connected;
 	rws_on_socket on_disconnected;
 	rws_on_socket_recvd_text on_recvd_text;
 	rws_on_socket_recvd_bin on_recvd_bin;
+	rws_on_socket_recvd_batch on_recvd_batch;
+	rws_on_socket_recvd_message on_recvd_message;
+	rws_on_socket_slow_callback on_slow_callback;
+	unsigned int slow_callback_threshold_us;
+	rws_on_socket_request_id on_request_id; // requests enabled
 
-	void * received;
-	size_t received_size; // size of 'received' memory
-	size_t received_len; // length of actualy readed message
+	rws_error error;
 
-	_rws_list * send_frames;
-	_rws_list * recvd_frames;
+	volatile size_t loop_histogram[RWS_LOOP_HISTOGRAM_SIZE]; // written by the loop thread only
 
-	rws_error error;
+	// protocol state, input part belongs to the loop thread,
+	// output part is at the end and guarded by 'send_mutex', see '_rws_proto'
+	_rws_proto proto;
 
-	rws_mutex work_mutex;
-	rws_mutex send_mutex;
-};
+	// shared with application and executor threads
 
-rws_bool rws_socket_process_handshake_responce(rws_socket s);
+	RWS_CACHE_ALIGNED rws_mutex send_mutex;
+	volatile size_t mailbox; // requests from other threads, see 'RWS_MAILBOX_*'
+	volatile size_t is_released; // 'rws_socket_disconnect_and_release' called
+	volatile size_t recv_rate_request; // new receive limit for 'RWS_MAILBOX_RECV_RATE'
+	_rws_serial_queue recvd_queue; // messages for executor, guarded by executor
+	_rws_requests requests; // in flight, guarded by 'send_mutex'
 
-// receive raw data from socket
-rws_bool rws_socket_recv(rws_socket s);
+	// cold, configuration and connection setup
 
-// send raw data to socket
-rws_bool rws_socket_send(rws_socket s, const void * data, const size_t data_size);
+	RWS_CACHE_ALIGNED int port;
+	char * scheme;
+	char * host;
+	char * path;
+
+	rws_bool is_work_thread; // detached work thread started, it deletes socket on end
+	rws_thread_attr thread_attr;
+	rws_bool is_thread_attr; // otherwise default attributes
+	rws_bool is_external_loop; // no work thread, steps are driven by application
 
-_rws_frame * rws_socket_last_unfin_recvd_frame_by_opcode(rws_socket s, const rws_opcode opcode);
+	struct addrinfo * connect_addrs;
+	struct addrinfo * connect_addr; // next address to connect
+	int connect_attempt;
+	unsigned long long connect_retry_ms;
 
-void rws_socket_process_bin_or_text_frame(rws_socket s, _rws_frame * frame);
+	rws_endpoints endpoints; // replace URL, shared with other sockets
+	int endpoint; // index of the current endpoint, -1 - no endpoints
+	const _rws_endpoint * endpoint_url; // URL of the current endpoint, socket URL is not replaced
+	unsigned int endpoints_tried; // bit mask of endpoints failed in this connect
+	unsigned long long connect_start_us; // connect or failover time, 0 - handshake done
 
-void rws_socket_process_ping_frame(rws_socket s, _rws_frame * frame);
+	unsigned short close_code; // sent in the close frame
+	char * close_reason;
+	unsigned long long close_deadline_ms; // closing handshake ends at this time, 0 - not started
 
-void rws_socket_process_conn_close_frame(rws_socket s, _rws_frame * frame);
+	rws_pool pool; // created by pool, informed on delete
+	rws_on_socket on_deleted;
 
-void rws_socket_process_received_frame(rws_socket s, _rws_frame * frame);
+	struct rws_socket_struct * registry_prev; // list of all sockets, guarded by registry mutex
+	struct rws_socket_struct * registry_next;
+	rws_bool is_registered;
+};
+
+// receive raw data from socket
+rws_bool rws_socket_recv(rws_socket s);
+
+// send raw data to socket, in external loop mode fails instead of waiting when socket would block
+rws_bool rws_socket_send(rws_socket s, const void * data, const size_t data_size);
+
+// send raw data to socket without waiting
+int rws_socket_send_some(rws_socket s, const void * data, const size_t data_size);
+
+void rws_socket_flush_partial_send_frame(rws_socket s);
 
 void rws_socket_idle_recv(rws_socket s);
 
-void rws_socket_idle_send(rws_socket s);
+// process received bytes, switch to disconnect on close frame or protocol error
+void rws_socket_process_received(rws_socket s);
 
-void rws_socket_wait_handshake_responce(rws_socket s);
+void rws_socket_idle_send(rws_socket s);
 
-unsigned int rws_socket_get_next_message_id(rws_socket s);
+rws_bool rws_socket_is_frame_limited(_rws_frame * frame);
 
-void rws_socket_send_ping(rws_socket s);
+void rws_socket_wait_handshake_responce(rws_socket s);
 
+// send close frame in place, without waiting for the endpoint
 void rws_socket_send_disconnect(rws_socket s);
 
+// closing handshake step: drain sends, send close, wait close from endpoint
+void rws_socket_closing(rws_socket s);
+
 void rws_socket_send_handshake(rws_socket s);
 
 struct addrinfo * rws_socket_connect_getaddr_info(rws_socket s);
 
 void rws_socket_connect_to_host(rws_socket s);
 
-rws_bool rws_socket_create_start_work_thread(rws_socket s);
+void rws_socket_connect_next_addr(rws_socket s);
 
-void rws_socket_close(rws_socket s);
+// URL of the connection: current endpoint or socket URL
+const char * rws_socket_get_connect_scheme(rws_socket s);
 
-void rws_socket_resize_received(rws_socket s, const size_t size);
+const char * rws_socket_get_connect_host(rws_socket s);
 
-void rws_socket_append_recvd_frames(rws_socket s, _rws_frame * frame);
+const char * rws_socket_get_connect_path(rws_socket s);
 
-void rws_socket_append_send_frames(rws_socket s, _rws_frame * frame);
+int rws_socket_get_connect_port(rws_socket s);
+
+// 'RWS_UNIX_SCHEME' URL, host is path of the socket file
+rws_bool rws_socket_is_unix(rws_socket s);
+
+// connect to unix domain socket, no resolving and tcp
+void rws_socket_connect_unix(rws_socket s);
+
+void rws_socket_connect_finish(rws_socket s);
+
+// select the best endpoint not tried in this connect, rws_false - all endpoints tried
+rws_bool rws_socket_select_endpoint(rws_socket s);
+
+// connect or handshake failed, connect to the next endpoint, rws_false - no endpoints left
+rws_bool rws_socket_connect_next_endpoint(rws_socket s);
+
+int rws_socket_check_connect(rws_socket s);
+
+void rws_socket_wait_connect(rws_socket s);
+
+// one iteration of the work loop, rws_false - work is finished
+rws_bool rws_socket_work_step(rws_socket s);
+
+unsigned int rws_socket_get_wanted_events_priv(rws_socket s);
+
+unsigned int rws_socket_get_timeout_priv(rws_socket s);
+
+rws_bool rws_socket_create_start_work_thread(rws_socket s);
+
+void rws_socket_close(rws_socket s);
+
+void rws_socket_resize_recvd_batch(rws_socket s, const size_t size);
 
 rws_bool rws_socket_send_text_priv(rws_socket s, const char * text);
 
@@ -147,14 +248,41 @@ rws_bool rws_socket_send_bin_priv(_rws_socket* s, void* dataPtr, size_t dataSize
 
 void rws_socket_inform_recvd_frames(rws_socket s);
 
-void rws_socket_set_option(rws_socket_t s, int option, int value);
+// start time of the application callback, 0 - not measured
+unsigned long long rws_socket_callback_begin(rws_socket s);
+
+// report callback to slow callback hook if needed
+void rws_socket_callback_end(rws_socket s, const rws_callback_type type, const unsigned long long start);
+
+void rws_socket_update_loop_histogram(rws_socket s, const unsigned long long duration_us);
+
+void rws_socket_inform_recvd_frame(rws_socket s, _rws_frame * frame);
+
+void rws_socket_inform_recvd_batch(rws_socket s);
+
+void rws_socket_inform_recvd_executor(rws_socket s);
+
+// complete request with the received message, rws_false - message is not a reply
+rws_bool rws_socket_process_reply(rws_socket s, _rws_frame * frame);
+
+// complete requests with expired timeout
+void rws_socket_process_request_timeouts(rws_socket s);
 
-void rws_socket_delete_all_frames_in_list(_rws_list * list_with_frames);
+// complete all requests in flight
+void rws_socket_complete_requests(rws_socket s, const rws_reply_status status);
+
+// replace tcp transport, e.g. with in memory pipe, before connect
+void rws_socket_set_transport(rws_socket s, const _rws_transport * transport);
+
+void rws_socket_set_option(rws_socket_t s, int option, int value);
 
 void rws_socket_check_write_error(rws_socket s, int error_num);
 
 void rws_socket_delete(rws_socket s);
 
+// remove from the list of all sockets, safe to call twice
+void rws_sockets_unregister(rws_socket s);
+
 #define COMMAND_IDLE -1
 #define COMMAND_NONE 0
 #define COMMAND_CONNECT_TO_HOST 1
@@ -163,9 +291,21 @@ void rws_socket_delete(rws_socket s);
 #define COMMAND_INFORM_CONNECTED 4
 #define COMMAND_INFORM_DISCONNECTED 5
 #define COMMAND_DISCONNECT 6
+#define COMMAND_WAIT_CONNECT 7
 
 #define COMMAND_END 9999
 
+// scheme of the unix domain socket URL
+#define RWS_UNIX_SCHEME "ws+unix"
+
+// release socket: closing handshake if connected, otherwise end
+#define RWS_MAILBOX_RELEASE 1
+// apply 'recv_rate_request'
+#define RWS_MAILBOX_RECV_RATE 2
+
+// post request to the loop thread, applied at the start of the next step
+void rws_socket_post(rws_socket s, const size_t request);
+
 
 
 #endif
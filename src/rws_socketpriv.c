@@ -28,167 +28,343 @@
 
 #define RWS_CONNECT_RETRY_DELAY 200
 #define RWS_CONNECT_ATTEMPS 5
+#define RWS_PING_INTERVAL 2000
+#define RWS_WORK_STEP_DELAY 5
+#define RWS_CLOSE_TIMEOUT 1000
 
-#ifndef  RWS_OS_WINDOWS 
-#define	WSAEWOULDBLOCK  EAGAIN	
-#define	WSAEINPROGRESS     EINPROGRESS	
-#endif
 
-unsigned int rws_socket_get_next_message_id(rws_socket s) {
-	const unsigned int mess_id = ++s->next_message_id;
-	if (mess_id > 9999999) {
-		s->next_message_id = 0;
+unsigned long long rws_socket_callback_begin(rws_socket s) {
+	return s->on_slow_callback ? rws_time_us() : 0;
+}
+
+void rws_socket_callback_end(rws_socket s, const rws_callback_type type, const unsigned long long start) {
+	unsigned long long duration = 0;
+	if (s->on_slow_callback && start) {
+		duration = rws_time_us() - start;
+		if (duration >= s->slow_callback_threshold_us) {
+			s->on_slow_callback(s, type, (duration < 0xFFFFFFFF) ? (unsigned int)duration : 0xFFFFFFFF);
+		}
+	}
+}
+
+void rws_socket_update_loop_histogram(rws_socket s, const unsigned long long duration_us) {
+	unsigned int index = 0;
+	unsigned long long d = duration_us;
+	while (d && index < RWS_LOOP_HISTOGRAM_SIZE - 1) {
+		d >>= 1;
+		index++;
 	}
-	return mess_id;
+	rws_atomic_store(&s->loop_histogram[index], s->loop_histogram[index] + 1); // single writer
 }
 
-void rws_socket_send_ping(rws_socket s) {
-	char buff[16];
-	size_t len = 0;
-	_rws_frame * frame = rws_frame_create();
+void rws_socket_post(rws_socket s, const size_t request) {
+	rws_atomic_fetch_or(&s->mailbox, request);
+}
+
+static void rws_socket_process_mailbox(rws_socket s) {
+	const size_t requests = rws_atomic_exchange(&s->mailbox, 0);
 
-	len = rws_sprintf(buff, 16, "%u", rws_socket_get_next_message_id(s));
+	if (requests & RWS_MAILBOX_RECV_RATE) {
+		rws_bucket_set_rate(&s->recv_bytes_bucket, (unsigned int)rws_atomic_load(&s->recv_rate_request));
+		rws_throttle_update(&s->recv_throttle, rws_false, rws_time_ms());
+		rws_atomic_store(&s->recv_throttled_ms, (size_t)s->recv_throttle.total_ms);
+	}
 
-	frame->is_masked = rws_true;
-	frame->opcode = rws_opcode_ping;
-	rws_frame_fill_with_send_data(frame, buff, len);
-	rws_socket_append_send_frames(s, frame);
+	if (requests & RWS_MAILBOX_RELEASE) {
+		switch (s->command) {
+			case COMMAND_DISCONNECT:
+			case COMMAND_END:
+				break;
+			default:
+				s->command = s->is_connected ? COMMAND_DISCONNECT : COMMAND_END;
+				break;
+		}
+	}
 }
 
-void rws_socket_inform_recvd_frames(rws_socket s) {
-	rws_bool is_all_finished = rws_true;
-	_rws_frame * frame = NULL;
-	_rws_node * cur = s->recvd_frames;
-	while (cur) {
-		frame = (_rws_frame *)cur->value.object;
-		if (frame) {
-			if (frame->is_finished) {
-				switch (frame->opcode) {
-					case rws_opcode_text_frame:
-						if (s->on_recvd_text) {
-							s->on_recvd_text(s, (const char *)frame->data, (unsigned int)frame->data_size);
-						}
-						break;
-					case rws_opcode_binary_frame:
-						if (s->on_recvd_bin) {
-							s->on_recvd_bin(s, frame->data, (unsigned int)frame->data_size);
-						}
-						break;
-					default: break;
+void rws_socket_inform_recvd_frame(rws_socket s, _rws_frame * frame) {
+	unsigned long long start = 0;
+	rws_message message;
+	if (s->on_recvd_message && (frame->opcode == rws_opcode_text_frame || frame->opcode == rws_opcode_binary_frame)) {
+		rws_frame_to_message(frame, &message); // owned by application
+		start = rws_socket_callback_begin(s);
+		s->on_recvd_message(s, &message);
+		rws_socket_callback_end(s, rws_callback_type_recvd_message, start);
+		return;
+	}
+	switch (frame->opcode) {
+		case rws_opcode_text_frame:
+			if (s->on_recvd_text) {
+				start = rws_socket_callback_begin(s);
+				s->on_recvd_text(s, (const char *)frame->data, (unsigned int)frame->data_size);
+				rws_socket_callback_end(s, rws_callback_type_recvd_text, start);
+			}
+			break;
+		case rws_opcode_binary_frame:
+			if (s->on_recvd_bin) {
+				start = rws_socket_callback_begin(s);
+				s->on_recvd_bin(s, frame->data, (unsigned int)frame->data_size);
+				rws_socket_callback_end(s, rws_callback_type_recvd_bin, start);
+			}
+			break;
+		default: break;
+	}
+	rws_frame_delete(frame);
+}
+
+void rws_socket_dispatch_messages(rws_socket s, rws_message * messages, const size_t count) {
+	size_t index = 0;
+	unsigned long long start = 0;
+	if (s->on_recvd_batch) {
+		start = rws_socket_callback_begin(s);
+		s->on_recvd_batch(s, messages, (unsigned int)count);
+		rws_socket_callback_end(s, rws_callback_type_recvd_batch, start);
+	} else if (s->on_recvd_message) {
+		for (index = 0; index < count; index++) {
+			start = rws_socket_callback_begin(s);
+			s->on_recvd_message(s, &messages[index]);
+			rws_socket_callback_end(s, rws_callback_type_recvd_message, start);
+			memset(&messages[index], 0, sizeof(rws_message)); // owned by application
+		}
+	} else {
+		for (index = 0; index < count; index++) {
+			if (messages[index].is_text) {
+				if (s->on_recvd_text) {
+					start = rws_socket_callback_begin(s);
+					s->on_recvd_text(s, (const char *)messages[index].data, (unsigned int)messages[index].data_size);
+					rws_socket_callback_end(s, rws_callback_type_recvd_text, start);
 				}
-				rws_frame_delete(frame);
-				cur->value.object = NULL;
-			} else {
-				is_all_finished = rws_false;
+			} else if (s->on_recvd_bin) {
+				start = rws_socket_callback_begin(s);
+				s->on_recvd_bin(s, messages[index].data, (unsigned int)messages[index].data_size);
+				rws_socket_callback_end(s, rws_callback_type_recvd_bin, start);
 			}
 		}
-		cur = cur->next;
 	}
-	if (is_all_finished) {
-		rws_list_delete_clean(&s->recvd_frames);
+	for (index = 0; index < count; index++) {
+		rws_message_free(&messages[index]);
 	}
 }
 
-void rws_socket_read_handshake_responce_value(const char * str, char ** value) {
-	const char * s = NULL;
-	size_t len = 0;
+rws_bool rws_socket_process_reply(rws_socket s, _rws_frame * frame) {
+	_rws_request request;
+	rws_message message;
+	unsigned long long id = 0, start = 0;
+	rws_bool is_reply = rws_false;
 
-	while (*str == ':' || *str == ' ') {
-		str++;
+	if (!s->on_request_id || (frame->opcode != rws_opcode_text_frame && frame->opcode != rws_opcode_binary_frame)) {
+		return rws_false;
 	}
-	s = str;
-	while (*s != '\r' && *s != '\n') {
-		s++;
-		len++;
+	rws_frame_to_message(frame, &message);
+	if (!s->on_request_id(s, &message, &id)) {
+		return rws_false;
 	}
-	if (len > 0) {
-		*value = rws_string_copy_len(str, len);
+	rws_mutex_lock(s->send_mutex);
+	is_reply = rws_requests_take(&s->requests, id, &request);
+	rws_mutex_unlock(s->send_mutex);
+	if (!is_reply) { // late reply after timeout or not a request
+		return rws_false;
 	}
+	start = rws_socket_callback_begin(s);
+	request.on_reply(s, request.user_data, rws_reply_status_ok, &message);
+	rws_socket_callback_end(s, rws_callback_type_reply, start);
+	return rws_true;
 }
 
-rws_bool rws_socket_process_handshake_responce(rws_socket s) {
-	const char * str = (const char *)s->received;
-	const char * sub = NULL;
-	float http_ver = -1;
-	int http_code = -1;
+void rws_socket_process_request_timeouts(rws_socket s) {
+	_rws_request request;
+	unsigned long long start = 0;
+	const unsigned long long now = rws_time_ms();
+	for (;;) {
+		rws_mutex_lock(s->send_mutex);
+		if (!rws_requests_take_expired(&s->requests, now, &request)) {
+			rws_mutex_unlock(s->send_mutex);
+			break;
+		}
+		rws_mutex_unlock(s->send_mutex);
+		start = rws_socket_callback_begin(s);
+		request.on_reply(s, request.user_data, rws_reply_status_timeout, NULL);
+		rws_socket_callback_end(s, rws_callback_type_reply, start);
+	}
+}
 
-	rws_error_delete_clean(&s->error);
-	sub = strstr(str, "HTTP/");
-	if (!sub) {
-		return rws_false;
+void rws_socket_complete_requests(rws_socket s, const rws_reply_status status) {
+	_rws_request request;
+	unsigned long long start = 0;
+	for (;;) {
+		rws_mutex_lock(s->send_mutex);
+		if (!rws_requests_take_any(&s->requests, &request)) {
+			rws_mutex_unlock(s->send_mutex);
+			break;
+		}
+		rws_mutex_unlock(s->send_mutex);
+		start = rws_socket_callback_begin(s);
+		request.on_reply(s, request.user_data, status, NULL);
+		rws_socket_callback_end(s, rws_callback_type_reply, start);
 	}
-	
-	sub += 5;
-	if (rws_sscanf(sub, "%f %i", &http_ver, &http_code) != 2) {
-		http_ver = -1;
-		http_code = -1;
+}
+
+// move messages to the executor queue, callbacks are called from executor thread
+void rws_socket_inform_recvd_executor(rws_socket s) {
+	_rws_frame * frame = NULL;
+	rws_message message;
+	while ((frame = rws_proto_peek_message(&s->proto))) {
+		rws_proto_pop_message(&s->proto);
+		if (rws_socket_process_reply(s, frame)) {
+			rws_frame_delete(frame);
+			continue;
+		}
+		if (frame->opcode == rws_opcode_text_frame || frame->opcode == rws_opcode_binary_frame) {
+			rws_frame_to_message(frame, &message);
+			rws_executor_push(s->executor, &s->recvd_queue, &message);
+		} else {
+			rws_frame_delete(frame);
+		}
 	}
+}
 
-	sub = strstr(str, k_rws_socket_sec_websocket_accept); // "Sec-WebSocket-Accept"
-	if (sub) {
-		sub += strlen(k_rws_socket_sec_websocket_accept);
-		rws_socket_read_handshake_responce_value(sub, &s->sec_ws_accept);
+void rws_socket_inform_recvd_batch(rws_socket s) {
+	_rws_frame * frame = NULL;
+	size_t count = 0;
+	while ((frame = rws_proto_peek_message(&s->proto))) {
+		rws_proto_pop_message(&s->proto);
+		if (rws_socket_process_reply(s, frame)) {
+			rws_frame_delete(frame);
+			continue;
+		}
+		if (frame->opcode == rws_opcode_text_frame || frame->opcode == rws_opcode_binary_frame) {
+			if (count == s->recvd_batch_size) {
+				rws_socket_resize_recvd_batch(s, count ? count * 2 : 16);
+			}
+			rws_frame_to_message(frame, &s->recvd_batch[count++]);
+		} else {
+			rws_frame_delete(frame);
+		}
+	}
+	if (count) {
+		rws_socket_dispatch_messages(s, s->recvd_batch, count);
 	}
+}
 
-	if (http_code != 101 || !s->sec_ws_accept) {
-		s->error = rws_error_new_code_descr(rws_error_code_parse_handshake,
-											(http_code != 101) ? "HTPP code not found or non 101" : "Accept key not found");
-		return rws_false;
+void rws_socket_inform_recvd_frames(rws_socket s) {
+	_rws_frame * frame = NULL;
+	rws_message message;
+	s->is_recv_paused = rws_false;
+	if (s->executor && !s->recvd_ring) {
+		rws_socket_inform_recvd_executor(s);
+		return;
+	}
+	if (s->on_recvd_batch && !s->recvd_ring) {
+		rws_socket_inform_recvd_batch(s);
+		return;
+	}
+	while ((frame = rws_proto_peek_message(&s->proto))) {
+		if (rws_socket_process_reply(s, frame)) {
+			rws_proto_pop_message(&s->proto);
+			rws_frame_delete(frame);
+			continue;
+		}
+		if (s->recvd_ring && (frame->opcode == rws_opcode_text_frame || frame->opcode == rws_opcode_binary_frame)) {
+			rws_frame_to_message(frame, &message);
+			if (!rws_ring_push(s->recvd_ring, &message)) {
+				s->is_recv_paused = rws_true; // stop reading until consumer takes messages
+				break;
+			}
+			rws_proto_pop_message(&s->proto);
+		} else {
+			rws_proto_pop_message(&s->proto);
+			rws_socket_inform_recvd_frame(s, frame);
+		}
 	}
-	return rws_true;
 }
 
-// need close socket on error
-rws_bool rws_socket_send(rws_socket s, const void * data, const size_t data_size) {
+// returns number of sent bytes, 0 - socket would block, -1 - error and socket closed
+int rws_socket_send_some(rws_socket s, const void * data, const size_t data_size) {
 	int sended = -1, error_number = -1;
 	rws_error_delete_clean(&s->error);
 
-	//errno = -1;
-#if defined(RWS_OS_WINDOWS)
-	sended = send(s->socket, (const char *)data, data_size, 0);
-    error_number = WSAGetLastError();
-#else
-	sended = (int)send(s->socket, data, (int)data_size, 0);
-    error_number = errno;
-#endif
-
-
+	sended = s->transport.send(s->transport.context, data, data_size, &error_number);
 	if (sended > 0) {
-		return rws_true;
+		return sended;
 	}
 
 	rws_socket_check_write_error(s, error_number);
 	if (s->error) {
 		rws_socket_close(s);
-		return rws_false;
+		return -1;
+	}
+	return 0;
+}
+
+// need close socket on error
+rws_bool rws_socket_send(rws_socket s, const void * data, const size_t data_size) {
+	const char * ptr = (const char *)data;
+	size_t left = data_size;
+	unsigned int waited = 0;
+	int sended = 0;
+	while (left > 0) {
+		sended = rws_socket_send_some(s, ptr, left);
+		if (sended < 0) {
+			return rws_false;
+		}
+		if (sended == 0) {
+			// caller's loop is not stalled, used only while disconnecting
+			if (s->is_external_loop || ++waited > RWS_CONNECT_RETRY_DELAY) {
+				s->error = rws_error_new_code_descr(rws_error_code_read_write_socket, "Send timeout");
+				rws_socket_close(s);
+				return rws_false;
+			}
+			rws_thread_sleep(1);
+		}
+		ptr += sended;
+		left -= sended;
 	}
 	return rws_true;
 }
 
 rws_bool rws_socket_recv(rws_socket s) {
 	int is_reading = 1, error_number = -1, len = -1;
-	char * received = NULL;
-	size_t total_len = 0;
+	size_t total_len = 0, allowed = 0, buff_len = 8192;
 	char buff[8192];
 	rws_error_delete_clean(&s->error);
+
+	// handshake responce is not limited, like control frames
+	if (s->is_connected &&
+		(rws_bucket_is_limited(&s->recv_bytes_bucket) || (s->shared_limit && rws_rate_limit_is_recv_limited(s->shared_limit)))) {
+		const unsigned long long now = rws_time_ms();
+		allowed = rws_bucket_available(&s->recv_bytes_bucket, now);
+		if (s->shared_limit && allowed) {
+			const size_t shared = rws_rate_limit_recv_available(s->shared_limit, now);
+			allowed = (shared < allowed) ? shared : allowed;
+		}
+		rws_throttle_update(&s->recv_throttle, allowed ? rws_false : rws_true, now);
+		rws_atomic_store(&s->recv_throttled_ms, (size_t)rws_throttle_get_total(&s->recv_throttle, now));
+		if (!allowed) {
+			return rws_true; // leave data in the kernel buffer
+		}
+	}
+
 	while (is_reading) {
-		len = (int)recv(s->socket, buff, 8192, 0);
-#if defined(RWS_OS_WINDOWS)
-		error_number = WSAGetLastError();
-#else
-		error_number = errno;
-#endif
+		if (allowed) {
+			buff_len = (allowed < 8192) ? allowed : 8192;
+		}
+		len = s->transport.recv(s->transport.context, buff, buff_len, &error_number);
 		if (len > 0) {
 			total_len += len;
-			if (s->received_size - s->received_len < len) {
-				rws_socket_resize_received(s, s->received_size + len);
+			rws_proto_feed(&s->proto, buff, len);
+			if (s->proto.spill_threshold && s->proto.sec_ws_accept) { // big message is moved to file while reading
+				rws_proto_process_frames(&s->proto);
 			}
-			received = (char *)s->received;
-			if (s->received_len) {
-				received += s->received_len;
+			if (allowed) {
+				rws_bucket_consume(&s->recv_bytes_bucket, len);
+				if (s->shared_limit) {
+					rws_rate_limit_consume_recv(s->shared_limit, len);
+				}
+				allowed -= len;
+				if (!allowed) {
+					return rws_true;
+				}
 			}
-			memcpy(received, buff, len);
-			s->received_len += len;
 		} else {
 			is_reading = 0;
 		}
@@ -202,118 +378,138 @@ rws_bool rws_socket_recv(rws_socket s) {
 	return rws_true;
 }
 
-_rws_frame * rws_socket_last_unfin_recvd_frame_by_opcode(rws_socket s, const rws_opcode opcode) {
-	_rws_frame * last = NULL;
-	_rws_frame * frame = NULL;
-	_rws_node * cur = s->recvd_frames;
-	while (cur) {
-		frame = (_rws_frame *)cur->value.object;
-		if (frame) {
-            //  [FIN=0,opcode !=0 ],[FIN=0,opcode ==0 ],....[FIN=1,opcode ==0 ]
-			if (!frame->is_finished /*&& frame->opcode == opcode*/) {
-				last = frame;
-			}
+void rws_socket_idle_recv(rws_socket s) {
+	if (!rws_socket_recv(s)) {
+		// sock already closed
+		if (s->error) {
+			s->command = COMMAND_INFORM_DISCONNECTED;
 		}
-		cur = cur->next;
+		return;
 	}
-	return last;
+	rws_socket_process_received(s);
 }
 
-void rws_socket_process_bin_or_text_frame(rws_socket s, _rws_frame * frame) {
-	_rws_frame * last_unfin = rws_socket_last_unfin_recvd_frame_by_opcode(s, frame->opcode);
-	if (last_unfin) {
-		rws_frame_combine_datas(last_unfin, frame);
-		last_unfin->is_finished = frame->is_finished;
-		rws_frame_delete(frame);
-	} else if (frame->data && frame->data_size) {
-		rws_socket_append_recvd_frames(s, frame);
-	} else {
-		rws_frame_delete(frame);
+void rws_socket_process_received(rws_socket s) {
+	rws_proto_process_frames(&s->proto);
+	if (s->proto.is_pong_received) {
+		s->proto.is_pong_received = rws_false;
+		if (s->ping_sent_us && s->endpoint >= 0) {
+			rws_endpoints_report_rtt(s->endpoints, s->endpoint, (unsigned int)(rws_time_us() - s->ping_sent_us));
+		}
+		s->ping_sent_us = 0;
+	}
+	if (s->proto.is_close_received) {
+		rws_atomic_store(&s->recvd_close_code, s->proto.close_code);
+		rws_error_delete_clean(&s->error);
+		s->error = s->proto.error;
+		s->proto.error = NULL;
+		s->command = COMMAND_INFORM_DISCONNECTED;
+	} else if (s->proto.fail_code) { // fail connection with close code
+		rws_error_delete_clean(&s->error);
+		s->error = s->proto.error;
+		s->proto.error = NULL;
+		s->close_code = s->proto.fail_code;
+		s->command = COMMAND_INFORM_DISCONNECTED;
 	}
 }
 
-void rws_socket_process_ping_frame(rws_socket s, _rws_frame * frame) {
-	_rws_frame * pong_frame = rws_frame_create();
-	pong_frame->opcode = rws_opcode_pong;
-	pong_frame->is_masked = rws_true;
-	rws_frame_fill_with_send_data(pong_frame, frame->data, frame->data_size);
-	rws_frame_delete(frame);
-	rws_socket_append_send_frames(s, pong_frame);
-}
-
-void rws_socket_process_conn_close_frame(rws_socket s, _rws_frame * frame) {
-	s->command = COMMAND_INFORM_DISCONNECTED;
-	s->error = rws_error_new_code_descr(rws_error_code_connection_closed, "Connection was closed by endpoint");
-	//rws_socket_close(s);
-	rws_frame_delete(frame);
-}
-
-void rws_socket_process_received_frame(rws_socket s, _rws_frame * frame) {
+rws_bool rws_socket_is_frame_limited(_rws_frame * frame) {
 	switch (frame->opcode) {
-		case rws_opcode_ping: rws_socket_process_ping_frame(s, frame); break;
-		case rws_opcode_text_frame:
-		case rws_opcode_binary_frame:
-		case rws_opcode_continuation:
-			rws_socket_process_bin_or_text_frame(s, frame);
-			break;
-		case rws_opcode_connection_close: rws_socket_process_conn_close_frame(s, frame); break;
-		default:
-			// unprocessed => delete
-			rws_frame_delete(frame);
-			break;
+		case rws_opcode_ping:
+		case rws_opcode_pong:
+		case rws_opcode_connection_close:
+			return rws_false;
+		default: break;
 	}
+	return rws_true;
 }
 
-void rws_socket_idle_recv(rws_socket s) {
+void rws_socket_idle_send(rws_socket s) {
+	rws_bool is_throttled = rws_false;
 	_rws_frame * frame = NULL;
+	unsigned long long now = 0;
+	int sended = 0;
+	rws_bool is_limited = rws_false;
 
-	if (!rws_socket_recv(s)) {
-		// sock already closed
-		if (s->error) {
-			s->command = COMMAND_INFORM_DISCONNECTED;
-		}
+	// 'send_frame' is owned by the loop, queued output is published with atomic flag, so idle step takes no lock
+	if (!s->send_frame && !rws_proto_is_output_posted(&s->proto)) {
 		return;
 	}
-
-   const size_t nframe_size = rws_check_recv_frame_size(s->received, s->received_len);
-   if (nframe_size) {
-       frame = rws_frame_create_with_recv_data(s->received, nframe_size);
-       if (frame)  {
-           rws_socket_process_received_frame(s, frame);
-       }
-	   
-       if (nframe_size == s->received_len) {
-           s->received_len = 0;
-       } else if (s->received_len > nframe_size) {
-           const size_t nLeftLen = s->received_len - nframe_size;
-           memmove((char*)s->received, (char*)s->received + nframe_size, nLeftLen);
-           s->received_len = nLeftLen;
-       }
-   }
-}
-
-void rws_socket_idle_send(rws_socket s) {
-	_rws_node * cur = NULL;
-	rws_bool sending = rws_true;
-	_rws_frame * frame = NULL;
-
 	rws_mutex_lock(s->send_mutex);
-	cur = s->send_frames;
-	if (cur) {
-		while (cur && s->is_connected && sending) {
-			frame = (_rws_frame *)cur->value.object;
-			cur->value.object = NULL;
-			if (frame) {
-				sending = rws_socket_send(s, frame->data, frame->data_size);
+	is_limited = rws_bucket_is_limited(&s->send_msgs_bucket) || rws_bucket_is_limited(&s->send_bytes_bucket) ||
+		(s->shared_limit && rws_rate_limit_is_send_limited(s->shared_limit));
+	if (s->send_frame || rws_proto_has_output(&s->proto)) {
+		if (is_limited) {
+			now = rws_time_ms();
+		}
+		while (s->is_connected) {
+			if (!s->send_frame) {
+				frame = rws_proto_peek_output(&s->proto);
+				if (!frame) {
+					frame = rws_proto_get_file_message(&s->proto);
+					if (!frame) {
+						break;
+					}
+					// file I/O without lock, application threads sending messages are not blocked
+					rws_mutex_unlock(s->send_mutex);
+					frame = rws_frame_create_file_part(frame);
+					rws_mutex_lock(s->send_mutex);
+					rws_proto_put_file_part(&s->proto, frame);
+					continue;
+				}
+				if (is_limited && rws_socket_is_frame_limited(frame)) {
+					// shared tokens are taken last, only when the socket limits allow the frame
+					if (!rws_bucket_available(&s->send_msgs_bucket, now) ||
+						!rws_bucket_available(&s->send_bytes_bucket, now) ||
+						(s->shared_limit && !rws_rate_limit_take_send(s->shared_limit, frame->data_size, now))) {
+						is_throttled = rws_true;
+						break;
+					}
+					rws_bucket_consume(&s->send_msgs_bucket, 1);
+					rws_bucket_consume(&s->send_bytes_bucket, frame->data_size);
+				}
+				rws_proto_pop_output(&s->proto);
+				s->send_frame = frame;
+				s->send_offset = 0;
 			}
-			rws_frame_delete(frame);
-			cur = cur->next;
+			frame = s->send_frame;
+			sended = rws_socket_send_some(s, (const char *)frame->data + s->send_offset, frame->data_size - s->send_offset);
+			if (sended < 0) {
+				break;
+			}
+			s->send_offset += sended;
+			if (s->send_offset < frame->data_size) {
+				break; // would block, continue from offset on next cycle
+			}
+			rws_frame_delete_clean(&s->send_frame);
+			s->send_offset = 0;
+		}
+		if (is_limited) {
+			rws_throttle_update(&s->send_throttle, is_throttled, now);
 		}
-		rws_list_delete_clean(&s->send_frames);
 		if (s->error) {
 			s->command = COMMAND_INFORM_DISCONNECTED;
+		} else if (s->proto.fail_code) { // message from file can't be finished
+			s->error = s->proto.error;
+			s->proto.error = NULL;
+			s->close_code = s->proto.fail_code;
+			s->command = COMMAND_INFORM_DISCONNECTED;
+		}
+	}
+	rws_proto_update_output_posted(&s->proto);
+	rws_mutex_unlock(s->send_mutex);
+}
+
+// finish sending of the partially sent frame, so the stream stays valid
+void rws_socket_flush_partial_send_frame(rws_socket s) {
+	rws_mutex_lock(s->send_mutex);
+	if (s->send_frame) {
+		if (s->transport.is_open(s->transport.context)) {
+			rws_socket_send(s, (const char *)s->send_frame->data + s->send_offset, s->send_frame->data_size - s->send_offset);
 		}
+		rws_frame_delete_clean(&s->send_frame);
 	}
+	s->send_offset = 0;
 	rws_mutex_unlock(s->send_mutex);
 }
 
@@ -325,65 +521,120 @@ void rws_socket_wait_handshake_responce(rws_socket s) {
 		}
 		return;
 	}
-	
-	if (s->received_len == 0) {
-		return;
-	}
 
-	if (rws_socket_process_handshake_responce(s)) {
-        s->received_len = 0;
-		s->is_connected = rws_true;
-		s->command = COMMAND_INFORM_CONNECTED;
-	} else {
-		rws_socket_close(s);
-		s->command = COMMAND_INFORM_DISCONNECTED;
+	switch (rws_proto_process_handshake(&s->proto)) {
+		case 1:
+			if (s->endpoints && s->endpoint >= 0) {
+				rws_endpoints_report_connected(s->endpoints, s->endpoint, (unsigned int)(rws_time_us() - s->connect_start_us));
+			}
+			s->connect_start_us = 0;
+			s->ping_sent_us = 0;
+			rws_mutex_lock(s->send_mutex);
+			s->is_connected = rws_true;
+			rws_mutex_unlock(s->send_mutex);
+			s->command = COMMAND_INFORM_CONNECTED;
+			break;
+		case -1:
+			rws_error_delete_clean(&s->error);
+			s->error = s->proto.error;
+			s->proto.error = NULL;
+			rws_socket_close(s);
+			s->command = COMMAND_INFORM_DISCONNECTED;
+			break;
+		default: break;
 	}
 }
 
 void rws_socket_send_disconnect(rws_socket s) {
-	char buff[16];
-	size_t len = 0;
-	_rws_frame * frame = rws_frame_create();
+	_rws_frame * frame = NULL;
+	rws_error error = s->error; // keep disconnect reason, sending cleans error
+	s->error = NULL;
 
-	len = rws_sprintf(buff, 16, "%u", rws_socket_get_next_message_id(s));
+	rws_socket_flush_partial_send_frame(s);
 
-	frame->is_masked = rws_true;
-	frame->opcode = rws_opcode_connection_close;
-	rws_frame_fill_with_send_data(frame, buff, len);
-	rws_socket_send(s, frame->data, frame->data_size);
-	rws_frame_delete(frame);
+	if (s->transport.is_open(s->transport.context)) {
+		rws_mutex_lock(s->send_mutex);
+		if (s->proto.close_code) { // echo endpoint code
+			rws_proto_send_close(&s->proto, s->proto.close_code, NULL);
+		} else {
+			rws_proto_send_close(&s->proto, s->close_code, s->close_reason);
+		}
+		while (s->proto.control_frames && !s->error) {
+			frame = rws_proto_peek_output(&s->proto);
+			rws_proto_pop_output(&s->proto);
+			rws_socket_send(s, frame->data, frame->data_size);
+			rws_frame_delete(frame);
+		}
+		rws_mutex_unlock(s->send_mutex);
+	}
+
+	if (error) {
+		rws_error_delete_clean(&s->error);
+		s->error = error;
+	}
 	s->command = COMMAND_END;
-	rws_thread_sleep(RWS_CONNECT_RETRY_DELAY); // little bit wait after send message
 }
 
-void rws_socket_send_handshake(rws_socket s) {
-	char buff[512];
-	char * ptr = buff;
-	size_t writed = 0;
-	writed = rws_sprintf(ptr, 512, "GET %s HTTP/%s\r\n", s->path, k_rws_socket_min_http_ver);
+void rws_socket_closing(rws_socket s) {
+	const unsigned long long now = rws_time_ms();
+	rws_bool is_done = rws_false;
 
-	if (s->port == 80) {
-		writed += rws_sprintf(ptr + writed, 512 - writed, "Host: %s\r\n", s->host);
-	} else {
-		writed += rws_sprintf(ptr + writed, 512 - writed, "Host: %s:%i\r\n", s->host, s->port);
+	if (!s->close_deadline_ms) {
+		s->close_deadline_ms = now + RWS_CLOSE_TIMEOUT;
+	}
+	if (!s->is_connected || now >= s->close_deadline_ms) {
+		s->command = COMMAND_END;
+		return;
+	}
+
+	rws_mutex_lock(s->send_mutex);
+	if (s->proto.is_close_received) { // endpoint will not read anything else
+		rws_proto_delete_send_frames(&s->proto);
+	}
+	if (!s->proto.is_close_sent && !s->send_frame && !rws_proto_has_send_frames(&s->proto)) {
+		if (s->proto.close_code) {
+			rws_proto_send_close(&s->proto, s->proto.close_code, NULL);
+		} else {
+			rws_proto_send_close(&s->proto, s->close_code, s->close_reason);
+		}
 	}
+	rws_mutex_unlock(s->send_mutex);
 
-	writed += rws_sprintf(ptr + writed, 512 - writed,
-						  "Upgrade: websocket\r\n"
-						  "Connection: Upgrade\r\n"
-						  "Origin: %s://%s\r\n",
-						  s->scheme, s->host);
+	rws_socket_idle_send(s);
+	if (!s->error && rws_socket_recv(s)) {
+		rws_proto_process_frames(&s->proto);
+		if (s->proto.is_close_received) {
+			rws_atomic_store(&s->recvd_close_code, s->proto.close_code);
+		}
+		rws_proto_delete_frames(&s->proto.recvd_frames); // socket released, nobody to inform
+		s->proto.recvd_last = NULL;
+	}
 
-	writed += rws_sprintf(ptr + writed, 512 - writed,
-						  "Sec-WebSocket-Key: %s\r\n"
-						  "Sec-WebSocket-Protocol: chat, superchat\r\n"
-						  "Sec-WebSocket-Version: 13\r\n"
-						  "\r\n",
-						  "dGhlIHNhbXBsZSBub25jZQ==");
+	rws_mutex_lock(s->send_mutex);
+	is_done = (s->proto.is_close_sent && s->proto.is_close_received && !s->send_frame && !rws_proto_has_output(&s->proto)) ? rws_true : rws_false;
+	rws_mutex_unlock(s->send_mutex);
 
-	if (rws_socket_send(s, buff, writed)) {
-		s->command = COMMAND_WAIT_HANDSHAKE_RESPONCE;
-	} else {
+	if (s->error || is_done) {
+		s->command = COMMAND_END;
+	}
+}
+
+void rws_socket_send_handshake(rws_socket s) {
+	int sended = 0;
+	if (!s->handshake_offset) {
+		if (rws_socket_is_unix(s)) { // socket file path is not a host
+			rws_proto_create_handshake(&s->proto, rws_socket_get_connect_scheme(s), "localhost", 80, rws_socket_get_connect_path(s));
+		} else {
+			rws_proto_create_handshake(&s->proto,
+									   rws_socket_get_connect_scheme(s),
+									   rws_socket_get_connect_host(s),
+									   rws_socket_get_connect_port(s),
+									   rws_socket_get_connect_path(s));
+		}
+	}
+	sended = rws_socket_send_some(s, s->proto.handshake + s->handshake_offset, s->proto.handshake_len - s->handshake_offset);
+	if (sended < 0) {
+		s->handshake_offset = 0;
 		if (s->error) {
 			s->error->code = rws_error_code_send_handshake;
 		} else {
@@ -391,14 +642,20 @@ void rws_socket_send_handshake(rws_socket s) {
 		}
 		rws_socket_close(s);
 		s->command = COMMAND_INFORM_DISCONNECTED;
+		return;
 	}
+	s->handshake_offset += sended;
+	if (s->handshake_offset == s->proto.handshake_len) {
+		s->handshake_offset = 0;
+		s->command = COMMAND_WAIT_HANDSHAKE_RESPONCE;
+	} // would block, continue from offset when writable
 }
 
 struct addrinfo * rws_socket_connect_getaddr_info(rws_socket s) {
 	struct addrinfo hints;
 	char portstr[16];
 	struct addrinfo * result = NULL;
-	int ret = 0, retry_number = 0, last_ret = 0;
+	int ret = 0;
 #if defined(RWS_OS_WINDOWS)
 	WSADATA wsa;
 #endif
@@ -414,264 +671,519 @@ struct addrinfo * rws_socket_connect_getaddr_info(rws_socket s) {
 	}
 #endif
 
-	rws_sprintf(portstr, 16, "%i", s->port);
-	while (++retry_number < RWS_CONNECT_ATTEMPS) {
-		result = NULL;
-		memset(&hints, 0, sizeof(hints));
-		hints.ai_family = AF_UNSPEC;
-		hints.ai_socktype = SOCK_STREAM;
+	rws_sprintf(portstr, 16, "%i", rws_socket_get_connect_port(s));
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
 
-		ret = getaddrinfo(s->host, portstr, &hints, &result);
-		if (ret == 0 && result) {
-			return result;
-		}
-
-		if (ret != 0) {
-			last_ret = ret;
-		}
-		
-		if (result) {
-			freeaddrinfo(result);
-		}
-		
-		rws_thread_sleep(RWS_CONNECT_RETRY_DELAY);
+	ret = getaddrinfo(rws_socket_get_connect_host(s), portstr, &hints, &result);
+	if (ret == 0 && result) {
+		return result;
+	}
+	if (result) {
+		freeaddrinfo(result);
 	}
 
 #if defined(RWS_OS_WINDOWS)
 	WSACleanup();
 #endif
 
+	// retry on the next step after delay, loop is not blocked
+	if (++s->connect_attempt < RWS_CONNECT_ATTEMPS) {
+		s->connect_retry_ms = rws_time_ms() + RWS_CONNECT_RETRY_DELAY;
+		return NULL;
+	}
+
+	s->connect_attempt = 0;
 	s->error = rws_error_new_code_descr(rws_error_code_connect_to_host,
-										(last_ret > 0) ? gai_strerror(last_ret) : "Failed connect to host");
+										(ret != 0) ? gai_strerror(ret) : "Failed connect to host");
 	s->command = COMMAND_INFORM_DISCONNECTED;
 	return NULL;
 }
 
 void rws_socket_connect_to_host(rws_socket s) {
-	struct addrinfo * result = NULL;
+	if (s->connect_retry_ms) {
+		if (rws_time_ms() < s->connect_retry_ms) {
+			return;
+		}
+		s->connect_retry_ms = 0;
+	}
+
+	if (s->transport.open) { // not tcp, nothing to resolve
+		rws_error_delete_clean(&s->error);
+		if (s->transport.open(s->transport.context)) {
+			rws_proto_reset(&s->proto);
+			s->command = COMMAND_SEND_HANDSHAKE;
+		} else {
+			s->error = rws_error_new_code_descr(rws_error_code_connect_to_host, "Failed connect to host");
+			s->command = COMMAND_INFORM_DISCONNECTED;
+		}
+		return;
+	}
+
+	if (rws_socket_is_unix(s)) {
+		rws_socket_connect_unix(s);
+		return;
+	}
+
+	if (!s->connect_addrs) {
+		s->connect_addrs = rws_socket_connect_getaddr_info(s);
+		if (!s->connect_addrs) {
+			return;
+		}
+		s->connect_addr = s->connect_addrs;
+		s->connect_attempt = 0;
+	}
+
+	rws_socket_connect_next_addr(s);
+}
+
+void rws_socket_connect_finish(rws_socket s) {
+	if (s->connect_addrs) {
+		freeaddrinfo(s->connect_addrs);
+		s->connect_addrs = NULL;
+	}
+	s->connect_addr = NULL;
+	s->connect_retry_ms = 0;
+	s->connect_attempt = 0;
+}
+
+rws_bool rws_socket_select_endpoint(rws_socket s) {
+	const _rws_endpoint * item = NULL;
+	const int index = rws_endpoints_select(s->endpoints, s->endpoints_tried);
+	if (index < 0) {
+		return rws_false;
+	}
+	item = rws_endpoints_get(s->endpoints, index);
+	s->endpoint = index;
+	if (s->endpoint_url != item) { // application threads can read socket URL, it is not replaced
+		s->endpoint_url = item;
+		s->proto.handshake_len = 0;
+	}
+	return rws_true;
+}
+
+rws_bool rws_socket_connect_next_endpoint(rws_socket s) {
+	if (!s->endpoints || s->endpoint < 0 || !s->connect_start_us) { // connected endpoint is not replaced
+		return rws_false;
+	}
+	rws_endpoints_report_failed(s->endpoints, s->endpoint);
+	s->endpoints_tried |= 1u << s->endpoint;
+	if (!rws_socket_select_endpoint(s)) {
+		return rws_false;
+	}
+	rws_socket_close(s);
+	rws_socket_connect_finish(s);
+	rws_error_delete_clean(&s->error);
+	s->connect_start_us = rws_time_us();
+	s->command = COMMAND_CONNECT_TO_HOST;
+	return rws_true;
+}
+
+void rws_socket_connect_next_addr(rws_socket s) {
 	struct addrinfo * p = NULL;
 	rws_socket_t sock = RWS_INVALID_SOCKET;
-	int retry_number = 0;
+	int error_number = 0;
 #if defined(RWS_OS_WINDOWS)
 	unsigned long iMode = 0;
 #endif
 
-	result = rws_socket_connect_getaddr_info(s);
-	if (!result) {
-		return;
-	}
+	while ((p = s->connect_addr)) {
+		s->connect_addr = p->ai_next;
+		sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+		if (sock == RWS_INVALID_SOCKET) {
+			continue;
+		}
 
-	while ((++retry_number < RWS_CONNECT_ATTEMPS) && (sock == RWS_INVALID_SOCKET)) {
-		for (p = result; p != NULL; p = p->ai_next) {
-			sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-			if (sock != RWS_INVALID_SOCKET) {
-				rws_socket_set_option(sock, SO_ERROR, 1); // When an error occurs on a socket, set error variable so_error and notify process
-				rws_socket_set_option(sock, SO_KEEPALIVE, 1); // Periodically test if connection is alive
+		rws_socket_set_option(sock, SO_ERROR, 1); // When an error occurs on a socket, set error variable so_error and notify process
+		rws_socket_set_option(sock, SO_KEEPALIVE, 1); // Periodically test if connection is alive
 
-				if (connect(sock, p->ai_addr, p->ai_addrlen) == 0) {
-                    s->received_len = 0;
-					s->socket = sock;
 #if defined(RWS_OS_WINDOWS)
-					// If iMode != 0, non-blocking mode is enabled.
-					iMode = 1;
-					ioctlsocket(s->socket, FIONBIO, &iMode);
+		// If iMode != 0, non-blocking mode is enabled.
+		iMode = 1;
+		ioctlsocket(sock, FIONBIO, &iMode);
 #else
-					fcntl(s->socket, F_SETFL, O_NONBLOCK);
+		fcntl(sock, F_SETFL, O_NONBLOCK);
 #endif
-					break;
-				}
-				RWS_SOCK_CLOSE(sock);
-			}
+
+		if (connect(sock, p->ai_addr, p->ai_addrlen) == 0) {
+			s->socket = sock;
+			rws_proto_reset(&s->proto);
+			rws_socket_connect_finish(s);
+			s->command = COMMAND_SEND_HANDSHAKE;
+			return;
 		}
-		if (sock == RWS_INVALID_SOCKET) {
-			rws_thread_sleep(RWS_CONNECT_RETRY_DELAY);
+
+#if defined(RWS_OS_WINDOWS)
+		error_number = WSAGetLastError();
+#else
+		error_number = errno;
+#endif
+		if (error_number == WSAEINPROGRESS || error_number == WSAEWOULDBLOCK) {
+			s->socket = sock;
+			s->command = COMMAND_WAIT_CONNECT;
+			return;
 		}
+		RWS_SOCK_CLOSE(sock);
 	}
 
-	freeaddrinfo(result);
+	// all addresses failed, retry later without blocking, with endpoints the next endpoint is faster
+	if (!s->endpoints && ++s->connect_attempt < RWS_CONNECT_ATTEMPS) {
+		s->connect_addr = s->connect_addrs;
+		s->connect_retry_ms = rws_time_ms() + RWS_CONNECT_RETRY_DELAY;
+		s->command = COMMAND_CONNECT_TO_HOST;
+		return;
+	}
 
-	if (s->socket == RWS_INVALID_SOCKET) {
+	rws_socket_connect_finish(s);
 #if defined(RWS_OS_WINDOWS)
-		WSACleanup();
+	WSACleanup();
 #endif
-		s->error = rws_error_new_code_descr(rws_error_code_connect_to_host, "Failed connect to host");
+	s->error = rws_error_new_code_descr(rws_error_code_connect_to_host, "Failed connect to host");
+	s->command = COMMAND_INFORM_DISCONNECTED;
+}
+
+const char * rws_socket_get_connect_scheme(rws_socket s) {
+	return s->endpoint_url ? s->endpoint_url->scheme : s->scheme;
+}
+
+const char * rws_socket_get_connect_host(rws_socket s) {
+	return s->endpoint_url ? s->endpoint_url->host : s->host;
+}
+
+const char * rws_socket_get_connect_path(rws_socket s) {
+	return s->endpoint_url ? s->endpoint_url->path : s->path;
+}
+
+int rws_socket_get_connect_port(rws_socket s) {
+	return s->endpoint_url ? s->endpoint_url->port : s->port;
+}
+
+rws_bool rws_socket_is_unix(rws_socket s) {
+	const char * scheme = rws_socket_get_connect_scheme(s);
+	return (scheme && strcmp(scheme, RWS_UNIX_SCHEME) == 0) ? rws_true : rws_false;
+}
+
+void rws_socket_connect_unix(rws_socket s) {
+#if defined(RWS_OS_WINDOWS)
+	s->error = rws_error_new_code_descr(rws_error_code_connect_to_host, "Unix domain sockets are not supported");
+	s->command = COMMAND_INFORM_DISCONNECTED;
+#else
+	struct sockaddr_un addr;
+	rws_socket_t sock = RWS_INVALID_SOCKET;
+	const char * file_path = rws_socket_get_connect_host(s);
+
+	if (strlen(file_path) >= sizeof(addr.sun_path)) {
+		s->error = rws_error_new_code_descr(rws_error_code_connect_to_host, "Unix socket path is too long");
 		s->command = COMMAND_INFORM_DISCONNECTED;
-	} else {
-		s->command = COMMAND_SEND_HANDSHAKE;
+		return;
 	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, file_path);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock != RWS_INVALID_SOCKET) {
+		fcntl(sock, F_SETFL, O_NONBLOCK);
+		if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+			s->socket = sock;
+			rws_proto_reset(&s->proto);
+			rws_socket_connect_finish(s);
+			s->command = COMMAND_SEND_HANDSHAKE;
+			return;
+		}
+		if (errno == EINPROGRESS) {
+			s->socket = sock;
+			s->command = COMMAND_WAIT_CONNECT;
+			return;
+		}
+		RWS_SOCK_CLOSE(sock);
+	}
+	rws_socket_connect_next_addr(s); // no addresses, retry later or fail
+#endif
 }
 
-static void rws_socket_work_th_func(void * user_object) {
-	rws_socket s = (rws_socket)user_object;
-	size_t loop_number = 0;
-	while (s->command < COMMAND_END) {
-		loop_number++;
-		rws_mutex_lock(s->work_mutex);
-		switch (s->command) {
-			case COMMAND_CONNECT_TO_HOST: rws_socket_connect_to_host(s); break;
-			case COMMAND_SEND_HANDSHAKE: rws_socket_send_handshake(s); break;
-			case COMMAND_WAIT_HANDSHAKE_RESPONCE: rws_socket_wait_handshake_responce(s); break;
-			case COMMAND_DISCONNECT: rws_socket_send_disconnect(s); break;
-			case COMMAND_IDLE:
-				if (loop_number >= 400) {
-					loop_number = 0;
-					
-					if (s->is_connected) {
-						rws_socket_send_ping(s);
+// 1 - connected, 0 - in progress, -1 - failed
+int rws_socket_check_connect(rws_socket s) {
+#if defined(RWS_OS_WINDOWS)
+	fd_set write_fds, except_fds;
+	struct timeval tv;
+	int socket_code = 0, socket_code_size = sizeof(int);
+
+	FD_ZERO(&write_fds);
+	FD_ZERO(&except_fds);
+	FD_SET(s->socket, &write_fds);
+	FD_SET(s->socket, &except_fds);
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+	if (select(0, NULL, &write_fds, &except_fds, &tv) <= 0) {
+		return 0;
+	}
+	if (FD_ISSET(s->socket, &except_fds)) {
+		return -1;
+	}
+	if (getsockopt(s->socket, SOL_SOCKET, SO_ERROR, (char *)&socket_code, &socket_code_size) != 0) {
+		return -1;
+	}
+#else
+	struct pollfd pfd;
+	int socket_code = 0;
+	socklen_t socket_code_size = sizeof(socket_code);
+
+	pfd.fd = s->socket;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, 0) <= 0) {
+		return 0;
+	}
+	if (getsockopt(s->socket, SOL_SOCKET, SO_ERROR, &socket_code, &socket_code_size) != 0) {
+		return -1;
+	}
+#endif
+	return (socket_code == 0) ? 1 : -1;
+}
+
+void rws_socket_wait_connect(rws_socket s) {
+	switch (rws_socket_check_connect(s)) {
+		case 1:
+			rws_proto_reset(&s->proto);
+			rws_socket_connect_finish(s);
+			s->command = COMMAND_SEND_HANDSHAKE;
+			break;
+		case -1:
+			RWS_SOCK_CLOSE(s->socket);
+			s->socket = RWS_INVALID_SOCKET;
+			rws_socket_connect_next_addr(s);
+			break;
+		default: break;
+	}
+}
+
+rws_bool rws_socket_work_step(rws_socket s) {
+	const unsigned long long step_start = rws_time_us();
+	unsigned long long now = 0, start = 0;
+
+	if (rws_atomic_load(&s->mailbox)) {
+		rws_socket_process_mailbox(s);
+	}
+
+	switch (s->command) {
+		case COMMAND_CONNECT_TO_HOST: rws_socket_connect_to_host(s); break;
+		case COMMAND_WAIT_CONNECT: rws_socket_wait_connect(s); break;
+		case COMMAND_SEND_HANDSHAKE: rws_socket_send_handshake(s); break;
+		case COMMAND_WAIT_HANDSHAKE_RESPONCE: rws_socket_wait_handshake_responce(s); break;
+		case COMMAND_DISCONNECT: rws_socket_closing(s); break;
+		case COMMAND_IDLE:
+			if (s->is_connected) {
+				now = rws_time_ms();
+				if (now >= s->next_ping_ms) {
+					s->next_ping_ms = now + RWS_PING_INTERVAL;
+					rws_proto_send_ping(&s->proto);
+					if (s->endpoints && !s->ping_sent_us) {
+						s->ping_sent_us = rws_time_us();
 					}
 				}
-				
-				if (s->is_connected) {
-					rws_socket_idle_send(s);
+			}
+
+			if (s->is_connected) {
+				rws_socket_idle_send(s);
+			}
+
+			if (s->executor && !s->recvd_ring) {
+				s->is_recv_paused = (rws_executor_get_pending(s->executor, &s->recvd_queue) >= RWS_EXECUTOR_MAX_PENDING) ? rws_true : rws_false;
+			}
+
+			if (s->is_connected && !s->is_recv_paused) {
+				rws_socket_idle_recv(s);
+			}
+			break;
+		default: break;
+	}
+
+	if (s->on_request_id && s->command != COMMAND_END) {
+		rws_socket_process_request_timeouts(s);
+	}
+
+	switch (s->command) {
+		case COMMAND_INFORM_CONNECTED:
+			s->command = COMMAND_IDLE;
+			s->next_ping_ms = rws_time_ms() + RWS_PING_INTERVAL;
+			if (s->on_connected) {
+				start = rws_socket_callback_begin(s);
+				s->on_connected(s);
+				rws_socket_callback_end(s, rws_callback_type_connected, start);
+			}
+			if (s->proto.received_len) { // frames sent together with handshake responce
+				rws_socket_process_received(s);
+			}
+			break;
+		default: break;
+	}
+
+	switch (s->command) {
+		case COMMAND_INFORM_DISCONNECTED: {
+				if (rws_socket_connect_next_endpoint(s)) {
+					break; // not informed while endpoints left
 				}
-				
-				if (s->is_connected) {
-					rws_socket_idle_recv(s);
+				if (s->proto.recvd_frames) { // messages received before close
+					rws_socket_inform_recvd_frames(s);
 				}
-				break;
-			default: break;
-		}
-		
-		rws_mutex_unlock(s->work_mutex);
-		
-		switch (s->command) {
-			case COMMAND_INFORM_CONNECTED:
-				s->command = COMMAND_IDLE;
-				if (s->on_connected) {
-					s->on_connected(s);
+				s->command = COMMAND_END;
+				rws_socket_send_disconnect(s);
+				if (s->executor) {
+					rws_executor_drain(s->executor, &s->recvd_queue); // received messages first
 				}
-				break;
-			case COMMAND_INFORM_DISCONNECTED: {
-                    s->command = COMMAND_END;
-                    rws_socket_send_disconnect(s);
-                    if (s->on_disconnected)  {
-                        s->on_disconnected(s);
-                    }
-                }
-				break;
-			case COMMAND_IDLE:
-				if (s->recvd_frames) {
-					rws_socket_inform_recvd_frames(s);
+				if (s->on_request_id) {
+					rws_socket_complete_requests(s, rws_reply_status_disconnected);
 				}
-				break;
-			default: break;
-		}
-		rws_thread_sleep(5);
+				if (s->on_disconnected)  {
+					start = rws_socket_callback_begin(s);
+					s->on_disconnected(s);
+					rws_socket_callback_end(s, rws_callback_type_disconnected, start);
+				}
+			}
+			break;
+		case COMMAND_IDLE:
+			if (s->proto.recvd_frames) {
+				rws_socket_inform_recvd_frames(s);
+			}
+			break;
+		default: break;
 	}
 
-	rws_socket_close(s);
-	s->work_thread = NULL;
-	rws_socket_delete(s);
-}
+	rws_socket_update_loop_histogram(s, rws_time_us() - step_start);
 
-rws_bool rws_socket_create_start_work_thread(rws_socket s) {
-	rws_error_delete_clean(&s->error);
-	s->command = COMMAND_NONE;
-	s->work_thread = rws_thread_create(&rws_socket_work_th_func, s);
-	if (s->work_thread) {
-		s->command = COMMAND_CONNECT_TO_HOST;
-		return rws_true;
+	if (s->command >= COMMAND_END) {
+		rws_socket_close(s);
+		return rws_false;
 	}
-	return rws_false;
+	return rws_true;
 }
 
-void rws_socket_resize_received(rws_socket s, const size_t size) {
-	void * res = NULL;
-	size_t min = 0;
-	if (size == s->received_size) {
-		return;
+unsigned int rws_socket_get_wanted_events_priv(rws_socket s) {
+	unsigned int events = rws_socket_event_none;
+	switch (s->command) {
+		case COMMAND_WAIT_CONNECT:
+		case COMMAND_SEND_HANDSHAKE:
+			events = rws_socket_event_write;
+			break;
+		case COMMAND_DISCONNECT:
+			events = rws_socket_event_read | rws_socket_event_write;
+			break;
+		case COMMAND_WAIT_HANDSHAKE_RESPONCE:
+			events = rws_socket_event_read;
+			break;
+		case COMMAND_IDLE:
+			if (!s->is_recv_paused && !s->recv_throttle.since_ms) {
+				events |= rws_socket_event_read;
+			}
+			// lock only when there is output, throttle can be reset by rate setter
+			if (s->send_frame || rws_proto_is_output_posted(&s->proto)) {
+				rws_mutex_lock(s->send_mutex);
+				if (!s->send_throttle.since_ms) {
+					events |= rws_socket_event_write;
+				}
+				rws_mutex_unlock(s->send_mutex);
+			}
+			break;
+		default: break;
 	}
+	return events;
+}
 
-	res = rws_malloc(size);
-	assert(res && (size > 0));
-
-	min = (s->received_size < size) ? s->received_size : size;
-	if (min > 0 && s->received) {
-		memcpy(res, s->received, min);
+unsigned int rws_socket_get_timeout_priv(rws_socket s) {
+	const unsigned long long now = rws_time_ms();
+	unsigned long long deadline = 0;
+	unsigned int timeout = RWS_PING_INTERVAL;
+	switch (s->command) {
+		case COMMAND_CONNECT_TO_HOST:
+			timeout = (s->connect_retry_ms > now) ? (unsigned int)(s->connect_retry_ms - now) : 0;
+			break;
+		case COMMAND_IDLE:
+			if (s->is_recv_paused || s->recv_throttle.since_ms || s->send_throttle.since_ms) {
+				timeout = RWS_WORK_STEP_DELAY;
+			} else {
+				timeout = (s->next_ping_ms > now) ? (unsigned int)(s->next_ping_ms - now) : 0;
+			}
+			break;
+		case COMMAND_DISCONNECT:
+			timeout = (s->close_deadline_ms > now) ? (unsigned int)(s->close_deadline_ms - now) : 0;
+			break;
+		default: break;
+	}
+	if (s->on_request_id) { // earliest request timeout
+		rws_mutex_lock(s->send_mutex);
+		deadline = rws_requests_next_deadline(&s->requests);
+		rws_mutex_unlock(s->send_mutex);
+		if (deadline && deadline < now + timeout) {
+			timeout = (deadline > now) ? (unsigned int)(deadline - now) : 0;
+		}
 	}
-	rws_free_clean(&s->received);
-	s->received = res;
-	s->received_size = size;
+	return timeout;
 }
 
-void rws_socket_close(rws_socket s) {
-    s->received_len = 0;
-	if (s->socket != RWS_INVALID_SOCKET) {
-		RWS_SOCK_CLOSE(s->socket);
-		s->socket = RWS_INVALID_SOCKET;
-#if defined(RWS_OS_WINDOWS)
-		WSACleanup();
-#endif
+static void rws_socket_work_th_func(void * user_object) {
+	rws_socket s = (rws_socket)user_object;
+	while (rws_socket_work_step(s)) {
+		rws_thread_sleep(RWS_WORK_STEP_DELAY);
 	}
-	s->is_connected = rws_false;
+
+	rws_socket_close(s);
+	rws_socket_delete(s); // 'is_work_thread' stays set, so late release only posts to mailbox
 }
 
-void rws_socket_append_recvd_frames(rws_socket s, _rws_frame * frame) {
-	_rws_node_value frame_list_var;
-	frame_list_var.object = frame;
-	if (s->recvd_frames) {
-		rws_list_append(s->recvd_frames, frame_list_var);
-	} else {
-		s->recvd_frames = rws_list_create();
-		s->recvd_frames->value = frame_list_var;
+rws_bool rws_socket_create_start_work_thread(rws_socket s) {
+	char name[16];
+	rws_error_delete_clean(&s->error);
+	s->command = COMMAND_CONNECT_TO_HOST; // before start, then state is owned by the work thread
+	memset(name, 0, sizeof(name));
+	memcpy(name, "rws-", 4);
+	if (rws_socket_get_connect_host(s)) {
+		strncpy(name + 4, rws_socket_get_connect_host(s), sizeof(name) - 5);
+	}
+	s->is_work_thread = rws_true; // thread can finish and delete socket before create returns
+	if (rws_thread_create_with_attr(&rws_socket_work_th_func, s,
+									s->is_thread_attr ? &s->thread_attr : NULL,
+									name)) {
+		return rws_true;
 	}
+	s->is_work_thread = rws_false;
+	s->command = COMMAND_NONE;
+	return rws_false;
 }
 
-void rws_socket_append_send_frames(rws_socket s, _rws_frame * frame) {
-	_rws_node_value frame_list_var;
-	frame_list_var.object = frame;
-	if (s->send_frames) {
-		rws_list_append(s->send_frames, frame_list_var);
-	} else {
-		s->send_frames = rws_list_create();
-		s->send_frames->value = frame_list_var;
+void rws_socket_resize_recvd_batch(rws_socket s, const size_t size) {
+	rws_message * batch = (rws_message *)rws_malloc_zero(size * sizeof(rws_message));
+	if (s->recvd_batch_size) {
+		memcpy(batch, s->recvd_batch, s->recvd_batch_size * sizeof(rws_message));
 	}
+	rws_free(s->recvd_batch);
+	s->recvd_batch = batch;
+	s->recvd_batch_size = size;
 }
 
-rws_bool rws_socket_send_text_priv(rws_socket s, const char * text) {
-	size_t len = text ? strlen(text) : 0;
-	_rws_frame * frame = NULL;
+void rws_socket_close(rws_socket s) {
+	s->proto.received_len = 0;
+	s->transport.close(s->transport.context);
+	rws_mutex_lock(s->send_mutex);
+	s->is_connected = rws_false;
+	rws_mutex_unlock(s->send_mutex);
+}
 
-	if (len <= 0) {
+rws_bool rws_socket_send_text_priv(rws_socket s, const char * text) {
+	if (!text) {
 		return rws_false;
 	}
-
-	frame = rws_frame_create();
-	frame->is_masked = rws_true;
-	frame->opcode = rws_opcode_text_frame;
-	rws_frame_fill_with_send_data(frame, text, len);
-	rws_socket_append_send_frames(s, frame);
-
-	return rws_true;
+	return rws_proto_send_message(&s->proto, rws_opcode_text_frame, text, strlen(text));
 }
 
 rws_bool rws_socket_send_bin_priv(_rws_socket * s, void* dataPtr, size_t dataSize) 
 {
-	_rws_frame * frame = NULL;
-
-	if (dataSize <= 0) {
-		return rws_false;
-	}
-
-	frame = rws_frame_create();
-	frame->is_masked = rws_true;
-	frame->opcode = rws_opcode_binary_frame;
-	rws_frame_fill_with_send_data(frame, dataPtr, dataSize);
-	rws_socket_append_send_frames(s, frame);
-
-	return rws_true;
+	return rws_proto_send_message(&s->proto, rws_opcode_binary_frame, dataPtr, dataSize);
 }
 
-void rws_socket_delete_all_frames_in_list(_rws_list * list_with_frames) {
-	_rws_frame * frame = NULL;
-	_rws_node * cur = list_with_frames;
-	while (cur) {
-		frame = (_rws_frame *)cur->value.object;
-		if (frame) {
-			rws_frame_delete(frame);
-		}
-		cur->value.object = NULL;
-	}
+void rws_socket_set_transport(rws_socket s, const _rws_transport * transport) {
+	s->transport = *transport;
 }
 
 void rws_socket_set_option(rws_socket_t s, int option, int value) {
@@ -27,8 +27,12 @@
 #include "rws_string.h"
 #include <assert.h>
 
-#if !defined(RWS_OS_WINDOWS)
+#if defined(RWS_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <pthread.h>
 #include <signal.h>
+#include <sys/stat.h>
 #endif
 
 // public
@@ -40,48 +44,73 @@ rws_bool rws_socket_connect(rws_socket socket) {
 
 	rws_error_delete_clean(&socket->error);
 
-	if (socket->port <= 0) {
+	if (socket->endpoints) {
+		socket->endpoints_tried = 0;
+		if (!rws_socket_select_endpoint(socket)) {
+			socket->error = rws_error_new_code_descr(rws_error_code_missed_parameter, "No endpoints provided");
+			return rws_false;
+		}
+	}
+	socket->connect_start_us = rws_time_us();
+
+	if (rws_socket_get_connect_port(socket) <= 0 && !rws_socket_is_unix(socket)) {
 		params_error_msg = "No URL port provided";
 	}
-	if (!socket->scheme) {
+	if (!rws_socket_get_connect_scheme(socket)) {
 		params_error_msg = "No URL scheme provided";
 	}
-	if (!socket->host) {
+	if (!rws_socket_get_connect_host(socket)) {
 		params_error_msg = "No URL host provided";
 	}
-	if (!socket->path) {
+	if (!rws_socket_get_connect_path(socket)) {
 		params_error_msg = "No URL path provided";
 	}
 	if (!socket->on_disconnected) {
 		params_error_msg = "No on_disconnected callback provided";
 	}
-    socket->received_len = 0;
 	if (params_error_msg) {
 		socket->error = rws_error_new_code_descr(rws_error_code_missed_parameter, params_error_msg);
 		return rws_false;
 	}
+	if (socket->is_external_loop) {
+		socket->command = COMMAND_CONNECT_TO_HOST;
+		rws_socket_work_step(socket);
+		return rws_true;
+	}
 	return rws_socket_create_start_work_thread(socket);
 }
 
 void rws_socket_disconnect_and_release(rws_socket socket) {
+	rws_socket_disconnect_with_code_and_release(socket, 1000, NULL);
+}
+
+void rws_socket_disconnect_with_code_and_release(rws_socket socket, const unsigned short code, const char * reason) {
 	if (!socket) {
 		return;
 	}
 	
-	rws_mutex_lock(socket->work_mutex);
+	if (!rws_atomic_cas(&socket->is_released, 0, 1)) {
+		return; // already released, e.g. before 'rws_shutdown_all'
+	}
 
-	rws_socket_delete_all_frames_in_list(socket->send_frames);
-	rws_list_delete_clean(&socket->send_frames);
+	// published to the work thread by the mailbox
+	socket->close_code = code;
+	rws_string_delete(socket->close_reason);
+	socket->close_reason = rws_string_copy(reason);
 
-	if (socket->is_connected) { // connected in loop
-		socket->command = COMMAND_DISCONNECT;
-		rws_mutex_unlock(socket->work_mutex);
-	} else if (socket->work_thread) { // disconnected in loop
-		socket->command = COMMAND_END;
-		rws_mutex_unlock(socket->work_mutex);
+	if (socket->is_external_loop) { // no loop thread, disconnect in place
+		rws_socket_flush_partial_send_frame(socket);
+		rws_mutex_lock(socket->send_mutex);
+		rws_proto_delete_send_frames(&socket->proto);
+		rws_mutex_unlock(socket->send_mutex);
+		if (socket->is_connected) {
+			rws_socket_send_disconnect(socket);
+		}
+		rws_socket_delete(socket);
+	} else if (socket->is_work_thread) { // closing handshake if connected, pending frames are sent before close
+		rws_socket_post(socket, RWS_MAILBOX_RELEASE);
 	} else if (socket->command != COMMAND_END) {
 		// not in loop
-		rws_mutex_unlock(socket->work_mutex);
 		rws_socket_delete(socket);
 	}
 }
@@ -108,6 +137,32 @@ rws_bool rws_socket_send_binary(rws_socket socket, void* dataPtr, size_t dataSiz
 	return r;
 }
 
+rws_bool rws_socket_send_file(rws_socket socket, int fd, unsigned long long offset, unsigned long long size) {
+#if defined(RWS_OS_WINDOWS)
+	(void)socket;
+	(void)fd;
+	(void)offset;
+	(void)size;
+	return rws_false;
+#else
+	struct stat st;
+	int file_fd = -1;
+	rws_bool r = rws_false;
+	if (!socket || fd < 0 || !size || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+		offset > (unsigned long long)st.st_size || size > (unsigned long long)st.st_size - offset) {
+		return rws_false;
+	}
+	file_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0); // caller can close its descriptor
+	if (file_fd < 0) {
+		return rws_false;
+	}
+	rws_mutex_lock(socket->send_mutex);
+	r = rws_proto_send_file(&socket->proto, file_fd, offset, size);
+	rws_mutex_unlock(socket->send_mutex);
+	return r;
+#endif
+}
+
 #if !defined(RWS_OS_WINDOWS)
 void rws_socket_handle_sigpipe(int signal_number) {
 	printf("\nlibrws handle sigpipe %i", signal_number);
@@ -124,8 +179,116 @@ void rws_socket_check_info(const char * info) {
 	(void)info;
 }
 
+// all not deleted sockets
+static rws_socket _sockets = NULL;
+static rws_mutex _sockets_mutex = NULL;
+
+// registry mutex is created once, first sockets can be created by several threads
+#if defined(RWS_OS_WINDOWS)
+static INIT_ONCE _sockets_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK rws_sockets_init(PINIT_ONCE once, PVOID parameter, PVOID * context) {
+	_sockets_mutex = rws_mutex_create_recursive();
+	return TRUE;
+}
+#else
+static pthread_once_t _sockets_once = PTHREAD_ONCE_INIT;
+
+static void rws_sockets_init(void) {
+	_sockets_mutex = rws_mutex_create_recursive();
+}
+#endif
+
+static rws_mutex rws_sockets_mutex(void) {
+#if defined(RWS_OS_WINDOWS)
+	InitOnceExecuteOnce(&_sockets_once, &rws_sockets_init, NULL, NULL);
+#else
+	pthread_once(&_sockets_once, &rws_sockets_init);
+#endif
+	return _sockets_mutex;
+}
+
+static void rws_sockets_register(rws_socket s) {
+	rws_mutex_lock(rws_sockets_mutex());
+	s->registry_prev = NULL;
+	s->registry_next = _sockets;
+	if (_sockets) {
+		_sockets->registry_prev = s;
+	}
+	_sockets = s;
+	s->is_registered = rws_true;
+	rws_mutex_unlock(_sockets_mutex);
+}
+
+// locked
+static void rws_sockets_unlink(rws_socket s) {
+	if (s->is_registered) {
+		if (s->registry_prev) {
+			s->registry_prev->registry_next = s->registry_next;
+		} else {
+			_sockets = s->registry_next;
+		}
+		if (s->registry_next) {
+			s->registry_next->registry_prev = s->registry_prev;
+		}
+		s->registry_prev = NULL;
+		s->registry_next = NULL;
+		s->is_registered = rws_false;
+	}
+}
+
+void rws_sockets_unregister(rws_socket s) {
+	rws_mutex_lock(rws_sockets_mutex());
+	rws_sockets_unlink(s);
+	rws_mutex_unlock(_sockets_mutex);
+}
+
+rws_bool rws_shutdown_all(const unsigned int timeout_ms) {
+	const unsigned long long deadline = rws_time_ms() + timeout_ms;
+	rws_socket s = NULL, next = NULL, not_started = NULL;
+	rws_bool is_done = rws_false;
+	rws_mutex mutex = rws_sockets_mutex();
+
+	// sockets are deleted after unregistering, so they stay valid while locked,
+	// nothing is deleted under the lock: deleting locks pool, which creates sockets under its lock
+	rws_mutex_lock(mutex);
+	for (s = _sockets; s; s = next) {
+		next = s->registry_next;
+		if (s->is_external_loop) {
+			// can be in the loop of the owner thread, closed by that loop and released by owner
+			rws_socket_post(s, RWS_MAILBOX_RELEASE);
+		} else if (s->is_work_thread) {
+			// work threads are signaled and close in parallel
+			rws_socket_disconnect_and_release(s);
+		} else if (rws_atomic_cas(&s->is_released, 0, 1)) {
+			// not connected yet, taken from registry and deleted after unlock
+			rws_sockets_unlink(s);
+			s->registry_next = not_started;
+			not_started = s;
+		}
+	}
+	rws_mutex_unlock(mutex);
+
+	for (s = not_started; s; s = next) {
+		next = s->registry_next;
+		s->registry_next = NULL;
+		rws_socket_delete(s);
+	}
+
+	while (!is_done) {
+		rws_mutex_lock(mutex);
+		is_done = _sockets ? rws_false : rws_true;
+		rws_mutex_unlock(mutex);
+		if (is_done || rws_time_ms() >= deadline) {
+			break;
+		}
+		rws_thread_sleep(1);
+	}
+	return is_done;
+}
+
 rws_socket rws_socket_create(void) {
-	rws_socket s = (rws_socket)rws_malloc_zero(sizeof(struct rws_socket_struct));
+	rws_socket s = (rws_socket)rws_malloc_zero_aligned(sizeof(struct rws_socket_struct), RWS_CACHE_LINE_SIZE);
 	if (!s) {
 		return NULL;
 	}
@@ -137,10 +300,16 @@ rws_socket rws_socket_create(void) {
 	s->port = -1;
 	s->socket = RWS_INVALID_SOCKET;
 	s->command = COMMAND_NONE;
+	s->close_code = 1000;
+	s->endpoint = -1;
+	rws_proto_init(&s->proto);
+	rws_requests_init(&s->requests);
+	rws_transport_init_tcp(&s->transport, s);
 
-	s->work_mutex = rws_mutex_create_recursive();
 	s->send_mutex = rws_mutex_create_recursive();
 
+	rws_sockets_register(s);
+
 	static const char * info = "librws ver: " TO_STRING(RWS_VERSION_MAJOR) "." TO_STRING(RWS_VERSION_MINOR) "." TO_STRING(RWS_VERSION_PATCH) "\n";
 	rws_socket_check_info(info);
 
@@ -149,36 +318,45 @@ rws_socket rws_socket_create(void) {
 
 void rws_socket_delete(rws_socket s) {
 	rws_socket_close(s);
+	rws_socket_connect_finish(s);
+	rws_sockets_unregister(s); // waits 'rws_shutdown_all' release, transport is not used after
+	if (s->pool) {
+		rws_pool_socket_deleted(s->pool, s);
+	}
+	if (s->shared_limit) {
+		rws_rate_limit_release(s->shared_limit);
+		s->shared_limit = NULL;
+	}
+	if (s->endpoints) {
+		rws_endpoints_release(s->endpoints);
+		s->endpoints = NULL;
+	}
+	rws_executor_clean_queue(s->executor, &s->recvd_queue);
+	if (s->on_request_id) {
+		rws_socket_complete_requests(s, rws_reply_status_disconnected);
+	}
+	rws_requests_clean(&s->requests);
 
-	rws_string_delete_clean(&s->sec_ws_accept);
-
-	rws_free_clean(&s->received);
-	s->received_size = 0;
-	s->received_len = 0;
-
-	rws_socket_delete_all_frames_in_list(s->send_frames);
-	rws_list_delete_clean(&s->send_frames);
-	rws_socket_delete_all_frames_in_list(s->recvd_frames);
-	rws_list_delete_clean(&s->recvd_frames);
+	rws_proto_clean(&s->proto);
+	rws_frame_delete_clean(&s->send_frame);
 
 	rws_string_delete_clean(&s->scheme);
 	rws_string_delete_clean(&s->host);
 	rws_string_delete_clean(&s->path);
-
-	rws_string_delete_clean(&s->sec_ws_accept);
+	rws_string_delete_clean(&s->close_reason);
 
 	rws_error_delete_clean(&s->error);
 
-	rws_free_clean(&s->received);
-	rws_socket_delete_all_frames_in_list(s->send_frames);
-	rws_list_delete_clean(&s->send_frames);
-	rws_socket_delete_all_frames_in_list(s->recvd_frames);
-	rws_list_delete_clean(&s->recvd_frames);
+	rws_ring_delete_clean(&s->recvd_ring);
+	rws_free(s->recvd_batch);
+
+	if (s->on_deleted) {
+		s->on_deleted(s);
+	}
 
-	rws_mutex_delete(s->work_mutex);
 	rws_mutex_delete(s->send_mutex);
 
-	rws_free(s);
+	rws_free_aligned(s);
 }
 
 void rws_socket_set_url(rws_socket socket,
@@ -197,6 +375,7 @@ void rws_socket_set_url(rws_socket socket,
 		socket->path = rws_string_copy(path);
 		
 		socket->port = port;
+		socket->proto.handshake_len = 0;
 	}
 }
 
@@ -204,6 +383,7 @@ void rws_socket_set_scheme(rws_socket socket, const char * scheme) {
 	if (socket) {
 		rws_string_delete(socket->scheme);
 		socket->scheme = rws_string_copy(scheme);
+		socket->proto.handshake_len = 0;
 	}
 }
 
@@ -215,6 +395,7 @@ void rws_socket_set_host(rws_socket socket, const char * host) {
 	if (socket) {
 		rws_string_delete(socket->host);
 		socket->host = rws_string_copy(host);
+		socket->proto.handshake_len = 0;
 	}
 }
 
@@ -226,6 +407,7 @@ void rws_socket_set_path(rws_socket socket, const char * path) {
 	if (socket) {
 		rws_string_delete(socket->path);
 		socket->path = rws_string_copy(path);
+		socket->proto.handshake_len = 0;
 	}
 }
 
@@ -236,6 +418,7 @@ const char * rws_socket_get_path(rws_socket socket) {
 void rws_socket_set_port(rws_socket socket, const int port) {
 	if (socket) {
 		socket->port = port;
+		socket->proto.handshake_len = 0;
 	}
 }
 
@@ -310,6 +493,300 @@ void rws_socket_set_on_received_bin(rws_socket socket, rws_on_socket_recvd_bin c
 	}
 }
 
+void rws_socket_set_on_received_batch(rws_socket socket, rws_on_socket_recvd_batch callback) {
+	if (socket) {
+		socket->on_recvd_batch = callback;
+	}
+}
+
+void rws_socket_set_on_received_message(rws_socket socket, rws_on_socket_recvd_message callback) {
+	if (socket) {
+		socket->on_recvd_message = callback;
+	}
+}
+
+void rws_socket_set_on_deleted(rws_socket socket, rws_on_socket callback) {
+	if (socket) {
+		socket->on_deleted = callback;
+	}
+}
+
+void rws_socket_set_external_loop(rws_socket socket, const rws_bool is_external) {
+	if (socket) {
+		socket->is_external_loop = is_external;
+	}
+}
+
+rws_fd rws_socket_get_fd(rws_socket socket) {
+	if (socket && socket->socket != RWS_INVALID_SOCKET) {
+		return (rws_fd)socket->socket;
+	}
+	return RWS_INVALID_FD;
+}
+
+unsigned int rws_socket_get_wanted_events(rws_socket socket) {
+	return socket ? rws_socket_get_wanted_events_priv(socket) : rws_socket_event_none;
+}
+
+unsigned int rws_socket_get_timeout(rws_socket socket) {
+	return socket ? rws_socket_get_timeout_priv(socket) : 0;
+}
+
+rws_bool rws_socket_on_readable(rws_socket socket) {
+	return socket ? rws_socket_work_step(socket) : rws_false;
+}
+
+rws_bool rws_socket_on_writable(rws_socket socket) {
+	return socket ? rws_socket_work_step(socket) : rws_false;
+}
+
+rws_bool rws_socket_on_timer(rws_socket socket) {
+	return socket ? rws_socket_work_step(socket) : rws_false;
+}
+
+void rws_socket_set_poll_mode(rws_socket socket, const unsigned int capacity) {
+	if (socket) {
+		rws_ring_delete_clean(&socket->recvd_ring);
+		if (capacity > 0) {
+			socket->recvd_ring = rws_ring_create(capacity);
+		}
+	}
+}
+
+unsigned int rws_socket_poll_messages(rws_socket socket, rws_message * messages, const unsigned int max_count) {
+	if (socket && socket->recvd_ring && messages) {
+		return (unsigned int)rws_ring_pop(socket->recvd_ring, messages, max_count);
+	}
+	return 0;
+}
+
+void rws_socket_set_send_rate_limit(rws_socket socket,
+									const unsigned int messages_per_sec,
+									const unsigned int bytes_per_sec) {
+	if (socket) {
+		rws_mutex_lock(socket->send_mutex);
+		rws_bucket_set_rate(&socket->send_msgs_bucket, messages_per_sec);
+		rws_bucket_set_rate(&socket->send_bytes_bucket, bytes_per_sec);
+		rws_throttle_update(&socket->send_throttle, rws_false, rws_time_ms());
+		rws_mutex_unlock(socket->send_mutex);
+	}
+}
+
+void rws_socket_set_recv_rate_limit(rws_socket socket, const unsigned int bytes_per_sec) {
+	if (socket) {
+		rws_atomic_store(&socket->recv_rate_request, bytes_per_sec);
+		if (socket->is_work_thread) {
+			rws_socket_post(socket, RWS_MAILBOX_RECV_RATE);
+		} else { // not started or external loop, bucket is used by the calling thread
+			rws_bucket_set_rate(&socket->recv_bytes_bucket, bytes_per_sec);
+			rws_throttle_update(&socket->recv_throttle, rws_false, rws_time_ms());
+			rws_atomic_store(&socket->recv_throttled_ms, (size_t)socket->recv_throttle.total_ms);
+		}
+	}
+}
+
+unsigned int rws_socket_get_send_throttled_time(rws_socket socket) {
+	unsigned int r = 0;
+	if (socket) {
+		rws_mutex_lock(socket->send_mutex);
+		r = (unsigned int)rws_throttle_get_total(&socket->send_throttle, rws_time_ms());
+		rws_mutex_unlock(socket->send_mutex);
+	}
+	return r;
+}
+
+unsigned int rws_socket_get_recv_throttled_time(rws_socket socket) {
+	return socket ? (unsigned int)rws_atomic_load(&socket->recv_throttled_ms) : 0;
+}
+
+void rws_socket_set_shared_rate_limit(rws_socket socket, rws_rate_limit limit) {
+	if (socket) {
+		if (limit) {
+			rws_rate_limit_retain(limit);
+		}
+		if (socket->shared_limit) {
+			rws_rate_limit_release(socket->shared_limit);
+		}
+		socket->shared_limit = limit;
+	}
+}
+
+void rws_socket_set_executor(rws_socket socket, rws_executor executor) {
+	if (socket) {
+		socket->executor = executor;
+		socket->recvd_queue.socket = socket;
+	}
+}
+
+void rws_socket_set_thread_attr(rws_socket socket, const rws_thread_attr * attr) {
+	if (socket) {
+		socket->is_thread_attr = attr ? rws_true : rws_false;
+		if (attr) {
+			socket->thread_attr = *attr;
+		}
+	}
+}
+
+void rws_socket_set_on_slow_callback(rws_socket socket,
+									 rws_on_socket_slow_callback hook,
+									 const unsigned int threshold_us) {
+	if (socket) {
+		socket->on_slow_callback = hook;
+		socket->slow_callback_threshold_us = threshold_us;
+	}
+}
+
+unsigned int rws_socket_get_loop_histogram(rws_socket socket, unsigned int * counts, const unsigned int size) {
+	const unsigned int count = (size < RWS_LOOP_HISTOGRAM_SIZE) ? size : RWS_LOOP_HISTOGRAM_SIZE;
+	unsigned int i = 0;
+	if (!socket || !counts) {
+		return 0;
+	}
+	for (i = 0; i < count; i++) {
+		counts[i] = (unsigned int)rws_atomic_load(&socket->loop_histogram[i]);
+	}
+	return count;
+}
+
+void rws_socket_set_utf8_validation(rws_socket socket, const rws_bool is_enabled) {
+	if (socket) {
+		socket->proto.is_utf8_validation = is_enabled;
+	}
+}
+
+void rws_socket_set_endpoints(rws_socket socket, rws_endpoints endpoints) {
+	if (socket) {
+		if (endpoints) {
+			rws_endpoints_retain(endpoints);
+		}
+		if (socket->endpoints) {
+			rws_endpoints_release(socket->endpoints);
+		}
+		socket->endpoints = endpoints;
+		socket->endpoint = -1;
+		socket->endpoint_url = NULL;
+	}
+}
+
+int rws_socket_get_endpoint(rws_socket socket) {
+	return socket ? socket->endpoint : -1;
+}
+
+rws_bool rws_socket_add_header(rws_socket socket, const char * name, const char * value) {
+	return socket ? rws_proto_add_header(&socket->proto, name, value) : rws_false;
+}
+
+rws_bool rws_socket_add_protocol(rws_socket socket, const char * protocol) {
+	return socket ? rws_proto_add_protocol(&socket->proto, protocol) : rws_false;
+}
+
+const char * rws_socket_get_protocol(rws_socket socket) {
+	return socket ? socket->proto.protocol : NULL;
+}
+
+void rws_socket_set_recv_spill(rws_socket socket, const size_t threshold, const char * directory) {
+	if (socket) {
+		socket->proto.spill_threshold = threshold;
+		rws_string_delete(socket->proto.spill_directory);
+		socket->proto.spill_directory = rws_string_copy(directory);
+	}
+}
+
+void rws_socket_set_send_spill(rws_socket socket, const size_t threshold, const char * directory) {
+	if (socket) {
+		rws_mutex_lock(socket->send_mutex);
+		socket->proto.send_spill_threshold = threshold;
+		rws_string_delete(socket->proto.send_spill_directory);
+		socket->proto.send_spill_directory = rws_string_copy(directory);
+		rws_mutex_unlock(socket->send_mutex);
+	}
+}
+
+size_t rws_socket_get_send_spilled(rws_socket socket) {
+	size_t r = 0;
+	if (socket) {
+		rws_mutex_lock(socket->send_mutex);
+		r = socket->proto.send_spill ? socket->proto.send_spill->len - socket->proto.send_spill_offset : 0;
+		rws_mutex_unlock(socket->send_mutex);
+	}
+	return r;
+}
+
+void rws_socket_set_on_request_id(rws_socket socket, rws_on_socket_request_id callback) {
+	if (socket) {
+		socket->on_request_id = callback;
+	}
+}
+
+rws_bool rws_socket_request(rws_socket socket, const void * data, const size_t data_size, const rws_bool is_text,
+							const unsigned int timeout_ms, rws_on_socket_reply on_reply, void * user_data) {
+	rws_message message;
+	unsigned long long id = 0;
+	rws_bool r = rws_false;
+	if (!socket || !socket->on_request_id || !on_reply || !data || !data_size) {
+		return rws_false;
+	}
+	message.data = data;
+	message.data_size = data_size;
+	message.is_text = is_text;
+	message.priv = NULL;
+	if (!socket->on_request_id(socket, &message, &id)) {
+		return rws_false;
+	}
+	rws_mutex_lock(socket->send_mutex);
+	// added before sending, so reply can't be received before
+	if (rws_requests_add(&socket->requests, id, timeout_ms ? rws_time_ms() + timeout_ms : 0, on_reply, user_data)) {
+		r = rws_proto_send_message(&socket->proto, is_text ? rws_opcode_text_frame : rws_opcode_binary_frame, data, data_size);
+		if (!r) {
+			_rws_request request;
+			rws_requests_take(&socket->requests, id, &request);
+		}
+	}
+	rws_mutex_unlock(socket->send_mutex);
+	return r;
+}
+
+rws_bool rws_message_alloc(rws_message * message, const size_t data_size, const rws_bool is_text) {
+	_rws_frame * frame = NULL;
+	if (!message || !data_size) {
+		return rws_false;
+	}
+	frame = rws_frame_create_for_send(is_text ? rws_opcode_text_frame : rws_opcode_binary_frame, data_size);
+	rws_frame_to_message(frame, message);
+	return rws_true;
+}
+
+rws_bool rws_socket_send_message(rws_socket socket, rws_message * message) {
+	_rws_frame * frame = message ? (_rws_frame *)message->priv : NULL;
+	rws_bool r = rws_false;
+	if (!frame) {
+		return rws_false;
+	}
+	memset(message, 0, sizeof(rws_message));
+	if (!socket || !frame->buffer || frame->data != (unsigned char *)frame->buffer + RWS_FRAME_MAX_HEADER_SIZE) {
+		rws_frame_delete(frame); // not allocated for sending or already sent
+		return rws_false;
+	}
+	rws_mutex_lock(socket->send_mutex);
+	r = rws_proto_send_frame(&socket->proto, frame);
+	rws_mutex_unlock(socket->send_mutex);
+	return r;
+}
+
+unsigned int rws_socket_get_requests_count(rws_socket socket) {
+	unsigned int r = 0;
+	if (socket) {
+		rws_mutex_lock(socket->send_mutex);
+		r = (unsigned int)socket->requests.count;
+		rws_mutex_unlock(socket->send_mutex);
+	}
+	return r;
+}
+
+unsigned short rws_socket_get_close_code(rws_socket socket) {
+	return socket ? (unsigned short)rws_atomic_load(&socket->recvd_close_code) : 0;
+}
+
 rws_bool rws_socket_is_connected(rws_socket socket) {
 	rws_bool r = rws_false;
 	if (socket) {
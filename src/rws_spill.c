@@ -0,0 +1,176 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1 // memfd_create, mremap
+#endif
+
+#include "rws_spill.h"
+#include "rws_memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(RWS_OS_WINDOWS)
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// file grows by this granularity
+#define RWS_SPILL_GRANULARITY (1024 * 1024)
+
+#if !defined(RWS_OS_WINDOWS)
+
+static size_t rws_spill_round_size(const size_t size) {
+	return ((size / RWS_SPILL_GRANULARITY) + 1) * RWS_SPILL_GRANULARITY;
+}
+
+const char * rws_spill_temp_directory(void) {
+	const char * dir = getenv("TMPDIR");
+	return (dir && *dir) ? dir : "/tmp";
+}
+
+static int rws_spill_open(const char * directory) {
+	const char * dir = directory;
+	char * path = NULL;
+	size_t len = 0;
+	int fd = -1;
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+	if (!dir) {
+		fd = memfd_create("librws-spill", MFD_CLOEXEC);
+		if (fd >= 0) {
+			return fd;
+		}
+	}
+#endif
+	if (!dir) {
+		dir = rws_spill_temp_directory();
+	}
+	len = strlen(dir);
+	path = (char *)rws_malloc(len + 32);
+	memcpy(path, dir, len);
+	memcpy(path + len, "/librws-spill-XXXXXX", 21);
+	fd = mkstemp(path);
+	if (fd >= 0) {
+		unlink(path); // removed by system when closed
+	}
+	rws_free(path);
+	return fd;
+}
+
+_rws_spill * rws_spill_create(const char * directory, const size_t size) {
+	_rws_spill * spill = NULL;
+	const size_t map_size = rws_spill_round_size(size);
+	void * map = MAP_FAILED;
+	const int fd = rws_spill_open(directory);
+	if (fd < 0) {
+		return NULL;
+	}
+	if (ftruncate(fd, (off_t)map_size) == 0) {
+		map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	if (map == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+	spill = (_rws_spill *)rws_malloc_zero(sizeof(_rws_spill));
+	spill->fd = fd;
+	spill->map = map;
+	spill->map_size = map_size;
+	return spill;
+}
+
+void * rws_spill_reserve(_rws_spill * spill, const size_t size) {
+	size_t map_size = spill->map_size;
+	void * map = MAP_FAILED;
+	if (spill->len + size <= spill->map_size) {
+		return (char *)spill->map + spill->len;
+	}
+	while (map_size < spill->len + size) {
+		map_size *= 2;
+	}
+	if (ftruncate(spill->fd, (off_t)map_size) != 0) {
+		return NULL;
+	}
+#if defined(__linux__)
+	map = mremap(spill->map, spill->map_size, map_size, MREMAP_MAYMOVE);
+#else
+	map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, spill->fd, 0); // written data is in file
+	if (map != MAP_FAILED) {
+		munmap(spill->map, spill->map_size);
+	}
+#endif
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+	spill->map = map;
+	spill->map_size = map_size;
+	return (char *)spill->map + spill->len;
+}
+
+void rws_spill_compact(_rws_spill * spill, const size_t offset) {
+	if (offset && offset <= spill->len) {
+		memmove(spill->map, (char *)spill->map + offset, spill->len - offset);
+		spill->len -= offset;
+	}
+}
+
+void rws_spill_delete(_rws_spill * spill) {
+	if (spill) {
+		munmap(spill->map, spill->map_size);
+		close(spill->fd);
+		rws_free(spill);
+	}
+}
+
+#else
+
+const char * rws_spill_temp_directory(void) {
+	return NULL;
+}
+
+_rws_spill * rws_spill_create(const char * directory, const size_t size) {
+	(void)directory;
+	(void)size;
+	return NULL; // messages stay in heap
+}
+
+void * rws_spill_reserve(_rws_spill * spill, const size_t size) {
+	(void)spill;
+	(void)size;
+	return NULL;
+}
+
+void rws_spill_compact(_rws_spill * spill, const size_t offset) {
+	(void)spill;
+	(void)offset;
+}
+
+void rws_spill_delete(_rws_spill * spill) {
+	(void)spill;
+}
+
+#endif
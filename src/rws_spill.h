@@ -0,0 +1,53 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#ifndef __RWS_SPILL_H__
+#define __RWS_SPILL_H__ 1
+
+#include "rws_common.h"
+
+// message data in the memory mapped temporary file, pages are written back by kernel under memory pressure
+typedef struct _rws_spill_struct {
+	int fd;
+	void * map;
+	size_t map_size; // mapped and file size
+	size_t len; // written bytes
+} _rws_spill;
+
+// TMPDIR or "/tmp"
+const char * rws_spill_temp_directory(void);
+
+// directory - place of the temporary file, null - anonymous memory file if supported, otherwise TMPDIR.
+// Returns null if files can't be mapped.
+_rws_spill * rws_spill_create(const char * directory, const size_t size);
+
+// place for 'size' bytes at the end of the written data, null - file can't grow
+void * rws_spill_reserve(_rws_spill * spill, const size_t size);
+
+// remove first 'offset' written bytes, rest is moved to the start of the file
+void rws_spill_compact(_rws_spill * spill, const size_t offset);
+
+// unmap and close file
+void rws_spill_delete(_rws_spill * spill);
+
+#endif
@@ -21,81 +21,77 @@
  */
 
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1 // cpu affinity
+#endif
+
 #include "../librws.h"
 #include "rws_thread.h"
 #include "rws_memory.h"
 #include "rws_common.h"
 
 #include <assert.h>
+#include <string.h>
 
 #if defined(RWS_OS_WINDOWS)
 #include <windows.h>
 #else
 #include <pthread.h>
+#include <sched.h>
+#include <limits.h>
 #include <unistd.h>
+#include <time.h>
+#endif
+
+#if defined(RWS_OS_LINUX) || defined(RWS_OS_ANDROID)
+#include <sys/prctl.h>
+#endif
+
+#if defined(RWS_OS_APPLE)
+#include <mach/mach_time.h>
 #endif
 
 struct rws_thread_struct {
 	rws_thread_funct thread_function;
 	void * user_object;
-#if defined(RWS_OS_WINDOWS)
-	HANDLE thread;
-#else
-	pthread_t thread;
-#endif
+	rws_thread_attr attr;
+	char name[16];
 };
 
-typedef struct _rws_threads_joiner_struct {
-	rws_thread thread;
-	rws_mutex mutex;
-} _rws_threads_joiner;
+static rws_thread_attr _default_thread_attr = { 0, 0, 0 };
 
-static _rws_threads_joiner * _threads_joiner = NULL;
-static void rws_threads_joiner_clean(void) { // private
-	rws_thread t = _threads_joiner->thread;
-#if defined(RWS_OS_WINDOWS)
-	DWORD dwExitCode = 0;
-#else
-	void * r = NULL;
-#endif
-
-	if (!t) {
-		return;
-	}
-	_threads_joiner->thread = NULL;
+// returned by 'rws_thread_create', detached thread object can be freed before return
+static struct rws_thread_struct _detached_thread;
 
-#if defined(RWS_OS_WINDOWS)
-	do {
-		if (GetExitCodeThread(t->thread, &dwExitCode) == 0) {
-			break; // fail
+// affinity and name are applied by the thread itself
+static void rws_thread_apply_attr(rws_thread t) {
+#if defined(RWS_OS_LINUX) || defined(RWS_OS_ANDROID)
+	cpu_set_t cpus;
+	int cpu = 0;
+	if (t->attr.affinity_mask) {
+		CPU_ZERO(&cpus);
+		for (cpu = 0; cpu < 64; cpu++) {
+			if (t->attr.affinity_mask & (1ULL << cpu)) {
+				CPU_SET(cpu, &cpus);
+			}
 		}
-	} while (dwExitCode == STILL_ACTIVE);
-	if (dwExitCode == STILL_ACTIVE) {
-		TerminateThread(t->thread, 0);
+		sched_setaffinity(0, sizeof(cpu_set_t), &cpus);
 	}
-	if (CloseHandle(t->thread)) {
-		t->thread = NULL;
+	if (t->name[0]) {
+		prctl(PR_SET_NAME, t->name, 0, 0, 0);
 	}
-#else
-	pthread_join(t->thread, &r);
-	assert(r == NULL);
-#endif
-	rws_free(t);
-}
-
-static void rws_threads_joiner_add(rws_thread thread) { // public
-	rws_mutex_lock(_threads_joiner->mutex);
-	rws_threads_joiner_clean();
-	_threads_joiner->thread = thread;
-	rws_mutex_unlock(_threads_joiner->mutex);
-}
-
-static void rws_threads_joiner_create_ifneed(void) {
-	if (_threads_joiner) {
-		return;
+#elif defined(RWS_OS_APPLE)
+	if (t->name[0]) {
+		pthread_setname_np(t->name);
 	}
-	_threads_joiner = (_rws_threads_joiner *)rws_malloc_zero(sizeof(_rws_threads_joiner));
-	_threads_joiner->mutex = rws_mutex_create_recursive();
+#elif defined(RWS_OS_WINDOWS)
+	if (t->attr.affinity_mask) {
+		SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)t->attr.affinity_mask);
+	}
+	if (t->attr.priority > 0) {
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+	}
+#endif
 }
 
 #if defined(RWS_OS_WINDOWS)
@@ -104,8 +100,9 @@ static DWORD WINAPI rws_thread_func_priv(LPVOID some_pointer) {
 static void * rws_thread_func_priv(void * some_pointer) {
 #endif
 	rws_thread t = (rws_thread)some_pointer;
+	rws_thread_apply_attr(t);
 	t->thread_function(t->user_object);
-	rws_threads_joiner_add(t);
+	rws_free(t); // detached, nothing to join
 
 #if  defined(RWS_OS_WINDOWS)
 	return 0;
@@ -114,35 +111,98 @@ static void * rws_thread_func_priv(void * some_pointer) {
 #endif
 }
 
-rws_thread rws_thread_create(rws_thread_funct thread_function, void * user_object) {
-	rws_thread t = NULL;
-	int res = -1;
 #if !defined(RWS_OS_WINDOWS)
+static int rws_thread_start(rws_thread t, const rws_bool is_scheduled) {
 	pthread_attr_t attr;
+	pthread_t thread;
+	struct sched_param param;
+	size_t stack_size = t->attr.stack_size;
+	int res = -1;
+
+	if (pthread_attr_init(&attr) != 0) {
+		return -1;
+	}
+	if (pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM) == 0 &&
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) == 0) {
+		res = 0;
+		if (stack_size) {
+			if (stack_size < (size_t)PTHREAD_STACK_MIN) {
+				stack_size = PTHREAD_STACK_MIN;
+			}
+			res = pthread_attr_setstacksize(&attr, stack_size);
+		}
+		if (res == 0 && is_scheduled) {
+			memset(&param, 0, sizeof(param));
+			param.sched_priority = t->attr.priority;
+			res = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+			if (res == 0) {
+				res = pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+			}
+			if (res == 0) {
+				res = pthread_attr_setschedparam(&attr, &param);
+			}
+		}
+		if (res == 0) {
+			res = pthread_create(&thread, &attr, &rws_thread_func_priv, (void *)t);
+		}
+	}
+	pthread_attr_destroy(&attr);
+	return res;
+}
+#endif
+
+rws_bool rws_thread_create_with_attr(rws_thread_funct thread_function,
+									 void * user_object,
+									 const rws_thread_attr * attr,
+									 const char * name) {
+	rws_thread t = NULL;
+	int res = -1;
+#if defined(RWS_OS_WINDOWS)
+	HANDLE handle = NULL;
 #endif
 
 	if (!thread_function) {
-		return NULL;
+		return rws_false;
 	}
-	rws_threads_joiner_create_ifneed();
 	t = (rws_thread)rws_malloc_zero(sizeof(struct rws_thread_struct));
 	t->user_object = user_object;
 	t->thread_function = thread_function;
+	t->attr = attr ? *attr : _default_thread_attr;
+	if (name) {
+		strncpy(t->name, name, sizeof(t->name) - 1);
+	}
 #if defined(RWS_OS_WINDOWS)
-	t->thread = CreateThread(NULL, 0, &rws_thread_func_priv, (LPVOID)t, 0, NULL);
-	assert(t->thread);
+	handle = CreateThread(NULL, t->attr.stack_size, &rws_thread_func_priv, (LPVOID)t,
+						  t->attr.stack_size ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0, NULL);
+	if (handle) {
+		CloseHandle(handle); // detached
+		res = 0;
+	}
 #else
-	if (pthread_attr_init(&attr) == 0) {
-		if (pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM) == 0) {
-			if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE) == 0) {
-				res = pthread_create(&t->thread, &attr, &rws_thread_func_priv, (void *)t);
-			}
-		}
-		pthread_attr_destroy(&attr);
+	if (t->attr.priority > 0) {
+		res = rws_thread_start(t, rws_true);
+	}
+	if (res != 0) { // no priority or not permitted
+		res = rws_thread_start(t, rws_false);
 	}
-	assert(res == 0);
 #endif
-	return t;
+	if (res != 0) {
+		rws_free(t);
+		return rws_false;
+	}
+	return rws_true; // 't' can be already freed by finished thread
+}
+
+rws_thread rws_thread_create(rws_thread_funct thread_function, void * user_object) {
+	return rws_thread_create_with_attr(thread_function, user_object, NULL, NULL) ? &_detached_thread : NULL;
+}
+
+void rws_thread_set_default_attr(const rws_thread_attr * attr) {
+	if (attr) {
+		_default_thread_attr = *attr;
+	} else {
+		memset(&_default_thread_attr, 0, sizeof(rws_thread_attr));
+	}
 }
 
 void rws_thread_sleep(const unsigned int millisec) {
@@ -153,6 +213,125 @@ void rws_thread_sleep(const unsigned int millisec) {
 #endif
 }
 
+unsigned long long rws_time_ms(void) {
+#if defined(RWS_OS_WINDOWS)
+	return (unsigned long long)GetTickCount64();
+#else
+	return rws_time_us() / 1000;
+#endif
+}
+
+unsigned long long rws_time_us(void) {
+#if defined(RWS_OS_WINDOWS)
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER counter;
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (unsigned long long)((counter.QuadPart / frequency.QuadPart) * 1000000 +
+								((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart);
+#elif defined(RWS_OS_APPLE)
+	static mach_timebase_info_data_t info = { 0, 0 };
+	if (info.denom == 0) {
+		mach_timebase_info(&info);
+	}
+	return ((mach_absolute_time() * info.numer) / info.denom) / 1000;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((unsigned long long)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#endif
+}
+
+size_t rws_atomic_load(volatile size_t * value) {
+#if defined(RWS_OS_WINDOWS)
+	const size_t r = *value;
+	MemoryBarrier();
+	return r;
+#else
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void rws_atomic_store(volatile size_t * value, const size_t new_value) {
+#if defined(RWS_OS_WINDOWS)
+	MemoryBarrier();
+	*value = new_value;
+#else
+	__atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+#endif
+}
+
+size_t rws_atomic_exchange(volatile size_t * value, const size_t new_value) {
+#if defined(RWS_OS_WINDOWS)
+	return (size_t)InterlockedExchangePointer((PVOID volatile *)value, (PVOID)new_value);
+#else
+	return __atomic_exchange_n(value, new_value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+rws_bool rws_atomic_cas(volatile size_t * value, const size_t expected, const size_t new_value) {
+#if defined(RWS_OS_WINDOWS)
+	return ((size_t)InterlockedCompareExchangePointer((PVOID volatile *)value, (PVOID)new_value, (PVOID)expected) == expected) ? rws_true : rws_false;
+#else
+	size_t current = expected;
+	return __atomic_compare_exchange_n(value, &current, new_value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) ? rws_true : rws_false;
+#endif
+}
+
+size_t rws_atomic_fetch_or(volatile size_t * value, const size_t bits) {
+	size_t current = rws_atomic_load(value);
+	while (!rws_atomic_cas(value, current, current | bits)) {
+		current = rws_atomic_load(value);
+	}
+	return current;
+}
+
+rws_cond rws_cond_create(void) {
+#if defined(RWS_OS_WINDOWS)
+	CONDITION_VARIABLE * cond = (CONDITION_VARIABLE *)rws_malloc_zero(sizeof(CONDITION_VARIABLE));
+	InitializeConditionVariable(cond);
+#else
+	pthread_cond_t * cond = (pthread_cond_t *)rws_malloc_zero(sizeof(pthread_cond_t));
+	pthread_cond_init(cond, NULL);
+#endif
+	return cond;
+}
+
+void rws_cond_wait(rws_cond cond, void * mutex) {
+#if defined(RWS_OS_WINDOWS)
+	SleepConditionVariableCS((PCONDITION_VARIABLE)cond, (LPCRITICAL_SECTION)mutex, INFINITE);
+#else
+	pthread_cond_wait((pthread_cond_t *)cond, (pthread_mutex_t *)mutex);
+#endif
+}
+
+void rws_cond_signal(rws_cond cond) {
+#if defined(RWS_OS_WINDOWS)
+	WakeConditionVariable((PCONDITION_VARIABLE)cond);
+#else
+	pthread_cond_signal((pthread_cond_t *)cond);
+#endif
+}
+
+void rws_cond_broadcast(rws_cond cond) {
+#if defined(RWS_OS_WINDOWS)
+	WakeAllConditionVariable((PCONDITION_VARIABLE)cond);
+#else
+	pthread_cond_broadcast((pthread_cond_t *)cond);
+#endif
+}
+
+void rws_cond_delete(rws_cond cond) {
+	if (cond) {
+#if !defined(RWS_OS_WINDOWS)
+		pthread_cond_destroy((pthread_cond_t *)cond);
+#endif
+		rws_free(cond);
+	}
+}
+
 rws_mutex rws_mutex_create_recursive(void) {
 #if defined(RWS_OS_WINDOWS)
 	CRITICAL_SECTION * mutex = (CRITICAL_SECTION *)rws_malloc_zero(sizeof(CRITICAL_SECTION));
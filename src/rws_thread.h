@@ -26,6 +26,39 @@
 
 #include <stdio.h>
 
+// monotonic time in milliseconds
+unsigned long long rws_time_ms(void);
+
+// monotonic time in microseconds
+unsigned long long rws_time_us(void);
+
+// load with acquire semantic
+size_t rws_atomic_load(volatile size_t * value);
+
+// store with release semantic
+void rws_atomic_store(volatile size_t * value, const size_t new_value);
+
+// store new value and return previous, full barrier
+size_t rws_atomic_exchange(volatile size_t * value, const size_t new_value);
+
+// store new value if current is 'expected', full barrier
+rws_bool rws_atomic_cas(volatile size_t * value, const size_t expected, const size_t new_value);
+
+// set bits and return previous value, full barrier
+size_t rws_atomic_fetch_or(volatile size_t * value, const size_t bits);
+
+// condition variable, used with non recursively locked 'rws_mutex'
+typedef void * rws_cond;
+
+rws_cond rws_cond_create(void);
+
+void rws_cond_wait(rws_cond cond, void * mutex);
+
+void rws_cond_signal(rws_cond cond);
+
+void rws_cond_broadcast(rws_cond cond);
+
+void rws_cond_delete(rws_cond cond);
 
 #endif
 
@@ -0,0 +1,254 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#include "rws_transport.h"
+#include "rws_socket.h"
+#include "rws_memory.h"
+
+// tcp
+
+static int rws_transport_tcp_send(void * context, const void * data, const size_t data_size, int * error_number) {
+	rws_socket s = (rws_socket)context;
+	int sended = -1;
+#if defined(RWS_OS_WINDOWS)
+	sended = send(s->socket, (const char *)data, (int)data_size, 0);
+	*error_number = WSAGetLastError();
+#else
+	sended = (int)send(s->socket, data, data_size, 0);
+	*error_number = errno;
+#endif
+	return sended;
+}
+
+static int rws_transport_tcp_recv(void * context, void * buff, const size_t buff_size, int * error_number) {
+	rws_socket s = (rws_socket)context;
+	int len = -1;
+#if defined(RWS_OS_WINDOWS)
+	len = recv(s->socket, (char *)buff, (int)buff_size, 0);
+	*error_number = WSAGetLastError();
+#else
+	len = (int)recv(s->socket, buff, buff_size, 0);
+	*error_number = errno;
+#endif
+	if (len == 0) {
+		*error_number = ECONNRESET; // closed by peer
+		return -1;
+	}
+	return len;
+}
+
+static rws_bool rws_transport_tcp_is_open(void * context) {
+	rws_socket s = (rws_socket)context;
+	return (s->socket != RWS_INVALID_SOCKET) ? rws_true : rws_false;
+}
+
+static void rws_transport_tcp_close(void * context) {
+	rws_socket s = (rws_socket)context;
+	if (s->socket != RWS_INVALID_SOCKET) {
+		RWS_SOCK_CLOSE(s->socket);
+		s->socket = RWS_INVALID_SOCKET;
+#if defined(RWS_OS_WINDOWS)
+		WSACleanup();
+#endif
+	}
+}
+
+void rws_transport_init_tcp(_rws_transport * transport, void * socket) {
+	memset(transport, 0, sizeof(_rws_transport));
+	transport->context = socket;
+	transport->send = &rws_transport_tcp_send;
+	transport->recv = &rws_transport_tcp_recv;
+	transport->is_open = &rws_transport_tcp_is_open;
+	transport->close = &rws_transport_tcp_close;
+}
+
+// pipe
+
+_rws_pipe * rws_pipe_create(void) {
+	_rws_pipe * pipe = (_rws_pipe *)rws_malloc_zero(sizeof(_rws_pipe));
+	pipe->mutex = rws_mutex_create_recursive();
+	return pipe;
+}
+
+void rws_pipe_delete(_rws_pipe * pipe) {
+	if (pipe) {
+		rws_free(pipe->in);
+		rws_free(pipe->out);
+		rws_mutex_delete(pipe->mutex);
+		rws_free(pipe);
+	}
+}
+
+void rws_pipe_delete_clean(_rws_pipe ** pipe) {
+	if (pipe) {
+		rws_pipe_delete(*pipe);
+		*pipe = NULL;
+	}
+}
+
+void rws_pipe_set_chunks(_rws_pipe * pipe, const size_t recv_chunk, const size_t send_chunk) {
+	rws_mutex_lock(pipe->mutex);
+	pipe->recv_chunk = recv_chunk;
+	pipe->send_chunk = send_chunk;
+	rws_mutex_unlock(pipe->mutex);
+}
+
+void rws_pipe_set_out_capacity(_rws_pipe * pipe, const size_t out_capacity) {
+	rws_mutex_lock(pipe->mutex);
+	pipe->out_capacity = out_capacity;
+	rws_mutex_unlock(pipe->mutex);
+}
+
+static void rws_pipe_append(char ** buff, size_t * size, size_t * len, const void * data, const size_t data_size) {
+	char * res = NULL;
+	size_t new_size = *size ? *size : 1024;
+	if (*len + data_size > *size) {
+		while (new_size < *len + data_size) {
+			new_size <<= 1;
+		}
+		res = (char *)rws_malloc(new_size);
+		if (*len) {
+			memcpy(res, *buff, *len);
+		}
+		rws_free(*buff);
+		*buff = res;
+		*size = new_size;
+	}
+	memcpy(*buff + *len, data, data_size);
+	*len += data_size;
+}
+
+void rws_pipe_write(_rws_pipe * pipe, const void * data, const size_t data_size) {
+	rws_mutex_lock(pipe->mutex);
+	if (pipe->in_offset == pipe->in_len) {
+		pipe->in_offset = 0;
+		pipe->in_len = 0;
+	}
+	rws_pipe_append(&pipe->in, &pipe->in_size, &pipe->in_len, data, data_size);
+	rws_mutex_unlock(pipe->mutex);
+}
+
+size_t rws_pipe_read(_rws_pipe * pipe, void * buff, const size_t buff_size) {
+	size_t len = 0;
+	rws_mutex_lock(pipe->mutex);
+	len = (pipe->out_len < buff_size) ? pipe->out_len : buff_size;
+	if (len) {
+		memcpy(buff, pipe->out, len);
+		memmove(pipe->out, pipe->out + len, pipe->out_len - len);
+		pipe->out_len -= len;
+	}
+	rws_mutex_unlock(pipe->mutex);
+	return len;
+}
+
+void rws_pipe_close(_rws_pipe * pipe) {
+	rws_mutex_lock(pipe->mutex);
+	pipe->is_closed_by_peer = rws_true;
+	rws_mutex_unlock(pipe->mutex);
+}
+
+static rws_bool rws_transport_pipe_open(void * context) {
+	_rws_pipe * pipe = (_rws_pipe *)context;
+	rws_mutex_lock(pipe->mutex);
+	pipe->is_open = pipe->is_closed_by_peer ? rws_false : rws_true;
+	rws_mutex_unlock(pipe->mutex);
+	return pipe->is_open;
+}
+
+static int rws_transport_pipe_send(void * context, const void * data, const size_t data_size, int * error_number) {
+	_rws_pipe * pipe = (_rws_pipe *)context;
+	size_t len = data_size;
+	rws_mutex_lock(pipe->mutex);
+	if (!pipe->is_open || pipe->is_closed_by_peer) {
+		rws_mutex_unlock(pipe->mutex);
+		*error_number = EPIPE;
+		return -1;
+	}
+	if (pipe->send_chunk && len > pipe->send_chunk) {
+		len = pipe->send_chunk;
+	}
+	if (pipe->out_capacity) {
+		if (pipe->out_len >= pipe->out_capacity) {
+			rws_mutex_unlock(pipe->mutex);
+			*error_number = WSAEWOULDBLOCK;
+			return -1;
+		}
+		if (len > pipe->out_capacity - pipe->out_len) {
+			len = pipe->out_capacity - pipe->out_len;
+		}
+	}
+	rws_pipe_append(&pipe->out, &pipe->out_size, &pipe->out_len, data, len);
+	rws_mutex_unlock(pipe->mutex);
+	*error_number = 0;
+	return (int)len;
+}
+
+static int rws_transport_pipe_recv(void * context, void * buff, const size_t buff_size, int * error_number) {
+	_rws_pipe * pipe = (_rws_pipe *)context;
+	size_t len = 0;
+	rws_mutex_lock(pipe->mutex);
+	len = pipe->in_len - pipe->in_offset;
+	if (!pipe->is_open || (!len && pipe->is_closed_by_peer)) {
+		rws_mutex_unlock(pipe->mutex);
+		*error_number = ECONNRESET;
+		return -1;
+	}
+	if (!len) {
+		rws_mutex_unlock(pipe->mutex);
+		*error_number = WSAEWOULDBLOCK;
+		return -1;
+	}
+	if (len > buff_size) {
+		len = buff_size;
+	}
+	if (pipe->recv_chunk && len > pipe->recv_chunk) {
+		len = pipe->recv_chunk;
+	}
+	memcpy(buff, pipe->in + pipe->in_offset, len);
+	pipe->in_offset += len;
+	rws_mutex_unlock(pipe->mutex);
+	*error_number = 0;
+	return (int)len;
+}
+
+static rws_bool rws_transport_pipe_is_open(void * context) {
+	return ((_rws_pipe *)context)->is_open;
+}
+
+static void rws_transport_pipe_close(void * context) {
+	_rws_pipe * pipe = (_rws_pipe *)context;
+	rws_mutex_lock(pipe->mutex);
+	pipe->is_open = rws_false;
+	rws_mutex_unlock(pipe->mutex);
+}
+
+void rws_transport_init_pipe(_rws_transport * transport, _rws_pipe * pipe) {
+	memset(transport, 0, sizeof(_rws_transport));
+	transport->context = pipe;
+	transport->open = &rws_transport_pipe_open;
+	transport->send = &rws_transport_pipe_send;
+	transport->recv = &rws_transport_pipe_recv;
+	transport->is_open = &rws_transport_pipe_is_open;
+	transport->close = &rws_transport_pipe_close;
+}
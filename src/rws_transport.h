@@ -0,0 +1,92 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#ifndef __RWS_TRANSPORT_H__
+#define __RWS_TRANSPORT_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+#include "rws_thread.h"
+
+// byte stream under the websocket protocol.
+// send and recv return positive number of bytes, or -1 with 'error_number' set:
+// WSAEWOULDBLOCK (EAGAIN on posix) or WSAEINPROGRESS - would block, try on next cycle,
+// any other system error code - stream is failed, peer closed stream (recv of 0 bytes) is ECONNRESET.
+// 0 is not returned, it is handled as error with 'error_number'.
+typedef struct _rws_transport_struct {
+	void * context;
+	rws_bool (*open)(void * context); // NULL - socket resolves and connects tcp itself
+	int (*send)(void * context, const void * data, const size_t data_size, int * error_number);
+	int (*recv)(void * context, void * buff, const size_t buff_size, int * error_number);
+	rws_bool (*is_open)(void * context);
+	void (*close)(void * context);
+} _rws_transport;
+
+// tcp socket transport, context is rws_socket
+void rws_transport_init_tcp(_rws_transport * transport, void * socket);
+
+// in memory pipe, used for tests and benchmarks of the protocol and dispatch code
+typedef struct _rws_pipe_struct {
+	char * in; // bytes to be received by the socket
+	size_t in_size;
+	size_t in_len;
+	size_t in_offset;
+
+	char * out; // bytes sent by the socket
+	size_t out_size;
+	size_t out_len;
+
+	size_t recv_chunk; // max bytes per recv, 0 - unlimited
+	size_t send_chunk; // max bytes per send, 0 - unlimited
+	size_t out_capacity; // max not read sent bytes, send would block when full, 0 - unlimited
+
+	rws_bool is_open;
+	rws_bool is_closed_by_peer;
+
+	rws_mutex mutex;
+} _rws_pipe;
+
+_rws_pipe * rws_pipe_create(void);
+
+void rws_pipe_delete(_rws_pipe * pipe);
+
+void rws_pipe_delete_clean(_rws_pipe ** pipe);
+
+void rws_pipe_set_chunks(_rws_pipe * pipe, const size_t recv_chunk, const size_t send_chunk);
+
+void rws_pipe_set_out_capacity(_rws_pipe * pipe, const size_t out_capacity);
+
+// peer side, append bytes for socket reading
+void rws_pipe_write(_rws_pipe * pipe, const void * data, const size_t data_size);
+
+// peer side, move sent bytes, returns number of moved bytes
+size_t rws_pipe_read(_rws_pipe * pipe, void * buff, const size_t buff_size);
+
+// peer side, socket reads error after all written bytes
+void rws_pipe_close(_rws_pipe * pipe);
+
+void rws_transport_init_pipe(_rws_transport * transport, _rws_pipe * pipe);
+
+#endif
+
@@ -0,0 +1,307 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#include "rws_utf8.h"
+#include "rws_thread.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define RWS_UTF8_SSSE3 1
+#define RWS_UTF8_SSSE3_TARGET __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define RWS_UTF8_SSSE3 1
+#define RWS_UTF8_SSSE3_TARGET
+#include <intrin.h>
+#include <tmmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define RWS_UTF8_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Vector path validates whole 16 byte blocks with lookup tables of the previous and current bytes,
+// see "Validating UTF-8 In Less Than One Instruction Per Byte", J. Keiser, D. Lemire.
+// Error bits of the tables:
+#define RWS_UTF8_TOO_SHORT (1 << 0) // lead byte or ASCII followed by lead byte or ASCII
+#define RWS_UTF8_TOO_LONG (1 << 1) // ASCII followed by continuation
+#define RWS_UTF8_OVERLONG_3 (1 << 2)
+#define RWS_UTF8_TOO_LARGE (1 << 3)
+#define RWS_UTF8_SURROGATE (1 << 4)
+#define RWS_UTF8_OVERLONG_2 (1 << 5)
+#define RWS_UTF8_TOO_LARGE_1000 (1 << 6)
+#define RWS_UTF8_OVERLONG_4 (1 << 6)
+#define RWS_UTF8_TWO_CONTS (1 << 7) // two continuations, must be third or fourth byte
+#define RWS_UTF8_CARRY (RWS_UTF8_TOO_SHORT | RWS_UTF8_TOO_LONG | RWS_UTF8_TWO_CONTS)
+
+#if defined(RWS_UTF8_SSSE3) || defined(RWS_UTF8_NEON)
+// high nibble of the first byte
+static const unsigned char k_rws_utf8_byte_1_high[16] = {
+	RWS_UTF8_TOO_LONG, RWS_UTF8_TOO_LONG, RWS_UTF8_TOO_LONG, RWS_UTF8_TOO_LONG,
+	RWS_UTF8_TOO_LONG, RWS_UTF8_TOO_LONG, RWS_UTF8_TOO_LONG, RWS_UTF8_TOO_LONG,
+	RWS_UTF8_TWO_CONTS, RWS_UTF8_TWO_CONTS, RWS_UTF8_TWO_CONTS, RWS_UTF8_TWO_CONTS,
+	RWS_UTF8_TOO_SHORT | RWS_UTF8_OVERLONG_2,
+	RWS_UTF8_TOO_SHORT,
+	RWS_UTF8_TOO_SHORT | RWS_UTF8_OVERLONG_3 | RWS_UTF8_SURROGATE,
+	RWS_UTF8_TOO_SHORT | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000 | RWS_UTF8_OVERLONG_4
+};
+
+// low nibble of the first byte
+static const unsigned char k_rws_utf8_byte_1_low[16] = {
+	RWS_UTF8_CARRY | RWS_UTF8_OVERLONG_3 | RWS_UTF8_OVERLONG_2 | RWS_UTF8_OVERLONG_4,
+	RWS_UTF8_CARRY | RWS_UTF8_OVERLONG_2,
+	RWS_UTF8_CARRY,
+	RWS_UTF8_CARRY,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000 | RWS_UTF8_SURROGATE,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000,
+	RWS_UTF8_CARRY | RWS_UTF8_TOO_LARGE | RWS_UTF8_TOO_LARGE_1000
+};
+
+// high nibble of the second byte
+static const unsigned char k_rws_utf8_byte_2_high[16] = {
+	RWS_UTF8_TOO_SHORT, RWS_UTF8_TOO_SHORT, RWS_UTF8_TOO_SHORT, RWS_UTF8_TOO_SHORT,
+	RWS_UTF8_TOO_SHORT, RWS_UTF8_TOO_SHORT, RWS_UTF8_TOO_SHORT, RWS_UTF8_TOO_SHORT,
+	RWS_UTF8_TOO_LONG | RWS_UTF8_OVERLONG_2 | RWS_UTF8_TWO_CONTS | RWS_UTF8_OVERLONG_3 | RWS_UTF8_TOO_LARGE_1000 | RWS_UTF8_OVERLONG_4,
+	RWS_UTF8_TOO_LONG | RWS_UTF8_OVERLONG_2 | RWS_UTF8_TWO_CONTS | RWS_UTF8_OVERLONG_3 | RWS_UTF8_TOO_LARGE,
+	RWS_UTF8_TOO_LONG | RWS_UTF8_OVERLONG_2 | RWS_UTF8_TWO_CONTS | RWS_UTF8_SURROGATE | RWS_UTF8_TOO_LARGE,
+	RWS_UTF8_TOO_LONG | RWS_UTF8_OVERLONG_2 | RWS_UTF8_TWO_CONTS | RWS_UTF8_SURROGATE | RWS_UTF8_TOO_LARGE,
+	RWS_UTF8_TOO_SHORT, RWS_UTF8_TOO_SHORT, RWS_UTF8_TOO_SHORT, RWS_UTF8_TOO_SHORT
+};
+
+// last bytes of the block which can start an unfinished sequence
+static const unsigned char k_rws_utf8_max_value[16] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+};
+#endif
+
+#if defined(RWS_UTF8_SSSE3)
+
+RWS_UTF8_SSSE3_TARGET static rws_bool rws_utf8_validate_blocks_ssse3(const unsigned char * data, const size_t blocks) {
+	const __m128i byte_1_high = _mm_loadu_si128((const __m128i *)k_rws_utf8_byte_1_high);
+	const __m128i byte_1_low = _mm_loadu_si128((const __m128i *)k_rws_utf8_byte_1_low);
+	const __m128i byte_2_high = _mm_loadu_si128((const __m128i *)k_rws_utf8_byte_2_high);
+	const __m128i max_value = _mm_loadu_si128((const __m128i *)k_rws_utf8_max_value);
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	const __m128i third_byte = _mm_set1_epi8((char)(0xE0 - 0x80)); // only 111_____ will be >= 0x80
+	const __m128i fourth_byte = _mm_set1_epi8((char)(0xF0 - 0x80)); // only 1111____ will be >= 0x80
+	const __m128i high_bit = _mm_set1_epi8((char)0x80);
+	__m128i prev = _mm_setzero_si128(), error = _mm_setzero_si128(), prev_incomplete = _mm_setzero_si128();
+	__m128i input, prev1, special, must23;
+	size_t i = 0;
+
+	for (i = 0; i < blocks; i++) {
+		input = _mm_loadu_si128((const __m128i *)(data + (i << 4)));
+		if (_mm_movemask_epi8(input) == 0) { // ASCII
+			error = _mm_or_si128(error, prev_incomplete);
+			prev_incomplete = _mm_setzero_si128();
+		} else {
+			prev1 = _mm_alignr_epi8(input, prev, 15);
+			special = _mm_and_si128(_mm_and_si128(
+				_mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+				_mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+				_mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+			must23 = _mm_or_si128(_mm_subs_epu8(_mm_alignr_epi8(input, prev, 14), third_byte),
+								  _mm_subs_epu8(_mm_alignr_epi8(input, prev, 13), fourth_byte));
+			error = _mm_or_si128(error, _mm_xor_si128(_mm_and_si128(must23, high_bit), special));
+			prev_incomplete = _mm_subs_epu8(input, max_value);
+		}
+		prev = input;
+	}
+	error = _mm_or_si128(error, prev_incomplete);
+	return (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF) ? rws_true : rws_false;
+}
+
+static rws_bool rws_utf8_is_ssse3(void) {
+	static volatile size_t is_ssse3 = 0; // 0 - not checked, 1 - no, 2 - yes
+	size_t r = rws_atomic_load(&is_ssse3);
+	if (!r) {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		r = (info[2] & (1 << 9)) ? 2 : 1;
+#else
+		r = __builtin_cpu_supports("ssse3") ? 2 : 1;
+#endif
+		rws_atomic_store(&is_ssse3, r);
+	}
+	return (r == 2) ? rws_true : rws_false;
+}
+
+#elif defined(RWS_UTF8_NEON)
+
+static rws_bool rws_utf8_validate_blocks_neon(const unsigned char * data, const size_t blocks) {
+	const uint8x16_t byte_1_high = vld1q_u8(k_rws_utf8_byte_1_high);
+	const uint8x16_t byte_1_low = vld1q_u8(k_rws_utf8_byte_1_low);
+	const uint8x16_t byte_2_high = vld1q_u8(k_rws_utf8_byte_2_high);
+	const uint8x16_t max_value = vld1q_u8(k_rws_utf8_max_value);
+	const uint8x16_t nibble = vdupq_n_u8(0x0F);
+	const uint8x16_t third_byte = vdupq_n_u8(0xE0 - 0x80);
+	const uint8x16_t fourth_byte = vdupq_n_u8(0xF0 - 0x80);
+	const uint8x16_t high_bit = vdupq_n_u8(0x80);
+	uint8x16_t prev = vdupq_n_u8(0), error = vdupq_n_u8(0), prev_incomplete = vdupq_n_u8(0);
+	uint8x16_t input, prev1, special, must23;
+	size_t i = 0;
+
+	for (i = 0; i < blocks; i++) {
+		input = vld1q_u8(data + (i << 4));
+		if (vmaxvq_u8(input) < 0x80) { // ASCII
+			error = vorrq_u8(error, prev_incomplete);
+			prev_incomplete = vdupq_n_u8(0);
+		} else {
+			prev1 = vextq_u8(prev, input, 15);
+			special = vandq_u8(vandq_u8(
+				vqtbl1q_u8(byte_1_high, vshrq_n_u8(prev1, 4)),
+				vqtbl1q_u8(byte_1_low, vandq_u8(prev1, nibble))),
+				vqtbl1q_u8(byte_2_high, vshrq_n_u8(input, 4)));
+			must23 = vorrq_u8(vqsubq_u8(vextq_u8(prev, input, 14), third_byte),
+							  vqsubq_u8(vextq_u8(prev, input, 13), fourth_byte));
+			error = vorrq_u8(error, veorq_u8(vandq_u8(must23, high_bit), special));
+			prev_incomplete = vqsubq_u8(input, max_value);
+		}
+		prev = input;
+	}
+	error = vorrq_u8(error, prev_incomplete);
+	return (vmaxvq_u8(error) == 0) ? rws_true : rws_false;
+}
+
+#endif
+
+// number of whole 16 byte blocks from the start of the character, followed by the start of the character
+static size_t rws_utf8_get_blocks(const unsigned char * data, const size_t data_size) {
+	size_t blocks = data_size >> 4;
+	// next part of the text is unknown, so block can't end at the end of data
+	while (blocks && ((blocks << 4) == data_size || (data[blocks << 4] & 0xC0) == 0x80)) {
+		blocks--;
+	}
+	return blocks;
+}
+
+static rws_bool rws_utf8_validate_scalar(_rws_utf8 * u, const unsigned char * data, const size_t data_size) {
+	const unsigned char * end = data + data_size;
+	unsigned long long chunk = 0;
+	unsigned char c = 0;
+
+	while (data < end) {
+		if (u->need == 0) {
+			// skip ASCII by 8 bytes
+			while (end - data >= 8) {
+				memcpy(&chunk, data, 8);
+				if (chunk & 0x8080808080808080ULL) {
+					break;
+				}
+				data += 8;
+			}
+			if (data == end) {
+				break;
+			}
+			c = *data++;
+			if (c < 0x80) {
+				continue;
+			}
+			u->lower = 0x80;
+			u->upper = 0xBF;
+			if (c >= 0xC2 && c <= 0xDF) {
+				u->need = 1;
+			} else if (c >= 0xE0 && c <= 0xEF) {
+				u->need = 2;
+				if (c == 0xE0) {
+					u->lower = 0xA0; // overlong
+				} else if (c == 0xED) {
+					u->upper = 0x9F; // surrogates
+				}
+			} else if (c >= 0xF0 && c <= 0xF4) {
+				u->need = 3;
+				if (c == 0xF0) {
+					u->lower = 0x90; // overlong
+				} else if (c == 0xF4) {
+					u->upper = 0x8F; // above U+10FFFF
+				}
+			} else {
+				return rws_false;
+			}
+		} else {
+			c = *data++;
+			if (c < u->lower || c > u->upper) {
+				return rws_false;
+			}
+			u->need--;
+			u->lower = 0x80;
+			u->upper = 0xBF;
+		}
+	}
+	return rws_true;
+}
+
+void rws_utf8_reset(_rws_utf8 * u) {
+	u->need = 0;
+	u->lower = 0x80;
+	u->upper = 0xBF;
+}
+
+rws_bool rws_utf8_validate(_rws_utf8 * u, const void * data, const size_t data_size) {
+	const unsigned char * ptr = (const unsigned char *)data;
+	size_t size = data_size;
+#if defined(RWS_UTF8_SSSE3) || defined(RWS_UTF8_NEON)
+	size_t blocks = 0;
+
+	// finish character started in the previous part
+	while (u->need && size) {
+		if (!rws_utf8_validate_scalar(u, ptr, 1)) {
+			return rws_false;
+		}
+		ptr++;
+		size--;
+	}
+
+	blocks = rws_utf8_get_blocks(ptr, size);
+#if defined(RWS_UTF8_SSSE3)
+	if (blocks && !rws_utf8_is_ssse3()) {
+		blocks = 0;
+	}
+	if (blocks && !rws_utf8_validate_blocks_ssse3(ptr, blocks)) {
+		return rws_false;
+	}
+#else
+	if (blocks && !rws_utf8_validate_blocks_neon(ptr, blocks)) {
+		return rws_false;
+	}
+#endif
+	ptr += blocks << 4;
+	size -= blocks << 4;
+#endif
+	return rws_utf8_validate_scalar(u, ptr, size);
+}
+
+rws_bool rws_utf8_is_complete(const _rws_utf8 * u) {
+	return (u->need == 0) ? rws_true : rws_false;
+}
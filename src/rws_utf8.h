@@ -0,0 +1,45 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+#ifndef __RWS_UTF8_H__
+#define __RWS_UTF8_H__ 1
+
+#include "../librws.h"
+#include "rws_common.h"
+
+// incremental UTF-8 validator, text can be split at any byte
+typedef struct _rws_utf8_struct {
+	unsigned char need; // number of expected continuation bytes
+	unsigned char lower; // range of the next continuation byte
+	unsigned char upper;
+} _rws_utf8;
+
+void rws_utf8_reset(_rws_utf8 * u);
+
+// validate next part of the text, rws_false - invalid sequence
+rws_bool rws_utf8_validate(_rws_utf8 * u, const void * data, const size_t data_size);
+
+// last character is complete, check at the end of the text
+rws_bool rws_utf8_is_complete(const _rws_utf8 * u);
+
+#endif
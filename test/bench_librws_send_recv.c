@@ -0,0 +1,186 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+#if defined(CMAKE_BUILD)
+#undef CMAKE_BUILD
+#endif
+
+#if defined(XCODE)
+#include "librws.h"
+#else
+#include <librws.h>
+#endif
+
+#include "../src/rws_socket.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// application thread sends messages while the loop thread receives and sends over in memory transport,
+// shows cost of the cache lines shared by both threads: bench_librws_send_recv [messages]
+
+#define BENCH_PAYLOAD_SIZE 64
+#define BENCH_CHUNK_FRAMES 64
+
+static unsigned int _count = 1000000;
+static volatile size_t _is_producing = 1;
+static unsigned int _recvd = 0;
+
+static void on_recvd_bin(rws_socket socket, const void * data, const unsigned int length) {
+	_recvd++;
+}
+
+static void on_disconnected(rws_socket socket) {
+}
+
+static void producer(void * user_object) {
+	rws_socket socket = (rws_socket)user_object;
+	unsigned char payload[BENCH_PAYLOAD_SIZE];
+	unsigned int i = 0;
+	memset(payload, 1, sizeof(payload));
+	for (i = 0; i < _count; i++) {
+		rws_socket_send_binary(socket, payload, sizeof(payload));
+	}
+	rws_atomic_store(&_is_producing, 0);
+}
+
+// cache misses of this process and threads created after, -1 - not available
+static int open_cache_misses(void) {
+#if defined(__linux__)
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_kernel = 1;
+	attr.inherit = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+static long long read_cache_misses(const int fd) {
+	long long value = -1;
+#if defined(__linux__)
+	if (fd >= 0 && read(fd, &value, sizeof(value)) != sizeof(value)) {
+		value = -1;
+	}
+#endif
+	return value;
+}
+
+static void step(rws_socket socket) {
+	rws_socket_on_writable(socket);
+	rws_socket_on_readable(socket);
+}
+
+int main(int argc, char* argv[]) {
+	static const char * responce = "HTTP/1.1 101 Switching Protocols\r\n"
+	"Upgrade: websocket\r\n"
+	"Connection: Upgrade\r\n"
+	"Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+	unsigned char chunk[BENCH_CHUNK_FRAMES * (BENCH_PAYLOAD_SIZE + 2)];
+	unsigned char out[65536];
+	unsigned long long start = 0, elapsed = 0, sent_bytes = 0;
+	long long misses = -1;
+	size_t chunk_len = 0, n = 0;
+	unsigned int i = 0;
+	int fd = -1;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+
+	if (argc > 1) {
+		_count = (unsigned int)atoi(argv[1]);
+	}
+
+	// server frames, unmasked
+	for (i = 0; i < BENCH_CHUNK_FRAMES; i++) {
+		chunk[chunk_len++] = 0x82;
+		chunk[chunk_len++] = BENCH_PAYLOAD_SIZE;
+		memset(chunk + chunk_len, 2, BENCH_PAYLOAD_SIZE);
+		chunk_len += BENCH_PAYLOAD_SIZE;
+	}
+
+	rws_proto_set_test_key("dGhlIHNhbXBsZSBub25jZQ=="); // RFC 6455 sample key of the 'responce'
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_bin(socket, &on_recvd_bin);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	if (!rws_socket_connect(socket)) {
+		return 1;
+	}
+	step(socket);
+	while (rws_pipe_read(pipe, out, sizeof(out))) { }
+	rws_pipe_write(pipe, responce, strlen(responce));
+	step(socket);
+	step(socket);
+	if (!rws_socket_is_connected(socket)) {
+		return 1;
+	}
+
+	fd = open_cache_misses();
+	start = rws_time_us();
+	if (!rws_thread_create_with_attr(&producer, socket, NULL, "bench-producer")) {
+		return 1;
+	}
+	while (rws_atomic_load(&_is_producing) || rws_proto_is_output_posted(&socket->proto)) {
+		if (_recvd < _count) {
+			rws_pipe_write(pipe, chunk, chunk_len);
+		}
+		step(socket);
+		while ((n = rws_pipe_read(pipe, out, sizeof(out)))) {
+			sent_bytes += n;
+		}
+	}
+	elapsed = rws_time_us() - start;
+	misses = read_cache_misses(fd);
+
+	if (!elapsed) {
+		elapsed = 1;
+	}
+	printf("sent: %u messages, %llu bytes, %.0f messages/s\n", _count, sent_bytes, _count * 1000000.0 / elapsed);
+	printf("received: %u messages, %.0f messages/s\n", _recvd, _recvd * 1000000.0 / elapsed);
+	printf("time: %llu ms\n", elapsed / 1000);
+	if (misses >= 0) {
+		printf("cache misses: %lld, %.2f per message\n", misses, (double)misses / (_count + _recvd));
+	} else {
+		printf("cache misses: not available\n");
+	}
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+	return 0;
+}
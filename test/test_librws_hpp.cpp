@@ -0,0 +1,256 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#if defined(CMAKE_BUILD)
+#undef CMAKE_BUILD
+#endif
+
+#if defined(XCODE)
+#include "librws.hpp"
+#else
+#include <librws.hpp>
+#endif
+
+extern "C" {
+#include "../src/rws_socket.h"
+}
+
+// C++ wrapper over in memory transport: handlers, owned messages, lifetime
+
+static const char * _responce = "HTTP/1.1 101 Switching Protocols\r\n"
+	"Upgrade: websocket\r\n"
+	"Connection: Upgrade\r\n"
+	"Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+	"\r\n";
+
+static std::string make_frame(const int opcode, const std::string & payload) {
+	std::string frame;
+	frame.push_back((char)(0x80 | opcode));
+	frame.push_back((char)payload.size()); // short frames only
+	return frame + payload;
+}
+
+// reads one masked client frame, skips pings
+static int read_client_frame(_rws_pipe * pipe, std::string & payload) {
+	unsigned char header[8];
+	int opcode = -1;
+	size_t n = 0;
+	do {
+		if (rws_pipe_read(pipe, header, 2) != 2) {
+			return -1;
+		}
+		assert((header[1] & 0x80) && (header[1] & 0x7F) < 126);
+		rws_pipe_read(pipe, header + 2, 4);
+		payload.resize(header[1] & 0x7F);
+		n = rws_pipe_read(pipe, payload.data(), payload.size());
+		assert(n == payload.size());
+		for (size_t i = 0; i < payload.size(); i++) {
+			payload[i] ^= (char)header[2 + (i % 4)];
+		}
+		opcode = header[0] & 0x0F;
+	} while (opcode == rws_opcode_ping);
+	return opcode;
+}
+
+static void step(rws_socket socket) {
+	rws_socket_on_writable(socket);
+	rws_socket_on_readable(socket);
+}
+
+static void connect(rws::socket & socket, _rws_pipe * pipe, _rws_transport & transport) {
+	unsigned char buff[1024];
+	bool r = false;
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket.get(), &transport);
+	socket.set_url("ws", "mem", 80, "/");
+	r = socket.connect();
+	assert(r);
+	step(socket.get());
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket.get());
+	step(socket.get());
+}
+
+// external loop, handlers and sends
+static void test_handlers(void) {
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	std::vector<std::string> texts;
+	std::vector<std::byte> bin;
+	std::string frame;
+	int connected = 0, disconnected = 0;
+	bool r = false;
+	int opcode = 0;
+	{
+		rws::socket socket;
+		socket.set_external_loop(true);
+		socket.on_connected([&] { connected++; });
+		socket.on_disconnected([&](rws_error) { disconnected++; });
+		socket.on_text([&](std::string_view text) { texts.emplace_back(text); });
+		socket.on_binary([&](std::span<const std::byte> data) { bin.assign(data.begin(), data.end()); });
+		connect(socket, pipe, transport);
+		assert(connected == 1 && socket.is_connected());				printf("%i\n", (int)__LINE__);
+
+		frame = make_frame(rws_opcode_text_frame, "hello") + make_frame(rws_opcode_binary_frame, "bin");
+		rws_pipe_write(pipe, frame.data(), frame.size());
+		step(socket.get());
+		assert(texts.size() == 1 && texts[0] == "hello");				printf("%i\n", (int)__LINE__);
+		assert(bin.size() == 3 && bin[0] == std::byte('b'));			printf("%i\n", (int)__LINE__);
+
+		const std::byte data[] = { std::byte(1), std::byte(2) };
+		r = socket.send(std::string_view("text"));
+		assert(r);														printf("%i\n", (int)__LINE__);
+		r = socket.send(std::span<const std::byte>(data));
+		assert(r);														printf("%i\n", (int)__LINE__);
+		rws::message m = rws::message::allocate(3, true);
+		std::memcpy(m.buffer().data(), "own", 3);
+		r = socket.send(std::move(m));
+		assert(r && m.empty());											printf("%i\n", (int)__LINE__);
+		r = socket.send(std::string_view());
+		assert(r);														printf("%i\n", (int)__LINE__);
+		r = socket.send(std::span<const std::byte>());
+		assert(r);														printf("%i\n", (int)__LINE__);
+		step(socket.get());
+		opcode = read_client_frame(pipe, frame);
+		assert(opcode == rws_opcode_text_frame && frame == "text");		printf("%i\n", (int)__LINE__);
+		opcode = read_client_frame(pipe, frame);
+		assert(opcode == rws_opcode_binary_frame && frame == std::string("\1\2", 2)); printf("%i\n", (int)__LINE__);
+		opcode = read_client_frame(pipe, frame);
+		assert(opcode == rws_opcode_text_frame && frame == "own");		printf("%i\n", (int)__LINE__);
+		opcode = read_client_frame(pipe, frame); // empty messages are allowed
+		assert(opcode == rws_opcode_text_frame && frame.empty());		printf("%i\n", (int)__LINE__);
+		opcode = read_client_frame(pipe, frame);
+		assert(opcode == rws_opcode_binary_frame && frame.empty());		printf("%i\n", (int)__LINE__);
+	}
+	// released in place by external loop, no handlers after destructor
+	assert(disconnected == 0);											printf("%i\n", (int)__LINE__);
+	rws_pipe_delete(pipe);
+}
+
+// owned messages are moved to application without copy
+static void test_messages(void) {
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	std::vector<rws::message> messages;
+	std::string frame;
+	unsigned int texts = 0;
+	rws::socket socket;
+	bool r = false;
+	socket.set_external_loop(true);
+	socket.on_disconnected([](rws_error) { });
+	socket.on_text([&](std::string_view) { texts++; });
+	socket.on_message([&](rws::message && m) { messages.push_back(std::move(m)); });
+	connect(socket, pipe, transport);
+
+	frame = make_frame(rws_opcode_text_frame, "one") + make_frame(rws_opcode_binary_frame, "two");
+	rws_pipe_write(pipe, frame.data(), frame.size());
+	step(socket.get());
+	assert(texts == 0 && messages.size() == 2);						printf("%i\n", (int)__LINE__);
+	assert(messages[0].is_text() && messages[0].text() == "one");		printf("%i\n", (int)__LINE__);
+	assert(!messages[1].is_text() && messages[1].size() == 3);			printf("%i\n", (int)__LINE__);
+
+	rws::message moved(std::move(messages[1]));
+	assert(messages[1].empty() && moved.data()[0] == std::byte('t'));	printf("%i\n", (int)__LINE__);
+	r = socket.send(std::move(moved));
+	assert(!r);															printf("%i\n", (int)__LINE__); // received, no header room
+
+	{
+		// moved from socket is empty, methods do nothing
+		rws::socket other(std::move(socket));
+		socket.on_text([&](std::string_view) { texts++; });
+		socket.set_url("ws", "mem", 80, "/");
+		assert(!socket.get() && other.get());							printf("%i\n", (int)__LINE__);
+		r = socket.connect();
+		assert(!r && !socket.is_connected() && other.is_connected());	printf("%i\n", (int)__LINE__);
+		r = socket.send(std::string_view("moved"));
+		assert(!r);														printf("%i\n", (int)__LINE__);
+		r = socket.send(std::string_view());
+		assert(!r);														printf("%i\n", (int)__LINE__);
+		r = socket.send(rws::message::allocate(1));
+		assert(!r);														printf("%i\n", (int)__LINE__);
+		socket = std::move(other);
+	}
+	socket = rws::socket(); // old socket is released
+	assert(!socket.is_connected());									printf("%i\n", (int)__LINE__);
+	rws_pipe_delete(pipe);
+}
+
+// work thread deletes socket after disconnect, wrapper stays valid
+static void test_thread_lifetime(void) {
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	bool r = false;
+	std::atomic<int> connected(0), disconnected(0);
+	unsigned char buff[1024];
+	std::string frame;
+	unsigned int waited = 0;
+	rws::socket socket;
+	socket.on_connected([&] { connected++; });
+	socket.on_disconnected([&](rws_error) { disconnected++; });
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket.get(), &transport);
+	socket.set_url("ws", "mem", 80, "/");
+	r = socket.connect();
+	assert(r);
+
+	while (!rws_pipe_read(pipe, buff, sizeof(buff)) && ++waited < 1000) {
+		rws_thread_sleep(1);
+	}
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	for (waited = 0; !connected && waited < 1000; waited++) {
+		rws_thread_sleep(1);
+	}
+	assert(connected == 1);											printf("%i\n", (int)__LINE__);
+
+	frame = make_frame(rws_opcode_connection_close, "");
+	rws_pipe_write(pipe, frame.data(), frame.size());
+	for (waited = 0; !disconnected && waited < 1000; waited++) {
+		rws_thread_sleep(1);
+	}
+	assert(disconnected == 1 && !socket.get());						printf("%i\n", (int)__LINE__);
+	r = socket.send(std::string_view("late"));
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	r = socket.connect();
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	r = rws_shutdown_all(2000);
+	assert(r);															printf("%i\n", (int)__LINE__); // socket is deleted, pipe is not used
+	rws_pipe_delete(pipe);
+}
+
+int main(int argc, char* argv[]) {
+	rws_proto_set_test_key("dGhlIHNhbXBsZSBub25jZQ=="); // RFC 6455 sample key of the '_responce'
+	test_handlers();
+	test_messages();
+	test_thread_lifetime();
+	return 0;
+}
@@ -44,6 +44,8 @@ int main(int argc, char* argv[]) {
 	const char * scheme = "ws";
 	const char * host = "echo.websocket.org";
 	const char * path = "/";
+	rws_bool r = rws_false;
+	size_t n = 0;
 	
 	rws_socket socket = rws_socket_create();
 	assert(socket);
@@ -76,8 +78,41 @@ int main(int argc, char* argv[]) {
 	assert(rws_socket_get_path(socket) == NULL);						printf("%i\n", (int)__LINE__);
 
 
+	rws_socket_set_external_loop(socket, rws_true);						printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_fd(socket) == RWS_INVALID_FD);				printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_wanted_events(socket) == rws_socket_event_none); printf("%i\n", (int)__LINE__);
+
+	rws_message messages[4];
+	rws_socket_set_poll_mode(socket, 16);								printf("%i\n", (int)__LINE__);
+	n = rws_socket_poll_messages(socket, messages, 4);
+	assert(n == 0);														printf("%i\n", (int)__LINE__);
+
+	rws_socket_set_send_rate_limit(socket, 10, 1024);					printf("%i\n", (int)__LINE__);
+	rws_socket_set_recv_rate_limit(socket, 1024);						printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_send_throttled_time(socket) == 0);			printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_recv_throttled_time(socket) == 0);			printf("%i\n", (int)__LINE__);
+
+
+	rws_thread_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.stack_size = 64 * 1024;
+	rws_socket_set_thread_attr(socket, &attr);							printf("%i\n", (int)__LINE__);
+	rws_socket_set_thread_attr(socket, NULL);							printf("%i\n", (int)__LINE__);
+
+	unsigned int histogram[RWS_LOOP_HISTOGRAM_SIZE];
+	memset(histogram, 0xFF, sizeof(histogram));
+	n = rws_socket_get_loop_histogram(socket, histogram, RWS_LOOP_HISTOGRAM_SIZE);
+	assert(n == RWS_LOOP_HISTOGRAM_SIZE);								printf("%i\n", (int)__LINE__);
+	assert(histogram[0] == 0 && histogram[RWS_LOOP_HISTOGRAM_SIZE - 1] == 0);	printf("%i\n", (int)__LINE__);
+
+
 	rws_socket_disconnect_and_release(socket);
 
+	socket = rws_socket_create();
+	assert(socket);
+	r = rws_shutdown_all(1000);
+	assert(r);															printf("%i\n", (int)__LINE__);
+
 	return 0;
 }
 
@@ -0,0 +1,2057 @@
+/*
+ *   Copyright (c) 2014 - 2019 Oleh Kulykov <info@resident.name>
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *   THE SOFTWARE.
+ */
+
+
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1 // thread attributes of the work thread
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+
+
+#if defined(CMAKE_BUILD)
+#undef CMAKE_BUILD
+#endif
+
+#if defined(XCODE)
+#include "librws.h"
+#else
+#include <librws.h>
+#endif
+
+#include "../src/rws_socket.h"
+#include "../src/rws_sha1.h"
+
+#if defined(CMAKE_BUILD)
+#undef CMAKE_BUILD
+#endif
+
+// feeds in memory transport with server frames, checks dispatched messages and sent frames
+
+static int _connected = 0;
+static int _disconnected = 0;
+static unsigned int _texts = 0;
+static unsigned int _bins = 0;
+static size_t _recvd_bytes = 0;
+static int _is_recvd_ok = 1;
+
+static unsigned int _slow_callbacks = 0;
+
+static void on_slow_callback(rws_socket socket, const rws_callback_type type, const unsigned int duration_us) {
+	if (type == rws_callback_type_recvd_text) {
+		_slow_callbacks++;
+	}
+}
+
+static void on_connected(rws_socket socket) {
+	_connected++;
+}
+
+static void on_disconnected(rws_socket socket) {
+	_disconnected++;
+}
+
+static void on_recvd_text(rws_socket socket, const char * text, const unsigned int length) {
+	if (length != 5 || memcmp(text, "hello", 5) != 0) {
+		_is_recvd_ok = 0;
+	}
+	_texts++;
+	_recvd_bytes += length;
+}
+
+static void on_recvd_bin(rws_socket socket, const void * data, const unsigned int length) {
+	const unsigned char * bytes = (const unsigned char *)data;
+	unsigned int i;
+	for (i = 0; i < length; i++) {
+		if (bytes[i] != (unsigned char)i) {
+			_is_recvd_ok = 0;
+			break;
+		}
+	}
+	_bins++;
+	_recvd_bytes += length;
+}
+
+// unmasked server frame, returns frame size
+static size_t make_frame(unsigned char * buff, const int opcode, const int is_fin, const void * payload, const size_t size) {
+	size_t header = 2, i;
+	buff[0] = (unsigned char)((is_fin ? 0x80 : 0) | opcode);
+	if (size < 126) {
+		buff[1] = (unsigned char)size;
+	} else if (size <= 0xFFFF) {
+		buff[1] = 126;
+		buff[2] = (unsigned char)(size >> 8);
+		buff[3] = (unsigned char)size;
+		header = 4;
+	} else {
+		buff[1] = 127;
+		for (i = 0; i < 8; i++) {
+			buff[2 + i] = (unsigned char)((unsigned long long)size >> (56 - 8 * i));
+		}
+		header = 10;
+	}
+	if (size) {
+		memcpy(buff + header, payload, size);
+	}
+	return header + size;
+}
+
+// reads one masked client frame from pipe, returns opcode and unmasked payload
+static int read_client_frame_any(_rws_pipe * pipe, unsigned char * payload, size_t * size) {
+	unsigned char header[14];
+	size_t len = 0, header_size = 2, i;
+	size_t n = 0;
+	if (rws_pipe_read(pipe, header, 2) != 2) {
+		return -1;
+	}
+	assert(header[1] & 0x80); // client frames are masked
+	len = header[1] & 0x7F;
+	if (len == 126) {
+		rws_pipe_read(pipe, header + 2, 2);
+		len = ((size_t)header[2] << 8) | header[3];
+		header_size = 4;
+	} else if (len == 127) {
+		rws_pipe_read(pipe, header + 2, 8);
+		len = 0;
+		for (i = 0; i < 8; i++) {
+			len = (len << 8) | header[2 + i];
+		}
+		header_size = 10;
+	}
+	rws_pipe_read(pipe, header + header_size, 4);
+	n = rws_pipe_read(pipe, payload, len);
+	assert(n == len);
+	for (i = 0; i < len; i++) {
+		payload[i] ^= header[header_size + (i % 4)];
+	}
+	*size = len;
+	return header[0] & 0x0F;
+}
+
+// skips pings sent by client timer
+static int read_client_frame(_rws_pipe * pipe, unsigned char * payload, size_t * size) {
+	int opcode = -1;
+	do {
+		opcode = read_client_frame_any(pipe, payload, size);
+	} while (opcode == rws_opcode_ping);
+	return opcode;
+}
+
+static void step(rws_socket socket) {
+	rws_socket_on_writable(socket);
+	rws_socket_on_readable(socket);
+}
+
+static const char * _responce = "HTTP/1.1 101 Switching Protocols\r\n"
+"Upgrade: websocket\r\n"
+"Connection: Upgrade\r\n"
+"Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+
+// RFC 6455 sample key, '_responce' has its accept value
+static const char * _test_key = "dGhlIHNhbXBsZSBub25jZQ==";
+
+// executor delivers messages in order, 'on_disconnected' after all messages
+static unsigned int _executor_recvd = 0;
+static unsigned int _executor_recvd_on_disconnect = 0;
+static int _is_executor_order_ok = 1;
+
+static void on_executor_recvd_text(rws_socket socket, const char * text, const unsigned int length) {
+	char buff[16];
+	memcpy(buff, text, length < 15 ? length : 15);
+	buff[length < 15 ? length : 15] = 0;
+	if ((unsigned int)atoi(buff) != _executor_recvd) {
+		_is_executor_order_ok = 0;
+	}
+	if (_executor_recvd % 100 == 0) {
+		rws_thread_sleep(1); // slow handler
+	}
+	_executor_recvd++;
+}
+
+static void on_executor_disconnected(rws_socket socket) {
+	_executor_recvd_on_disconnect = _executor_recvd;
+}
+
+static void test_executor(void) {
+	const unsigned int count = 1000;
+	unsigned char buff[64];
+	char text[16];
+	size_t len = 0;
+	unsigned int i = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_executor executor = rws_executor_create(4);
+	rws_executor failed = NULL;
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+	rws_thread_attr attr;
+
+	// no thread can be started with this stack, executor is not created
+	memset(&attr, 0, sizeof(attr));
+	attr.stack_size = ((size_t)-1) & ~(size_t)0xFFFF;
+	rws_thread_set_default_attr(&attr);
+	failed = rws_executor_create(2);
+	rws_thread_set_default_attr(NULL);
+	assert(!failed);													printf("%i\n", (int)__LINE__);
+	assert(executor);													printf("%i\n", (int)__LINE__);
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_executor(socket, executor);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_text(socket, &on_executor_recvd_text);
+	rws_socket_set_on_disconnected(socket, &on_executor_disconnected);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	for (i = 0; i < count; i++) {
+		len = (size_t)sprintf(text, "%u", i);
+		len = make_frame(buff, rws_opcode_text_frame, 1, text, len);
+		rws_pipe_write(pipe, buff, len);
+		step(socket);
+	}
+	len = make_frame(buff, rws_opcode_connection_close, 1, NULL, 0);
+	rws_pipe_write(pipe, buff, len);
+	while (rws_socket_on_readable(socket)) {
+		rws_thread_sleep(1);
+	}
+	assert(_executor_recvd_on_disconnect == count);					printf("%i\n", (int)__LINE__);
+	assert(_is_executor_order_ok);										printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_executor_delete(executor);
+	rws_pipe_delete(pipe);
+}
+
+static int wait_client_frame(_rws_pipe * pipe, unsigned char * payload, size_t * size) {
+	int opcode = -1;
+	unsigned int waited = 0;
+	while ((opcode = read_client_frame(pipe, payload, size)) < 0 && ++waited < 2000) {
+		rws_thread_sleep(1);
+	}
+	return opcode;
+}
+
+static void test_graceful_close(void) {
+	unsigned char buff[1024];
+	size_t len = 0, size = 0;
+	unsigned int waited = 0;
+	unsigned long long start = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+	int opcode = 0;
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	// work thread mode
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	while (!rws_pipe_read(pipe, buff, sizeof(buff)) && ++waited < 2000) {
+		rws_thread_sleep(1);
+	}
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	while (!rws_socket_is_connected(socket) && ++waited < 4000) {
+		rws_thread_sleep(1);
+	}
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	// pending message is sent before close frame with code and reason
+	r = rws_socket_send_text(socket, "last");
+	assert(r);															printf("%i\n", (int)__LINE__);
+	start = rws_time_ms();
+	rws_socket_disconnect_with_code_and_release(socket, 4000, "done");
+	opcode = wait_client_frame(pipe, buff, &size);
+	assert(opcode == rws_opcode_text_frame);							printf("%i\n", (int)__LINE__);
+	assert(size == 4 && memcmp(buff, "last", 4) == 0);				printf("%i\n", (int)__LINE__);
+	opcode = wait_client_frame(pipe, buff, &size);
+	assert(opcode == rws_opcode_connection_close);						printf("%i\n", (int)__LINE__);
+	assert(size == 6 && buff[0] == 0x0F && buff[1] == 0xA0);			printf("%i\n", (int)__LINE__);
+	assert(memcmp(buff + 2, "done", 4) == 0);							printf("%i\n", (int)__LINE__);
+
+	// socket is finished by close from server, not by timeout
+	len = make_frame(buff, rws_opcode_connection_close, 1, "\x0F\xA0", 2);
+	rws_pipe_write(pipe, buff, len);
+	r = rws_shutdown_all(2000);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	printf("graceful close: %llu ms\n", rws_time_ms() - start);
+	assert(rws_time_ms() - start < 500);								printf("%i\n", (int)__LINE__);
+
+	rws_pipe_delete(pipe);
+}
+
+// external loop socket is closed by its loop on shutdown, then released by owner
+static void test_shutdown_external(void) {
+	unsigned char buff[1024];
+	size_t len = 0, size = 0;
+	unsigned int steps = 0;
+	rws_bool r = rws_false;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	r = rws_shutdown_all(0); // only asked to close
+	assert(!r && rws_socket_is_connected(socket));						printf("%i\n", (int)__LINE__);
+
+	step(socket);
+	len = (size_t)read_client_frame(pipe, buff, &size);
+	assert(len == rws_opcode_connection_close);						printf("%i\n", (int)__LINE__);
+	len = make_frame(buff, rws_opcode_connection_close, 1, "\x03\xE8", 2);
+	rws_pipe_write(pipe, buff, len);
+	do {
+		r = rws_socket_on_readable(socket);
+	} while (r && ++steps < 1000);
+	assert(!r && !rws_socket_is_connected(socket));					printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	r = rws_shutdown_all(0);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	rws_pipe_delete(pipe);
+}
+
+// not connected socket is deleted by shutdown without registry lock, so deleting can create sockets
+static volatile size_t _is_registry_free = 0;
+
+static void create_socket_run(void * user_object) {
+	rws_socket_disconnect_and_release(rws_socket_create());
+	rws_atomic_store(&_is_registry_free, 1);
+}
+
+static void on_not_started_deleted(rws_socket socket) {
+	unsigned int waited = 0;
+	rws_thread_create_with_attr(&create_socket_run, NULL, NULL, NULL);
+	while (!rws_atomic_load(&_is_registry_free) && ++waited < 2000) {
+		rws_thread_sleep(1);
+	}
+}
+
+static void test_shutdown_not_started(void) {
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+
+	rws_socket_set_on_deleted(socket, &on_not_started_deleted);
+	r = rws_shutdown_all(2000);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	assert(rws_atomic_load(&_is_registry_free));						printf("%i\n", (int)__LINE__);
+}
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+static size_t _thread_stack_size = 0;
+static char _thread_name[16];
+static volatile size_t _is_thread_attr_connected = 0;
+
+static void on_thread_attr_connected(rws_socket socket) {
+#if defined(__linux__)
+	pthread_attr_t attr;
+	if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+		pthread_attr_getstacksize(&attr, &_thread_stack_size);
+		pthread_attr_destroy(&attr);
+	}
+	pthread_getname_np(pthread_self(), _thread_name, sizeof(_thread_name));
+#endif
+	rws_atomic_store(&_is_thread_attr_connected, 1);
+}
+
+static volatile size_t _thread_runs = 0;
+
+static void thread_run(void * user_object) {
+	rws_atomic_fetch_or(&_thread_runs, (size_t)user_object);
+}
+
+// work thread is started with custom stack size and named by host
+static void test_thread_attr(void) {
+	const size_t stack_size = 256 * 1024;
+	unsigned char buff[1024];
+	size_t len = 0;
+	unsigned int waited = 0;
+	rws_bool r = rws_false;
+	rws_thread_attr attr;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_thread thread = NULL;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.stack_size = stack_size;
+
+	// detached threads, handle only reports start
+	thread = rws_thread_create(&thread_run, (void *)1);
+	assert(thread);														printf("%i\n", (int)__LINE__);
+	thread = rws_thread_create(NULL, NULL);
+	assert(!thread);													printf("%i\n", (int)__LINE__);
+	r = rws_thread_create_with_attr(&thread_run, (void *)2, &attr, "rws-test");
+	assert(r);															printf("%i\n", (int)__LINE__);
+	while (rws_atomic_load(&_thread_runs) != 3 && ++waited < 2000) {
+		rws_thread_sleep(1);
+	}
+	assert(rws_atomic_load(&_thread_runs) == 3);						printf("%i\n", (int)__LINE__);
+	waited = 0;
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_thread_attr(socket, &attr);
+	rws_socket_set_url(socket, "ws", "attrhost", 80, "/");
+	rws_socket_set_on_connected(socket, &on_thread_attr_connected);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	while (!rws_pipe_read(pipe, buff, sizeof(buff)) && ++waited < 2000) {
+		rws_thread_sleep(1);
+	}
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	for (waited = 0; !rws_atomic_load(&_is_thread_attr_connected) && waited < 2000; waited++) {
+		rws_thread_sleep(1);
+	}
+	assert(rws_atomic_load(&_is_thread_attr_connected));				printf("%i\n", (int)__LINE__);
+#if defined(__linux__)
+	// rounded up by system, much less than default 8MB
+	assert(_thread_stack_size >= stack_size && _thread_stack_size < 4 * stack_size); printf("%i\n", (int)__LINE__);
+	assert(strcmp(_thread_name, "rws-attrhost") == 0);				printf("%i\n", (int)__LINE__);
+#endif
+
+	rws_socket_disconnect_and_release(socket);
+	len = make_frame(buff, rws_opcode_connection_close, 1, "\x03\xE8", 2);
+	rws_pipe_write(pipe, buff, len);
+	r = rws_shutdown_all(2000);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	rws_pipe_delete(pipe);
+}
+
+// validates whole text, vector path for long texts, and by single bytes, scalar path
+static int validate_utf8(const unsigned char * text, const size_t size) {
+	_rws_utf8 whole, parts;
+	size_t i = 0;
+	int is_whole = 0, is_parts = 1;
+	rws_utf8_reset(&whole);
+	rws_utf8_reset(&parts);
+	is_whole = rws_utf8_validate(&whole, text, size) && rws_utf8_is_complete(&whole);
+	for (i = 0; i < size && is_parts; i++) {
+		is_parts = rws_utf8_validate(&parts, text + i, 1);
+	}
+	is_parts = is_parts && rws_utf8_is_complete(&parts);
+	assert(is_whole == is_parts);
+	return is_whole;
+}
+
+static unsigned int _utf8_texts = 0;
+
+static void on_utf8_recvd_text(rws_socket socket, const char * text, const unsigned int length) {
+	_utf8_texts++;
+}
+
+static void test_utf8(void) {
+	rws_bool r = rws_false;
+	int opcode = 0;
+	static const char * valid[] = { "hello", "\xD0\xBF\xD1\x80\xD0\xB8", "\xE2\x82\xAC", "\xED\x9F\xBF",
+		"\xEF\xBF\xBF", "\xF0\x90\x80\x80", "\xF4\x8F\xBF\xBF", NULL };
+	static const char * invalid[] = { "\x80", "\xC0\xAF", "\xC1\xBF", "\xE0\x80\xAF", "\xED\xA0\x80",
+		"\xF0\x80\x80\xAF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF", "\xE2\x82", "\xD0\xBF\x80", NULL };
+	static const unsigned char bytes[] = { 'a', 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF, 0xC0, 0xC2,
+		0xDF, 0xE0, 0xE1, 0xED, 0xEF, 0xF0, 0xF1, 0xF4, 0xF5, 0xFF };
+	unsigned char text[160];
+	unsigned char buff[256];
+	size_t len = 0, i = 0, j = 0;
+	unsigned int seed = 1;
+	_rws_transport transport;
+	_rws_pipe * pipe = NULL;
+	rws_socket socket = NULL;
+
+	// sequences at every position of the 16 byte block
+	for (i = 0; i < 16; i++) {
+		for (j = 0; valid[j]; j++) {
+			memset(text, 'a', sizeof(text));
+			memcpy(text + 40 + i, valid[j], strlen(valid[j]));
+			assert(validate_utf8(text, sizeof(text)));
+		}
+		for (j = 0; invalid[j]; j++) {
+			memset(text, 'a', sizeof(text));
+			memcpy(text + 40 + i, invalid[j], strlen(invalid[j]));
+			assert(!validate_utf8(text, sizeof(text)));
+		}
+	}
+	printf("%i\n", (int)__LINE__);
+
+	// random texts of the interesting bytes, vector and scalar paths give same result
+	for (i = 0; i < 20000; i++) {
+		len = 32 + (i % 64);
+		for (j = 0; j < len; j++) {
+			seed = seed * 1103515245 + 12345;
+			text[j] = ((seed >> 16) & 3) ? 'a' : bytes[(seed >> 18) % sizeof(bytes)];
+		}
+		validate_utf8(text, len);
+	}
+	printf("%i\n", (int)__LINE__);
+
+	pipe = rws_pipe_create();
+	socket = rws_socket_create();
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_text(socket, &on_utf8_recvd_text);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	// character split between fragments
+	len = make_frame(buff, rws_opcode_text_frame, 0, "\xE2\x82", 2);
+	len += make_frame(buff + len, rws_opcode_continuation, 1, "\xAC", 1);
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+	assert(_utf8_texts == 1);											printf("%i\n", (int)__LINE__);
+
+	// invalid text fails connection with 1007
+	len = make_frame(buff, rws_opcode_text_frame, 1, "\xC0\xAF", 2);
+	rws_pipe_write(pipe, buff, len);
+	r = rws_socket_on_readable(socket);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	assert(_utf8_texts == 1);											printf("%i\n", (int)__LINE__);
+	assert(rws_error_get_code(rws_socket_get_error(socket)) == rws_error_code_invalid_utf8); printf("%i\n", (int)__LINE__);
+	opcode = read_client_frame(pipe, buff, &len);
+	assert(opcode == rws_opcode_connection_close);						printf("%i\n", (int)__LINE__);
+	assert(len == 2 && buff[0] == 0x03 && buff[1] == 0xEF);			printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+}
+
+// handshake responce in pieces, frames right after the responce, non 101 responce
+static void test_handshake(void) {
+	static const char * refused = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n";
+	unsigned char buff[512];
+	size_t len = 0, i = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = NULL;
+	rws_socket socket = NULL;
+	const unsigned int texts = _texts;
+	rws_bool r = rws_false;
+
+	pipe = rws_pipe_create();
+	socket = rws_socket_create();
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_text(socket, &on_recvd_text);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+
+	// byte by byte, terminator split between reads
+	len = strlen(_responce);
+	for (i = 0; i + 1 < len; i++) {
+		rws_pipe_write(pipe, _responce + i, 1);
+		step(socket);
+		assert(!rws_socket_is_connected(socket));
+	}
+	printf("%i\n", (int)__LINE__);
+
+	// last byte together with two pushed messages
+	buff[0] = (unsigned char)_responce[len - 1];
+	i = 1 + make_frame(buff + 1, rws_opcode_text_frame, 1, "snapshot", 8);
+	i += make_frame(buff + i, rws_opcode_text_frame, 1, "update", 6);
+	rws_pipe_write(pipe, buff, i);
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+	assert(_texts == texts + 2);										printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+
+	// not upgraded
+	pipe = rws_pipe_create();
+	socket = rws_socket_create();
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, refused, strlen(refused));
+	r = rws_socket_on_readable(socket);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	assert(!rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+	assert(rws_error_get_code(rws_socket_get_error(socket)) == rws_error_code_parse_handshake); printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+}
+
+// full socket buffer doesn't stall the external loop, unsent bytes wait for writable
+static void test_send_would_block(void) {
+	char text[101];
+	unsigned char buff[512];
+	size_t len = 0, i = 0;
+	unsigned long long start = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	const int disconnected = _disconnected;
+	rws_bool r = rws_false;
+
+	rws_pipe_set_out_capacity(pipe, 16);
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+
+	// handshake is sent by parts
+	start = rws_time_ms();
+	step(socket);
+	assert(rws_time_ms() - start < 100);								printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_wanted_events(socket) & rws_socket_event_write); printf("%i\n", (int)__LINE__);
+	len = rws_pipe_read(pipe, buff, sizeof(buff));
+	assert(len == 16);													printf("%i\n", (int)__LINE__);
+	for (i = 0; i < 100 && rws_socket_get_wanted_events(socket) & rws_socket_event_write; i++) {
+		step(socket);
+		len += rws_pipe_read(pipe, buff + len, sizeof(buff) - 1 - len);
+	}
+	buff[len] = 0;
+	assert(strncmp((const char *)buff, "GET / HTTP/1.1\r\n", 16) == 0);	printf("%i\n", (int)__LINE__);
+	assert(len > 4 && strcmp((const char *)buff + len - 4, "\r\n\r\n") == 0); printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_wanted_events(socket) == rws_socket_event_read); printf("%i\n", (int)__LINE__);
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	// partially sent frame stays queued
+	memset(text, 'x', 100);
+	text[100] = 0;
+	r = rws_socket_send_text(socket, text);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	assert(rws_socket_get_wanted_events(socket) & rws_socket_event_write); printf("%i\n", (int)__LINE__);
+
+	// close from server while buffer is full, close frame is not waited for
+	len = make_frame(buff, rws_opcode_connection_close, 1, "\x03\xE8", 2);
+	rws_pipe_write(pipe, buff, len);
+	start = rws_time_ms();
+	r = rws_socket_on_readable(socket);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	assert(rws_time_ms() - start < 100);								printf("%i\n", (int)__LINE__);
+	assert(_disconnected == disconnected + 1);							printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+}
+
+// random key for each connection, accept value is checked against the key
+static rws_socket accept_connect(_rws_pipe * pipe, _rws_transport * transport, char * key) {
+	char request[1024];
+	const char * found = NULL;
+	size_t len = 0;
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+	rws_transport_init_pipe(transport, pipe);
+	rws_socket_set_transport(socket, transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	r = rws_socket_connect(socket);
+	assert(r);
+	step(socket);
+	len = rws_pipe_read(pipe, request, sizeof(request) - 1);
+	request[len] = 0;
+	found = strstr(request, "\r\nSec-WebSocket-Key: ");
+	assert(found && strlen(found) > 21 + 24);
+	memcpy(key, found + 21, 24);
+	key[24] = 0;
+	return socket;
+}
+
+static void test_accept_key(void) {
+	static const unsigned char abc_sha1[] = {
+		0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+		0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d };
+	unsigned char digest[RWS_SHA1_SIZE];
+	char key[32], other_key[32], accept[32], responce[256];
+	_rws_transport transport;
+	_rws_pipe * pipe = NULL;
+	rws_socket socket = NULL;
+
+	rws_sha1("abc", 3, digest);
+	assert(memcmp(digest, abc_sha1, sizeof(digest)) == 0);				printf("%i\n", (int)__LINE__);
+	rws_proto_accept_key("dGhlIHNhbXBsZSBub25jZQ==", accept);
+	assert(strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0);		printf("%i\n", (int)__LINE__);
+
+	rws_proto_set_test_key(NULL);
+
+	// accept of the other key fails connection
+	pipe = rws_pipe_create();
+	socket = accept_connect(pipe, &transport, other_key);
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	assert(!rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+	assert(rws_error_get_code(rws_socket_get_error(socket)) == rws_error_code_parse_handshake); printf("%i\n", (int)__LINE__);
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+
+	// next connection has new key, its accept value is valid
+	pipe = rws_pipe_create();
+	socket = accept_connect(pipe, &transport, key);
+	assert(strcmp(key, other_key) != 0);								printf("%i\n", (int)__LINE__);
+	rws_proto_accept_key(key, accept);
+	rws_sprintf(responce, sizeof(responce), "HTTP/1.1 101 Switching Protocols\r\n"
+				"Upgrade: websocket\r\n"
+				"Connection: Upgrade\r\n"
+				"Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+	rws_pipe_write(pipe, responce, strlen(responce));
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+
+	rws_proto_set_test_key(_test_key);
+}
+
+// user headers and subprotocols in the request, request reused with new key
+static void test_handshake_request(void) {
+	rws_bool r = rws_false;
+	static const char * selected = "HTTP/1.1 101 Switching Protocols\r\n"
+	"Upgrade: websocket\r\n"
+	"Connection: Upgrade\r\n"
+	"Sec-WebSocket-Protocol: v1.proto\r\n"
+	"Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+	static const char * unknown = "HTTP/1.1 101 Switching Protocols\r\n"
+	"Sec-WebSocket-Protocol: v3.proto\r\n"
+	"Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+	char token[1024];
+	char request[4096];
+	char key[25];
+	size_t len = 0, readed = 0, i = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = NULL;
+	rws_socket socket = NULL;
+	_rws_proto proto;
+	char * handshake = NULL;
+
+	memset(token, 'x', sizeof(token) - 1);
+	token[sizeof(token) - 1] = 0;
+
+	for (i = 0; i < 2; i++) {
+		pipe = rws_pipe_create();
+		socket = rws_socket_create();
+		rws_transport_init_pipe(&transport, pipe);
+		rws_socket_set_transport(socket, &transport);
+		rws_socket_set_external_loop(socket, rws_true);
+		rws_socket_set_url(socket, "ws", "mem", 80, "/");
+		rws_socket_set_on_disconnected(socket, &on_disconnected);
+		r = rws_socket_add_header(socket, "Bad:Name", "value");
+		assert(!r);														printf("%i\n", (int)__LINE__);
+		r = rws_socket_add_header(socket, "Name", "bad\r\nvalue");
+		assert(!r);														printf("%i\n", (int)__LINE__);
+		r = rws_socket_add_protocol(socket, "a,b");
+		assert(!r);														printf("%i\n", (int)__LINE__);
+		r = rws_socket_add_header(socket, "Authorization", token);
+		assert(r);														printf("%i\n", (int)__LINE__);
+		r = rws_socket_add_protocol(socket, "v2.proto");
+		assert(r);														printf("%i\n", (int)__LINE__);
+		r = rws_socket_add_protocol(socket, "v1.proto");
+		assert(r);														printf("%i\n", (int)__LINE__);
+		r = rws_socket_connect(socket);
+		assert(r);														printf("%i\n", (int)__LINE__);
+		step(socket);
+
+		len = 0;
+		while ((readed = rws_pipe_read(pipe, request + len, sizeof(request) - 1 - len))) {
+			len += readed;
+		}
+		request[len] = 0;
+		assert(len > 1024 && strstr(request, "\r\n\r\n") == request + len - 4); printf("%i\n", (int)__LINE__);
+		assert(strstr(request, "\r\nAuthorization: xxx"));				printf("%i\n", (int)__LINE__);
+		assert(strstr(request, "\r\nSec-WebSocket-Protocol: v2.proto, v1.proto\r\n")); printf("%i\n", (int)__LINE__);
+		assert(strstr(request, "\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n")); printf("%i\n", (int)__LINE__);
+
+		rws_pipe_write(pipe, i ? unknown : selected, strlen(i ? unknown : selected));
+		step(socket);
+		if (i == 0) {
+			assert(rws_socket_is_connected(socket));						printf("%i\n", (int)__LINE__);
+			assert(strcmp(rws_socket_get_protocol(socket), "v1.proto") == 0); printf("%i\n", (int)__LINE__);
+		} else {
+			assert(!rws_socket_is_connected(socket));						printf("%i\n", (int)__LINE__);
+			assert(rws_error_get_code(rws_socket_get_error(socket)) == rws_error_code_parse_handshake); printf("%i\n", (int)__LINE__);
+		}
+		rws_socket_disconnect_and_release(socket);
+		rws_pipe_delete(pipe);
+	}
+
+	// next connection reuses request buffer with new random key
+	rws_proto_set_test_key(NULL);
+	rws_proto_init(&proto);
+	rws_proto_add_header(&proto, "Authorization", token);
+	rws_proto_create_handshake(&proto, "ws", "mem", 80, "/");
+	handshake = proto.handshake;
+	len = proto.handshake_len;
+	memcpy(key, proto.handshake + proto.handshake_key_offset, 24);
+	key[24] = 0;
+	rws_proto_create_handshake(&proto, "ws", "mem", 80, "/");
+	assert(proto.handshake == handshake && proto.handshake_len == len);	printf("%i\n", (int)__LINE__);
+	assert(strncmp(proto.handshake + proto.handshake_key_offset, key, 24) != 0); printf("%i\n", (int)__LINE__);
+	assert(strncmp(proto.handshake + proto.handshake_key_offset + 24, "\r\n", 2) == 0); printf("%i\n", (int)__LINE__);
+	rws_proto_clean(&proto);
+	rws_proto_set_test_key(_test_key);
+}
+
+// pool sockets over pipes, test answers handshakes
+#define POOL_MAX_PIPES 8
+static _rws_pipe * _pool_pipes[POOL_MAX_PIPES];
+static rws_socket _pool_sockets[POOL_MAX_PIPES];
+static size_t _pool_pipes_count = 0;
+static size_t _pool_answered = 0;
+
+static void on_pool_socket(rws_socket socket) {
+	_rws_transport transport;
+	assert(_pool_pipes_count < POOL_MAX_PIPES);
+	_pool_pipes[_pool_pipes_count] = rws_pipe_create();
+	_pool_sockets[_pool_pipes_count] = socket;
+	rws_transport_init_pipe(&transport, _pool_pipes[_pool_pipes_count]);
+	rws_socket_set_transport(socket, &transport);
+	_pool_pipes_count++;
+}
+
+// answer new handshakes, wait all answered sockets are connected
+static unsigned int pool_wait_ready(rws_pool pool, const unsigned int count) {
+	unsigned char buff[1024];
+	unsigned int waited = 0;
+	while (++waited < 4000) {
+		while (_pool_answered < _pool_pipes_count && rws_pipe_read(_pool_pipes[_pool_answered], buff, sizeof(buff))) {
+			rws_pipe_write(_pool_pipes[_pool_answered++], _responce, strlen(_responce));
+		}
+		if (rws_pool_get_ready_count(pool) == count) {
+			break;
+		}
+		rws_thread_sleep(1);
+	}
+	return rws_pool_get_ready_count(pool);
+}
+
+static void test_pool(void) {
+	rws_socket socket = NULL;
+	rws_pool pool = NULL;
+	unsigned int waited = 0;
+	size_t i = 0;
+	rws_bool r = rws_false;
+	size_t n = 0;
+
+	pool = rws_pool_create("ws", "mem", 80, "/", 2, &on_pool_socket);
+	assert(_pool_pipes_count == 2);									printf("%i\n", (int)__LINE__);
+	n = pool_wait_ready(pool, 2);
+	assert(n == 2);														printf("%i\n", (int)__LINE__);
+
+	// acquired socket is replaced
+	socket = rws_pool_acquire(pool);
+	assert(socket && rws_socket_is_connected(socket));				printf("%i\n", (int)__LINE__);
+	assert(_pool_pipes_count == 3);									printf("%i\n", (int)__LINE__);
+	n = pool_wait_ready(pool, 2);
+	assert(n == 2);														printf("%i\n", (int)__LINE__);
+	r = rws_socket_send_text(socket, "acquired");
+	assert(r);															printf("%i\n", (int)__LINE__);
+
+	// lost connection is replaced
+	for (i = 0; _pool_sockets[i] == socket; i++) { }
+	rws_pipe_close(_pool_pipes[i]);
+	while (rws_pool_get_ready_count(pool) != 1 && ++waited < 4000) {
+		rws_thread_sleep(1);
+	}
+	n = pool_wait_ready(pool, 2);
+	assert(n == 2);														printf("%i\n", (int)__LINE__);
+	assert(_pool_pipes_count == 4);									printf("%i\n", (int)__LINE__);
+
+	// acquired socket stays connected
+	rws_pool_delete(pool);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+	rws_socket_disconnect_and_release(socket);
+	r = rws_shutdown_all(2000);
+	assert(r);															printf("%i\n", (int)__LINE__);
+
+	for (i = 0; i < _pool_pipes_count; i++) {
+		rws_pipe_delete(_pool_pipes[i]);
+	}
+}
+
+// failover to the next endpoint, statistics select the fastest healthy endpoint
+static rws_socket endpoints_connect(rws_endpoints endpoints, _rws_transport * transport) {
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+	rws_socket_set_transport(socket, transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_endpoints(socket, endpoints);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	r = rws_socket_connect(socket);
+	assert(r);
+	step(socket);
+	return socket;
+}
+
+static int endpoints_answer(rws_socket socket, _rws_pipe * pipe, const char * responce) {
+	char request[1024];
+	const size_t len = rws_pipe_read(pipe, request, sizeof(request) - 1);
+	request[len] = 0;
+	rws_pipe_write(pipe, responce, strlen(responce));
+	step(socket);
+	step(socket); // reconnect after failover
+	return strstr(request, "\r\nHost: a\r\n") ? 0 : (strstr(request, "\r\nHost: b\r\n") ? 1 : -1);
+}
+
+static void test_endpoints(void) {
+	static const char * refused = "HTTP/1.1 503 Service Unavailable\r\n\r\n";
+	unsigned char buff[256];
+	size_t size = 0;
+	int disconnected = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_endpoints endpoints = rws_endpoints_create();
+	rws_endpoints unix_endpoints = NULL;
+	rws_socket socket = NULL;
+	rws_bool r = rws_false;
+	int opcode = 0;
+	size_t n = 0;
+
+	rws_transport_init_pipe(&transport, pipe);
+	r = rws_endpoints_add(endpoints, "ws", "a", 80, "/");
+	assert(r);															printf("%i\n", (int)__LINE__);
+	r = rws_endpoints_add(endpoints, "ws", "b", 80, "/");
+	assert(r);															printf("%i\n", (int)__LINE__);
+	r = rws_endpoints_add(endpoints, "ws", "c", 0, "/");
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	unix_endpoints = rws_endpoints_create();
+	r = rws_endpoints_add(unix_endpoints, "ws+unix", "/tmp/c.sock", 0, "/");
+	assert(r);															printf("%i\n", (int)__LINE__);
+	rws_endpoints_delete(unix_endpoints);
+
+	// first endpoint fails, second is connected without disconnect, socket URL is not replaced
+	disconnected = _disconnected;
+	socket = endpoints_connect(endpoints, &transport);
+	assert(rws_socket_get_endpoint(socket) == 0);						printf("%i\n", (int)__LINE__);
+	n = endpoints_answer(socket, pipe, refused);
+	assert(n == 0);														printf("%i\n", (int)__LINE__);
+	n = endpoints_answer(socket, pipe, _responce);
+	assert(n == 1);														printf("%i\n", (int)__LINE__);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_endpoint(socket) == 1);						printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_host(socket) == NULL);						printf("%i\n", (int)__LINE__);
+	assert(_disconnected == disconnected);								printf("%i\n", (int)__LINE__);
+	assert(rws_endpoints_get_handshake_time(endpoints, 0) == 0);		printf("%i\n", (int)__LINE__);
+	assert(rws_endpoints_get_handshake_time(endpoints, 1) > 0);		printf("%i\n", (int)__LINE__);
+
+	// pong measures round trip time
+	socket->next_ping_ms = 0;
+	step(socket);
+	opcode = read_client_frame_any(pipe, buff, &size);
+	assert(opcode == rws_opcode_ping);									printf("%i\n", (int)__LINE__);
+	size = make_frame(buff, rws_opcode_pong, 1, NULL, 0);
+	rws_pipe_write(pipe, buff, size);
+	step(socket);
+	assert(rws_endpoints_get_rtt(endpoints, 1) > 0);					printf("%i\n", (int)__LINE__);
+	rws_socket_disconnect_and_release(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+
+	// failed endpoint is skipped, after all endpoints fail disconnect is informed
+	socket = endpoints_connect(endpoints, &transport);
+	assert(rws_socket_get_endpoint(socket) == 1);						printf("%i\n", (int)__LINE__);
+	n = endpoints_answer(socket, pipe, refused);
+	assert(n == 1);														printf("%i\n", (int)__LINE__);
+	assert(_disconnected == disconnected);								printf("%i\n", (int)__LINE__);
+	n = endpoints_answer(socket, pipe, refused);
+	assert(n == 0);														printf("%i\n", (int)__LINE__);
+	assert(_disconnected == disconnected + 1);							printf("%i\n", (int)__LINE__);
+
+	// socket keeps endpoints till it is deleted
+	rws_endpoints_delete(endpoints);
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+}
+
+#if !defined(_WIN32)
+// handshake and frames over unix domain socket
+static void test_unix(void) {
+	static const char * path = "/tmp/test_librws_unix.sock";
+	struct sockaddr_un addr;
+	char buff[1024];
+	size_t len = 0;
+	ssize_t readed = 0;
+	unsigned int waited = 0;
+	rws_socket_t listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	rws_socket_t peer = RWS_INVALID_SOCKET;
+	rws_socket socket = NULL;
+	const unsigned int texts = _texts;
+	rws_bool r = rws_false;
+	int res = 0;
+	ssize_t sent = 0;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	res = bind(listener, (struct sockaddr *)&addr, sizeof(addr));
+	assert(res == 0);													printf("%i\n", (int)__LINE__);
+	res = listen(listener, 1);
+	assert(res == 0);													printf("%i\n", (int)__LINE__);
+
+	socket = rws_socket_create();
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws+unix", path, 0, "/chat");
+	rws_socket_set_on_received_text(socket, &on_recvd_text);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	peer = accept(listener, NULL, NULL);
+	assert(peer != RWS_INVALID_SOCKET);								printf("%i\n", (int)__LINE__);
+	while (len < 4 || memcmp(buff + len - 4, "\r\n\r\n", 4) != 0) {
+		step(socket);
+		readed = recv(peer, buff + len, sizeof(buff) - 1 - len, MSG_DONTWAIT);
+		if (readed > 0) {
+			len += (size_t)readed;
+		}
+		assert(++waited < 1000);
+		rws_thread_sleep(1);
+	}
+	buff[len] = 0;
+	assert(strstr(buff, "GET /chat HTTP/1.1\r\nHost: localhost\r\n"));	printf("%i\n", (int)__LINE__);
+
+	len = strlen(_responce);
+	memcpy(buff, _responce, len);
+	len += make_frame((unsigned char *)buff + len, rws_opcode_text_frame, 1, "local", 5);
+	sent = send(peer, buff, len, 0);
+	assert(sent == (ssize_t)len);										printf("%i\n", (int)__LINE__);
+	for (waited = 0; _texts == texts && waited < 1000; waited++) {
+		step(socket);
+		rws_thread_sleep(1);
+	}
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+	assert(_texts == texts + 1);										printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	RWS_SOCK_CLOSE(peer);
+	RWS_SOCK_CLOSE(listener);
+	unlink(path);
+}
+#endif
+
+// big binary messages are received to mapped file by parts, small stay in heap
+static void spill_write(rws_socket socket, _rws_pipe * pipe, const unsigned char * data, const size_t size, const size_t part) {
+	size_t offset = 0, len = 0;
+	for (offset = 0; offset < size; offset += len) {
+		len = (size - offset < part) ? (size - offset) : part;
+		rws_pipe_write(pipe, data + offset, len);
+		step(socket);
+		assert(socket->proto.received_size <= 65536);
+	}
+}
+
+static int spill_check(const rws_message * message, const size_t size, const int is_spilled) {
+	const unsigned char * data = (const unsigned char *)message->data;
+	size_t i = 0;
+	if (message->is_text || message->data_size != size ||
+		(((_rws_frame *)message->priv)->spill ? 1 : 0) != is_spilled) {
+		return 0;
+	}
+	for (i = 0; i < size; i++) {
+		if (data[i] != (unsigned char)(i * 7)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// 64 bit length is parsed fully, frame bigger than callbacks can take fails connection with 1009
+static void test_big_length(void) {
+	static const unsigned char small[] = { 0x82, 127, 0, 0, 0, 0, 0, 0, 0, 3, 0, 1, 2 };
+	static const unsigned char big[] = { 0x82, 127, 0, 0, 0, 1, 0, 0, 0, 1, 'x' };
+	unsigned char buff[1024];
+	size_t len = 0;
+	unsigned long long size = 0;
+	unsigned int bins = _bins;
+	rws_bool r = rws_false;
+	int opcode = 0;
+	_rws_frame * frame = NULL;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_recv_spill(socket, 1024, NULL); // big frames are streamed
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_bin(socket, &on_recvd_bin);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	step(socket);
+
+	_recvd_bytes = 0;
+	rws_pipe_write(pipe, small, sizeof(small));
+	step(socket);
+	assert(_bins == bins + 1 && _recvd_bytes == 3);					printf("%i\n", (int)__LINE__);
+
+	// 4GB + 1 frame, upper bytes of the length are not ignored
+	rws_pipe_write(pipe, big, sizeof(big));
+	r = rws_socket_on_readable(socket);
+	assert(!r && _bins == bins + 1);									printf("%i\n", (int)__LINE__);
+	opcode = read_client_frame(pipe, buff, &len);
+	assert(opcode == rws_opcode_connection_close);						printf("%i\n", (int)__LINE__);
+	assert(len >= 2 && buff[0] == 0x03 && buff[1] == 0xF1);			printf("%i\n", (int)__LINE__);
+
+	// 4GB + 1 frame to send, header has full length
+	if (sizeof(size_t) > 4) {
+		frame = rws_frame_create();
+		frame->opcode = rws_opcode_binary_frame;
+		rws_frame_create_header(frame, buff, (((size_t)1 << 16) << 16) + 1);
+		assert(frame->header_size == 10 && memcmp(buff, big, 10) == 0);	printf("%i\n", (int)__LINE__);
+		r = rws_frame_get_recv_payload_size(buff, frame->header_size, &size);
+		assert(r && size == 0x100000001ULL);							printf("%i\n", (int)__LINE__);
+		rws_frame_delete(frame);
+	}
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+}
+
+static void test_spill(void) {
+	static const unsigned char mask[4] = { 1, 2, 3, 4 };
+	const size_t big = 300000, masked = 100000, part = 800;
+	unsigned char * payload = (unsigned char *)malloc(big);
+	unsigned char * buff = (unsigned char *)malloc(big + 64);
+	rws_message messages[8];
+	size_t len = 0, i = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+	size_t n = 0;
+
+	for (i = 0; i < big; i++) {
+		payload[i] = (unsigned char)(i * 7);
+	}
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_poll_mode(socket, 8);
+	rws_socket_set_recv_spill(socket, 1024, NULL);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, 1024)) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	// one frame, received buffer stays small
+	len = make_frame(buff, rws_opcode_binary_frame, 1, payload, big);
+	spill_write(socket, pipe, buff, len, 4096);
+	printf("%i\n", (int)__LINE__);
+
+	// masked frame, parts are not aligned to the mask
+	len = make_frame(buff, rws_opcode_binary_frame, 1, NULL, 0);
+	buff[1] = 0x80 | 127;
+	for (i = 0; i < 8; i++) {
+		buff[2 + i] = (unsigned char)((unsigned long long)masked >> (56 - 8 * i));
+	}
+	memcpy(buff + 10, mask, 4);
+	for (i = 0; i < masked; i++) {
+		buff[14 + i] = payload[i] ^ mask[i & 3];
+	}
+	spill_write(socket, pipe, buff, 14 + masked, 999);
+	printf("%i\n", (int)__LINE__);
+
+	// fragments, spilled when combined size is above threshold
+	len = make_frame(buff, rws_opcode_binary_frame, 0, payload, part);
+	len += make_frame(buff + len, rws_opcode_continuation, 0, payload + part, part);
+	len += make_frame(buff + len, rws_opcode_continuation, 1, payload + 2 * part, part);
+	len += make_frame(buff + len, rws_opcode_binary_frame, 1, payload, part);
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+
+	n = rws_socket_poll_messages(socket, messages, 8);
+	assert(n == 4);														printf("%i\n", (int)__LINE__);
+	assert(spill_check(&messages[0], big, 1));						printf("%i\n", (int)__LINE__);
+	assert(spill_check(&messages[1], masked, 1));						printf("%i\n", (int)__LINE__);
+	assert(spill_check(&messages[2], 3 * part, 1));					printf("%i\n", (int)__LINE__);
+	assert(spill_check(&messages[3], part, 0));						printf("%i\n", (int)__LINE__);
+	for (i = 0; i < 4; i++) {
+		rws_message_free(&messages[i]);
+	}
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+	free(payload);
+	free(buff);
+}
+
+// messages over the memory limit are queued in file and sent in order after connect
+static void test_send_spill(void) {
+	const unsigned int count = 200, size = 100;
+	unsigned char buff[1024];
+	unsigned char payload[128];
+	size_t len = 0;
+	unsigned int i = 0, recvd = 0;
+	int is_order_ok = 1;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_send_spill(socket, 1000, NULL);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	for (i = 0; i < count; i++) {
+		memset(payload, (int)(i & 0xff), size);
+		r = rws_socket_send_binary(socket, payload, size);
+		assert(r);
+	}
+	assert(socket->proto.send_queued <= 1000);						printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_send_spilled(socket) > 150 * size);			printf("%i\n", (int)__LINE__);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	pipe->send_chunk = 300; // draining takes several steps
+	for (i = 0; i < count; i++) {
+		step(socket);
+		if (i == count / 2) { // sent after spilled
+			memset(payload, (int)(count & 0xff), size);
+			r = rws_socket_send_binary(socket, payload, size);
+			assert(r);
+		}
+	}
+	assert(rws_socket_get_send_spilled(socket) == 0);					printf("%i\n", (int)__LINE__);
+	assert(!socket->proto.send_spill);								printf("%i\n", (int)__LINE__);
+	// drained output is unpublished, idle step and wanted events skip 'send_mutex'
+	assert(!rws_proto_is_output_posted(&socket->proto));				printf("%i\n", (int)__LINE__);
+	assert(!(rws_socket_get_wanted_events(socket) & rws_socket_event_write)); printf("%i\n", (int)__LINE__);
+
+	while (read_client_frame(pipe, payload, &len) == rws_opcode_binary_frame) {
+		if (len != size || payload[0] != (unsigned char)recvd || payload[size - 1] != (unsigned char)recvd) {
+			is_order_ok = 0;
+		}
+		recvd++;
+	}
+	assert(recvd == count + 1);										printf("%i\n", (int)__LINE__);
+	assert(is_order_ok);												printf("%i\n", (int)__LINE__);
+
+	r = rws_socket_send_binary(socket, payload, size);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	assert(rws_proto_is_output_posted(&socket->proto));					printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_wanted_events(socket) & rws_socket_event_write); printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+}
+
+#if !defined(_WIN32)
+// file is sent by parts as fragmented message, in order with messages queued around it
+static void test_send_file(void) {
+	static const char * path = "/tmp/test_librws_send_file.bin";
+	const size_t file_size = 200000, offset = 1000, size = 150000;
+	unsigned char * data = (unsigned char *)malloc(file_size);
+	unsigned char * payload = (unsigned char *)malloc(RWS_FRAME_FILE_PART_SIZE + 16);
+	unsigned char buff[1024];
+	int opcodes[8];
+	size_t len = 0, recvd_size = 0, i = 0;
+	unsigned int frames = 0;
+	int is_data_ok = 1;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+	FILE * file = fopen(path, "wb");
+	int fd = -1;
+
+	for (i = 0; i < file_size; i++) {
+		data[i] = (unsigned char)(i * 7);
+	}
+	fwrite(data, 1, file_size, file);
+	fclose(file);
+	fd = open(path, O_RDONLY);
+	unlink(path);
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_send_spill(socket, 16, NULL); // message from file is queued in spill too
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	r = rws_socket_send_file(socket, fd, file_size, 1);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	r = rws_socket_send_file(socket, fd, 0, 0);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	r = rws_socket_send_file(socket, -1, 0, 1);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	memset(buff, 'a', 100);
+	r = rws_socket_send_binary(socket, buff, 100);
+	assert(r);
+	r = rws_socket_send_file(socket, fd, offset, size);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	close(fd); // descriptor is duplicated
+	r = rws_socket_send_binary(socket, "b", 1);
+	assert(r);
+	assert(socket->proto.send_spill);								printf("%i\n", (int)__LINE__);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	for (i = 0; i < 16; i++) {
+		step(socket);
+	}
+	assert(!rws_proto_has_send_frames(&socket->proto));				printf("%i\n", (int)__LINE__);
+
+	while (frames < 8 && (opcodes[frames] = read_client_frame(pipe, payload, &len)) >= 0) {
+		if (frames == 0) {
+			is_data_ok = is_data_ok && (len == 100);
+		} else if (opcodes[frames] == rws_opcode_binary_frame && len == 1) {
+			is_data_ok = is_data_ok && (payload[0] == 'b');
+		} else {
+			is_data_ok = is_data_ok && (len <= RWS_FRAME_FILE_PART_SIZE) && (memcmp(payload, data + offset + recvd_size, len) == 0);
+			recvd_size += len;
+		}
+		frames++;
+	}
+	assert(frames == 5);												printf("%i\n", (int)__LINE__);
+	assert(opcodes[0] == rws_opcode_binary_frame && opcodes[1] == rws_opcode_binary_frame &&
+		   opcodes[2] == rws_opcode_continuation && opcodes[3] == rws_opcode_continuation &&
+		   opcodes[4] == rws_opcode_binary_frame);					printf("%i\n", (int)__LINE__);
+	assert(is_data_ok && recvd_size == size);							printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+	free(payload);
+	free(data);
+}
+#endif
+
+// request id is the number after "id:" at the start of the message
+static rws_bool on_request_id(rws_socket socket, const rws_message * message, unsigned long long * id) {
+	const char * data = (const char *)message->data;
+	size_t i = 3;
+	if (message->data_size < 4 || memcmp(data, "id:", 3) != 0) {
+		return rws_false;
+	}
+	*id = 0;
+	while (i < message->data_size && data[i] >= '0' && data[i] <= '9') {
+		*id = *id * 10 + (unsigned long long)(data[i++] - '0');
+	}
+	return rws_true;
+}
+
+static unsigned int _replies[3];
+static int _is_reply_ok = 1;
+static unsigned int _request_recvd_text = 0;
+
+static void on_reply(rws_socket socket, void * user_data, const rws_reply_status status, const rws_message * reply) {
+	unsigned long long id = 0;
+	_replies[status]++;
+	if (status == rws_reply_status_ok) {
+		if (!on_request_id(socket, reply, &id) || id != (unsigned long long)(size_t)user_data) {
+			_is_reply_ok = 0;
+		}
+	} else if (reply) {
+		_is_reply_ok = 0;
+	}
+}
+
+static void on_request_recvd_text(rws_socket socket, const char * text, const unsigned int length) {
+	_request_recvd_text++;
+}
+
+// thousands of requests in flight, replies out of order, timeouts and disconnect
+static void test_requests(void) {
+	const unsigned int count = 1000;
+	unsigned char buff[1024];
+	char text[32];
+	size_t len = 0;
+	unsigned int i = 0, waited = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_on_request_id(socket, &on_request_id);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_text(socket, &on_request_recvd_text);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	r = rws_socket_request(socket, "no id", 5, rws_true, 0, &on_reply, NULL);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	for (i = 0; i < count; i++) {
+		len = (size_t)sprintf(text, "id:%u", i);
+		r = rws_socket_request(socket, text, len, rws_true, (i % 10) ? 0 : 50, &on_reply, (void *)(size_t)i);
+		assert(r);
+	}
+	r = rws_socket_request(socket, "id:5", 4, rws_true, 0, &on_reply, NULL);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_requests_count(socket) == count);			printf("%i\n", (int)__LINE__);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	step(socket);
+	assert(rws_socket_get_timeout(socket) <= 50);						printf("%i\n", (int)__LINE__);
+
+	// every 10th request has timeout and is not replied
+	for (i = count; i > 0; i--) {
+		if ((i - 1) % 10) {
+			len = (size_t)sprintf(text, "id:%u", i - 1);
+			len = make_frame(buff, rws_opcode_text_frame, 1, text, len);
+			rws_pipe_write(pipe, buff, len);
+		}
+	}
+	len = make_frame(buff, rws_opcode_text_frame, 1, "hello", 5);
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+	assert(_replies[rws_reply_status_ok] == count - count / 10);		printf("%i\n", (int)__LINE__);
+	assert(_is_reply_ok && _request_recvd_text == 1);					printf("%i\n", (int)__LINE__);
+
+	while (_replies[rws_reply_status_timeout] < count / 10 && ++waited < 1000) {
+		rws_thread_sleep(1);
+		rws_socket_on_timer(socket);
+	}
+	assert(_replies[rws_reply_status_timeout] == count / 10);			printf("%i\n", (int)__LINE__);
+	len = make_frame(buff, rws_opcode_text_frame, 1, "id:0", 4); // late reply is a message
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+	assert(_request_recvd_text == 2);									printf("%i\n", (int)__LINE__);
+
+	r = rws_socket_request(socket, "id:1", 4, rws_true, 0, &on_reply, (void *)1);
+	assert(r);
+	len = make_frame(buff, rws_opcode_connection_close, 1, NULL, 0);
+	rws_pipe_write(pipe, buff, len);
+	while (rws_socket_on_readable(socket)) { }
+	assert(_replies[rws_reply_status_disconnected] == 1);				printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_requests_count(socket) == 0);				printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+}
+
+static rws_message _owned_message;
+static unsigned int _owned_messages = 0;
+static unsigned int _deleted = 0;
+
+static void on_recvd_message(rws_socket socket, rws_message * message) {
+	_owned_messages++;
+	rws_message_free(&_owned_message);
+	_owned_message = *message; // application owns the message
+}
+
+static void on_deleted(rws_socket socket) {
+	_deleted++;
+}
+
+// received messages are owned by application, allocated messages are sent without copy
+static void test_owned_messages(void) {
+	unsigned char buff[1024];
+	size_t len = 0;
+	rws_message message;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+	int opcode = 0;
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_message(socket, &on_recvd_message);
+	rws_socket_set_on_deleted(socket, &on_deleted);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	len = make_frame(buff, rws_opcode_text_frame, 1, "first", 5);
+	rws_pipe_write(pipe, buff, len);
+	len = make_frame(buff, rws_opcode_binary_frame, 1, "second", 6);
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+	assert(_owned_messages == 2 && !_owned_message.is_text);			printf("%i\n", (int)__LINE__);
+	assert(_owned_message.data_size == 6 && memcmp(_owned_message.data, "second", 6) == 0); printf("%i\n", (int)__LINE__);
+
+	// received message has no room for header, it is released
+	r = rws_socket_send_message(socket, &_owned_message);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	assert(_owned_message.priv == NULL && _owned_message.data == NULL);	printf("%i\n", (int)__LINE__);
+
+	r = rws_message_alloc(&message, 5, rws_true);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	memcpy((void *)message.data, "third", 5);
+	r = rws_socket_send_message(socket, &message);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	assert(message.priv == NULL);										printf("%i\n", (int)__LINE__);
+	r = rws_socket_send_message(socket, &message);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+
+	// empty messages are sent, null text is not
+	r = rws_socket_send_text(socket, NULL);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	r = rws_socket_send_text(socket, "");
+	assert(r);															printf("%i\n", (int)__LINE__);
+	r = rws_socket_send_binary(socket, NULL, 0);
+	assert(r);															printf("%i\n", (int)__LINE__);
+
+	step(socket);
+	opcode = read_client_frame(pipe, buff, &len);
+	assert(opcode == rws_opcode_text_frame);							printf("%i\n", (int)__LINE__);
+	assert(len == 5 && memcmp(buff, "third", 5) == 0);					printf("%i\n", (int)__LINE__);
+	opcode = read_client_frame(pipe, buff, &len);
+	assert(opcode == rws_opcode_text_frame && len == 0);				printf("%i\n", (int)__LINE__);
+	opcode = read_client_frame(pipe, buff, &len);
+	assert(opcode == rws_opcode_binary_frame && len == 0);				printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	assert(_deleted == 1);												printf("%i\n", (int)__LINE__);
+	rws_pipe_delete(pipe);
+}
+
+// empty messages and empty first fragment are delivered
+static unsigned int _empty_recvd = 0;
+static int _is_empty_ok = 1;
+
+static void on_empty_recvd_message(rws_socket socket, rws_message * message) {
+	static const char * expected[] = { "", "", "abc" };
+	if (_empty_recvd >= 3 || !message->data || message->data_size != strlen(expected[_empty_recvd]) ||
+		memcmp(message->data, expected[_empty_recvd], message->data_size) != 0 ||
+		message->is_text != (_empty_recvd != 1)) {
+		_is_empty_ok = 0;
+	}
+	_empty_recvd++;
+	rws_message_free(message);
+}
+
+static void test_empty_messages(void) {
+	unsigned char buff[256];
+	size_t len = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_message(socket, &on_empty_recvd_message);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	len = make_frame(buff, rws_opcode_text_frame, 1, NULL, 0);
+	len += make_frame(buff + len, rws_opcode_binary_frame, 1, NULL, 0);
+	len += make_frame(buff + len, rws_opcode_text_frame, 0, NULL, 0); // empty first fragment
+	len += make_frame(buff + len, rws_opcode_continuation, 0, "a", 1);
+	len += make_frame(buff + len, rws_opcode_continuation, 1, "bc", 2);
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+	assert(_empty_recvd == 3);											printf("%i\n", (int)__LINE__);
+	assert(_is_empty_ok);												printf("%i\n", (int)__LINE__);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+}
+
+// batch callback gets all coalesced messages of one read
+static unsigned int _batches = 0;
+static unsigned int _batch_count = 0;
+static int _is_batch_ok = 1;
+
+static void on_recvd_batch(rws_socket socket, const rws_message * messages, const unsigned int count) {
+	char text[16];
+	unsigned int i;
+	_batches++;
+	_batch_count = count;
+	for (i = 0; i < count; i++) {
+		rws_sprintf(text, 16, "msg%u", i);
+		if (messages[i].is_text != (i % 2 == 0) ||
+			messages[i].data_size != strlen(text) ||
+			memcmp(messages[i].data, text, messages[i].data_size) != 0) {
+			_is_batch_ok = 0;
+		}
+	}
+}
+
+static void test_batch(void) {
+	const unsigned int count = 20;
+	unsigned char buff[1024];
+	char text[16];
+	size_t len = 0, text_len = 0;
+	unsigned int i = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_batch(socket, &on_recvd_batch);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	// text and binary frames in one chunk
+	for (i = 0; i < count; i++) {
+		text_len = (size_t)rws_sprintf(text, 16, "msg%u", i);
+		len += make_frame(buff + len, (i % 2 == 0) ? rws_opcode_text_frame : rws_opcode_binary_frame, 1, text, text_len);
+	}
+	rws_pipe_write(pipe, buff, len);
+	rws_socket_on_readable(socket);
+	assert(_batches == 1 && _batch_count == count);						printf("%i\n", (int)__LINE__);
+	assert(_is_batch_ok);												printf("%i\n", (int)__LINE__);
+
+	// messages are freed after callback
+	for (i = 0; i < count; i++) {
+		if (socket->recvd_batch[i].priv || socket->recvd_batch[i].data) {
+			_is_batch_ok = 0;
+		}
+	}
+	assert(_is_batch_ok);												printf("%i\n", (int)__LINE__);
+	assert(!rws_proto_peek_message(&socket->proto));					printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+}
+
+// data frames wait for send buckets, control frames don't, reading pauses above receive limit
+static void test_rate_limits(void) {
+	unsigned char buff[1024];
+	size_t len = 0;
+	unsigned int i = 0, sent = 0, texts = 0;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+	int opcode = 0;
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_received_text(socket, &on_recvd_text);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	while (rws_pipe_read(pipe, buff, sizeof(buff))) { }
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	step(socket);
+	assert(rws_socket_is_connected(socket));							printf("%i\n", (int)__LINE__);
+
+	// bucket holds 2 messages, the rest is delayed
+	rws_socket_set_send_rate_limit(socket, 2, 0);
+	for (i = 0; i < 5; i++) {
+		r = rws_socket_send_binary(socket, "data", 4);
+		assert(r);
+	}
+	step(socket);
+	while (read_client_frame(pipe, buff, &len) == rws_opcode_binary_frame) {
+		sent++;
+	}
+	assert(sent == 2);													printf("%i\n", (int)__LINE__);
+	assert(!(rws_socket_get_wanted_events(socket) & rws_socket_event_write)); printf("%i\n", (int)__LINE__);
+
+	// pong is sent while data frames are throttled
+	len = make_frame(buff, rws_opcode_ping, 1, "p", 1);
+	rws_pipe_write(pipe, buff, len);
+	rws_socket_on_readable(socket);
+	rws_socket_on_writable(socket);
+	opcode = read_client_frame_any(pipe, buff, &len);
+	assert(opcode == rws_opcode_pong && len == 1 && buff[0] == 'p');	printf("%i\n", (int)__LINE__);
+	opcode = read_client_frame_any(pipe, buff, &len);
+	assert(opcode == -1);												printf("%i\n", (int)__LINE__);
+
+	rws_thread_sleep(20);
+	rws_socket_on_writable(socket);
+	assert(rws_socket_get_send_throttled_time(socket) > 0);				printf("%i\n", (int)__LINE__);
+
+	// 10 bytes per second, one of three 7 byte frames is read, then reading is paused
+	rws_socket_set_recv_rate_limit(socket, 10);
+	texts = _texts;
+	for (i = 0, len = 0; i < 3; i++) {
+		len += make_frame(buff + len, rws_opcode_text_frame, 1, "hello", 5);
+	}
+	rws_pipe_write(pipe, buff, len);
+	rws_socket_on_readable(socket);
+	assert(_texts == texts + 1);										printf("%i\n", (int)__LINE__);
+	rws_thread_sleep(20);
+	rws_socket_on_readable(socket);
+	assert(_texts == texts + 1);										printf("%i\n", (int)__LINE__);
+	assert(!(rws_socket_get_wanted_events(socket) & rws_socket_event_read)); printf("%i\n", (int)__LINE__);
+	rws_thread_sleep(20);
+	rws_socket_on_readable(socket);
+	assert(rws_socket_get_recv_throttled_time(socket) > 0);				printf("%i\n", (int)__LINE__);
+
+	// unlimited reading continues from the kernel buffer
+	rws_socket_set_recv_rate_limit(socket, 0);
+	assert(rws_socket_get_wanted_events(socket) & rws_socket_event_read); printf("%i\n", (int)__LINE__);
+	rws_socket_on_readable(socket);
+	assert(_texts == texts + 3);										printf("%i\n", (int)__LINE__);
+
+	// close is sent while data frames are still throttled
+	rws_socket_disconnect_and_release(socket);
+	opcode = read_client_frame(pipe, buff, &len);
+	assert(opcode == rws_opcode_connection_close);						printf("%i\n", (int)__LINE__);
+	rws_pipe_delete(pipe);
+}
+
+// sockets of one loop share the limit, each socket alone is not limited
+static void test_shared_rate_limit(void) {
+	unsigned char buff[1024];
+	size_t len = 0;
+	unsigned int i = 0, j = 0, sent = 0, texts = 0;
+	_rws_transport transports[2];
+	_rws_pipe * pipes[2];
+	rws_socket sockets[2];
+	rws_rate_limit limit = rws_rate_limit_create(3, 0, 10);
+	rws_bool r = rws_false;
+
+	assert(limit);														printf("%i\n", (int)__LINE__);
+	for (i = 0; i < 2; i++) {
+		pipes[i] = rws_pipe_create();
+		sockets[i] = rws_socket_create();
+		rws_transport_init_pipe(&transports[i], pipes[i]);
+		rws_socket_set_transport(sockets[i], &transports[i]);
+		rws_socket_set_external_loop(sockets[i], rws_true);
+		rws_socket_set_url(sockets[i], "ws", "mem", 80, "/");
+		rws_socket_set_on_received_text(sockets[i], &on_recvd_text);
+		rws_socket_set_on_disconnected(sockets[i], &on_disconnected);
+		rws_socket_set_shared_rate_limit(sockets[i], limit);
+		r = rws_socket_connect(sockets[i]);
+		assert(r);														printf("%i\n", (int)__LINE__);
+		step(sockets[i]);
+		while (rws_pipe_read(pipes[i], buff, sizeof(buff))) { }
+		rws_pipe_write(pipes[i], _responce, strlen(_responce));
+		step(sockets[i]);
+		assert(rws_socket_is_connected(sockets[i]));					printf("%i\n", (int)__LINE__);
+	}
+
+	// sockets keep limit till they are deleted
+	rws_rate_limit_delete(limit);
+
+	// 3 messages per second for both sockets
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < 2; j++) {
+			r = rws_socket_send_binary(sockets[i], "data", 4);
+			assert(r);
+		}
+		rws_socket_on_writable(sockets[i]);
+	}
+	for (i = 0; i < 2; i++) {
+		while (read_client_frame(pipes[i], buff, &len) == rws_opcode_binary_frame) {
+			sent++;
+		}
+	}
+	assert(sent == 3);													printf("%i\n", (int)__LINE__);
+	assert(!(rws_socket_get_wanted_events(sockets[1]) & rws_socket_event_write)); printf("%i\n", (int)__LINE__);
+
+	// 10 bytes per second for both sockets, 7 byte frame is read by one socket only
+	texts = _texts;
+	len = make_frame(buff, rws_opcode_text_frame, 1, "hello", 5);
+	for (i = 0; i < 2; i++) {
+		rws_pipe_write(pipes[i], buff, len);
+		rws_socket_on_readable(sockets[i]);
+	}
+	assert(_texts == texts + 1);										printf("%i\n", (int)__LINE__);
+	rws_socket_on_readable(sockets[1]); // rest of shared tokens is taken, then reading is paused
+	assert(_texts == texts + 1);										printf("%i\n", (int)__LINE__);
+	assert(!(rws_socket_get_wanted_events(sockets[1]) & rws_socket_event_read)); printf("%i\n", (int)__LINE__);
+
+	for (i = 0; i < 2; i++) {
+		rws_socket_disconnect_and_release(sockets[i]);
+		rws_pipe_delete(pipes[i]);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const size_t big_size = 1024 * 1024 + 3;
+	const unsigned int coalesced = 100000;
+	unsigned char * buff = (unsigned char *)malloc(big_size + 16);
+	unsigned char * stream = (unsigned char *)malloc(coalesced * 8);
+	unsigned char * payload = (unsigned char *)malloc(big_size);
+	unsigned long long start = 0;
+	size_t len = 0, i = 0, size = 0;
+	_rws_frame * frame = NULL;
+	_rws_transport transport;
+	_rws_pipe * pipe = rws_pipe_create();
+	rws_socket socket = rws_socket_create();
+	rws_bool r = rws_false;
+	int opcode = 0;
+	assert(socket && pipe && buff && stream && payload);
+	rws_proto_set_test_key(_test_key);
+
+	for (i = 0; i < big_size; i++) {
+		payload[i] = (unsigned char)i;
+	}
+
+	// fields written by application threads are not on the loop thread cache lines
+	assert((size_t)socket % RWS_CACHE_LINE_SIZE == 0);					printf("%i\n", (int)__LINE__);
+	assert(offsetof(_rws_socket, proto) % RWS_CACHE_LINE_SIZE == 0);	printf("%i\n", (int)__LINE__);
+	assert(offsetof(_rws_proto, send_frames) % RWS_CACHE_LINE_SIZE == 0); printf("%i\n", (int)__LINE__);
+	assert(offsetof(_rws_socket, send_mutex) % RWS_CACHE_LINE_SIZE == 0); printf("%i\n", (int)__LINE__);
+	assert(offsetof(_rws_socket, port) % RWS_CACHE_LINE_SIZE == 0);		printf("%i\n", (int)__LINE__);
+
+	// small frames are stored inline, without second allocation
+	frame = rws_frame_create();
+	frame->is_masked = rws_true;
+	rws_frame_fill_with_send_data(frame, "ping", 4);
+	assert(frame->data == frame->inline_data && frame->data_size == 10);	printf("%i\n", (int)__LINE__);
+	rws_frame_delete(frame);
+	frame = rws_frame_create();
+	rws_frame_fill_with_send_data(frame, payload, RWS_FRAME_INLINE_SIZE);
+	assert(frame->data != frame->inline_data);						printf("%i\n", (int)__LINE__);
+	rws_frame_delete(frame);
+
+	rws_transport_init_pipe(&transport, pipe);
+	rws_socket_set_transport(socket, &transport);
+	rws_socket_set_external_loop(socket, rws_true);
+	rws_socket_set_url(socket, "ws", "mem", 80, "/");
+	rws_socket_set_on_connected(socket, &on_connected);
+	rws_socket_set_on_disconnected(socket, &on_disconnected);
+	rws_socket_set_on_received_text(socket, &on_recvd_text);
+	rws_socket_set_on_received_bin(socket, &on_recvd_bin);
+
+	// handshake
+	r = rws_socket_connect(socket);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	step(socket);
+	len = rws_pipe_read(pipe, buff, big_size);
+	buff[len] = 0;
+	assert(strncmp((const char *)buff, "GET / HTTP/1.1\r\n", 16) == 0);	printf("%i\n", (int)__LINE__);
+	assert(strstr((const char *)buff, "\r\n\r\n"));					printf("%i\n", (int)__LINE__);
+	rws_pipe_write(pipe, _responce, strlen(_responce));
+	step(socket);
+	assert(_connected == 1 && rws_socket_is_connected(socket));		printf("%i\n", (int)__LINE__);
+
+	// 1 byte per read, frames are split at every position
+	rws_pipe_set_chunks(pipe, 1, 0);
+	len = make_frame(buff, rws_opcode_text_frame, 1, "hello", 5);
+	len += make_frame(buff + len, rws_opcode_binary_frame, 1, payload, 300);
+	len += make_frame(buff + len, rws_opcode_text_frame, 1, "hello", 5);
+	for (i = 0; i < len; i++) {
+		rws_pipe_write(pipe, buff + i, 1);
+		step(socket);
+	}
+	assert(_texts == 2 && _bins == 1 && _is_recvd_ok);				printf("%i\n", (int)__LINE__);
+
+	// fragmented message
+	rws_pipe_set_chunks(pipe, 0, 0);
+	len = make_frame(buff, rws_opcode_binary_frame, 0, payload, 100);
+	len += make_frame(buff + len, rws_opcode_continuation, 0, payload + 100, 100);
+	len += make_frame(buff + len, rws_opcode_continuation, 1, payload + 200, 56);
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+	assert(_bins == 2 && _is_recvd_ok);								printf("%i\n", (int)__LINE__);
+
+	// huge frame with 64 bit length, read by 4k chunks
+	rws_pipe_set_chunks(pipe, 4096, 0);
+	_recvd_bytes = 0;
+	len = make_frame(buff, rws_opcode_binary_frame, 1, payload, big_size);
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+	assert(_bins == 3 && _recvd_bytes == big_size && _is_recvd_ok);	printf("%i\n", (int)__LINE__);
+
+	// every callback is slow with zero threshold
+	rws_socket_set_on_slow_callback(socket, &on_slow_callback, 0);
+	len = make_frame(buff, rws_opcode_text_frame, 1, "hello", 5);
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+	assert(_slow_callbacks == 1);										printf("%i\n", (int)__LINE__);
+	rws_socket_set_on_slow_callback(socket, NULL, 0);
+
+	// many coalesced frames in one read
+	rws_pipe_set_chunks(pipe, 0, 0);
+	_texts = 0;
+	len = 0;
+	for (i = 0; i < coalesced; i++) {
+		len += make_frame(stream + len, rws_opcode_text_frame, 1, "hello", 5);
+	}
+	rws_pipe_write(pipe, stream, len);
+	start = rws_time_ms();
+	step(socket);
+	printf("parse and dispatch of %u frames: %llu ms\n", coalesced, rws_time_ms() - start);
+	for (i = 0, size = 0; i < RWS_LOOP_HISTOGRAM_SIZE; i++) {
+		size += socket->loop_histogram[i];
+	}
+	assert(size > 0);													printf("%i\n", (int)__LINE__);
+	assert(_texts == coalesced && _is_recvd_ok);						printf("%i\n", (int)__LINE__);
+
+	// ping is answered with pong
+	len = make_frame(buff, rws_opcode_ping, 1, "ping", 4);
+	rws_pipe_write(pipe, buff, len);
+	step(socket);
+	step(socket);
+	opcode = read_client_frame(pipe, buff, &size);
+	assert(opcode == rws_opcode_pong);									printf("%i\n", (int)__LINE__);
+	assert(size == 4 && memcmp(buff, "ping", 4) == 0);				printf("%i\n", (int)__LINE__);
+
+	// partial writes, 3 bytes per send
+	rws_pipe_set_chunks(pipe, 0, 3);
+	r = rws_socket_send_binary(socket, payload, 1000);
+	assert(r);															printf("%i\n", (int)__LINE__);
+	for (i = 0; i < 1000; i++) {
+		step(socket);
+	}
+	opcode = read_client_frame(pipe, buff, &size);
+	assert(opcode == rws_opcode_binary_frame);							printf("%i\n", (int)__LINE__);
+	assert(size == 1000 && memcmp(buff, payload, 1000) == 0);			printf("%i\n", (int)__LINE__);
+
+	// close from server
+	rws_pipe_set_chunks(pipe, 0, 0);
+	len = make_frame(buff, rws_opcode_connection_close, 1, "\x03\xE9", 2);
+	rws_pipe_write(pipe, buff, len);
+	r = rws_socket_on_readable(socket);
+	assert(!r);															printf("%i\n", (int)__LINE__);
+	assert(_disconnected == 1 && !rws_socket_is_connected(socket));	printf("%i\n", (int)__LINE__);
+	assert(rws_socket_get_close_code(socket) == 1001);				printf("%i\n", (int)__LINE__);
+	opcode = read_client_frame(pipe, buff, &size);
+	assert(opcode == rws_opcode_connection_close);						printf("%i\n", (int)__LINE__);
+	assert(size == 2 && buff[0] == 0x03 && buff[1] == 0xE9);			printf("%i\n", (int)__LINE__);
+
+	rws_socket_disconnect_and_release(socket);
+	rws_pipe_delete(pipe);
+
+	test_executor();
+	test_utf8();
+	test_handshake();
+	test_accept_key();
+	test_send_would_block();
+	test_handshake_request();
+	test_endpoints();
+	test_spill();
+	test_big_length();
+	test_send_spill();
+	test_requests();
+	test_owned_messages();
+	test_empty_messages();
+	test_batch();
+	test_rate_limits();
+	test_shared_rate_limit();
+#if !defined(_WIN32)
+	test_unix();
+	test_send_file();
+#endif
+	test_thread_attr();
+	test_graceful_close();
+	test_shutdown_external();
+	test_shutdown_not_started();
+	test_pool();
+
+	free(buff);
+	free(stream);
+	free(payload);
+
+	return 0;
+}